@@ -37,6 +37,8 @@
 #include "systray.h"
 #include "xwindow.h"
 #include "options.h"
+#include "property.h"
+#include "stats.h"
 
 #include <getopt.h>
 
@@ -55,6 +57,9 @@
 #include <xcb/xtest.h>
 #include <xcb/shape.h>
 #include <xcb/xfixes.h>
+#include <xcb/shm.h>
+#include <xcb/composite.h>
+#include <xcb/damage.h>
 
 #include <glib-unix.h>
 
@@ -108,6 +113,9 @@ awesome_atexit(bool restart)
     lua_pushboolean(L, restart);
     signal_object_emit(L, &global_signals, "exit", 1);
 
+    /* Do not lose a wallpaper that is still being rendered */
+    root_wallpaper_flush();
+
     /* Move clients where we want them to be and keep the stacking order intact */
     foreach(c, globalconf.stack)
     {
@@ -132,6 +140,8 @@ awesome_atexit(bool restart)
     /* Close Lua */
     lua_close(L);
 
+    winmap_wipe(&globalconf.windows);
+
     screen_cleanup();
 
     /* X11 is a great protocol. There is a save-set so that reparenting WMs
@@ -142,7 +152,7 @@ awesome_atexit(bool restart)
      */
     xcb_set_input_focus(globalconf.connection, XCB_INPUT_FOCUS_POINTER_ROOT,
             XCB_NONE, globalconf.timestamp);
-    xcb_aux_sync(globalconf.connection);
+    A_XCB_SYNC(globalconf.connection);
 
     xkb_free();
 
@@ -165,7 +175,7 @@ restore_client_order(xcb_get_property_cookie_t prop_cookie)
     xcb_window_t *windows;
     xcb_get_property_reply_t *reply;
 
-    reply = xcb_get_property_reply(globalconf.connection, prop_cookie, NULL);
+    reply = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, prop_cookie, NULL));
     if (!reply || reply->format != 32 || reply->value_len == 0) {
         p_delete(&reply);
         return;
@@ -188,23 +198,25 @@ restore_client_order(xcb_get_property_cookie_t prop_cookie)
 }
 
 /** Scan X to find windows to manage.
+ * All requests are sent before any reply is waited for, so that the number of
+ * round trips does not depend on the number of windows.
+ * \return The time in seconds spent scanning.
  */
-static void
+static double
 scan(xcb_query_tree_cookie_t tree_c)
 {
     int i, tree_c_len;
     xcb_query_tree_reply_t *tree_r;
     xcb_window_t *wins = NULL;
-    xcb_get_window_attributes_reply_t *attr_r;
-    xcb_get_geometry_reply_t *geom_r;
     xcb_get_property_cookie_t prop_cookie;
+    gint64 start = g_get_monotonic_time();
 
-    tree_r = xcb_query_tree_reply(globalconf.connection,
+    tree_r = A_XCB_WAIT(xcb_query_tree_reply(globalconf.connection,
                                   tree_c,
-                                  NULL);
+                                  NULL));
 
     if(!tree_r)
-        return;
+        return (g_get_monotonic_time() - start) / 1e6;
 
     /* This gets the property and deletes it */
     prop_cookie = xcb_get_property_unchecked(globalconf.connection, true,
@@ -219,6 +231,11 @@ scan(xcb_query_tree_cookie_t tree_c)
     xcb_get_window_attributes_cookie_t attr_wins[tree_c_len];
     xcb_get_property_cookie_t state_wins[tree_c_len];
     xcb_get_geometry_cookie_t geom_wins[tree_c_len];
+    xcb_get_window_attributes_reply_t *attr_r[tree_c_len];
+    xcb_get_geometry_reply_t *geom_r[tree_c_len];
+    client_manage_cookies_t manage_wins[tree_c_len];
+    xcb_void_cookie_t reparent_wins[tree_c_len];
+    bool managed[tree_c_len];
 
     for(i = 0; i < tree_c_len; i++)
     {
@@ -229,33 +246,53 @@ scan(xcb_query_tree_cookie_t tree_c)
         geom_wins[i] = xcb_get_geometry_unchecked(globalconf.connection, wins[i]);
     }
 
+    /* Filter out the windows that should not be managed and send everything
+     * client_manage() needs for the others */
     for(i = 0; i < tree_c_len; i++)
     {
-        attr_r = xcb_get_window_attributes_reply(globalconf.connection,
-                                                 attr_wins[i],
-                                                 NULL);
-        geom_r = xcb_get_geometry_reply(globalconf.connection, geom_wins[i], NULL);
+        attr_r[i] = A_XCB_WAIT(xcb_get_window_attributes_reply(globalconf.connection,
+                                                    attr_wins[i],
+                                                    NULL));
+        geom_r[i] = A_XCB_WAIT(xcb_get_geometry_reply(globalconf.connection, geom_wins[i], NULL));
 
         long state = xwindow_get_state_reply(state_wins[i]);
 
-        if(!geom_r || !attr_r || attr_r->override_redirect
-           || attr_r->map_state == XCB_MAP_STATE_UNMAPPED
+        if(!geom_r[i] || !attr_r[i] || attr_r[i]->override_redirect
+           || attr_r[i]->map_state == XCB_MAP_STATE_UNMAPPED
            || state == XCB_ICCCM_WM_STATE_WITHDRAWN)
         {
-            p_delete(&attr_r);
-            p_delete(&geom_r);
+            p_delete(&attr_r[i]);
+            p_delete(&geom_r[i]);
             continue;
         }
 
-        client_manage(wins[i], geom_r, attr_r);
+        client_manage_request(wins[i], &manage_wins[i]);
+    }
 
-        p_delete(&attr_r);
-        p_delete(&geom_r);
+    for(i = 0; i < tree_c_len; i++)
+    {
+        managed[i] = false;
+        if(!geom_r[i])
+            continue;
+
+        reparent_wins[i].sequence = 0;
+        client_manage(wins[i], geom_r[i], attr_r[i], &manage_wins[i], &reparent_wins[i]);
+        managed[i] = reparent_wins[i].sequence != 0;
+
+        p_delete(&attr_r[i]);
+        p_delete(&geom_r[i]);
     }
 
+    /* Only the first check has to wait for the X server */
+    for(i = 0; i < tree_c_len; i++)
+        if(managed[i])
+            client_manage_check(wins[i], reparent_wins[i]);
+
     p_delete(&tree_r);
 
     restore_client_order(prop_cookie);
+
+    return (g_get_monotonic_time() - start) / 1e6;
 }
 
 static void
@@ -287,7 +324,7 @@ acquire_WM_Sn(bool replace)
 
     p_delete(&atom_name);
 
-    atom_r = xcb_intern_atom_reply(globalconf.connection, atom_q, NULL);
+    atom_r = A_XCB_WAIT(xcb_intern_atom_reply(globalconf.connection, atom_q, NULL));
     if(!atom_r)
         fatal("error getting WM_Sn atom");
 
@@ -295,9 +332,9 @@ acquire_WM_Sn(bool replace)
     p_delete(&atom_r);
 
     /* Is the selection already owned? */
-    get_sel_reply = xcb_get_selection_owner_reply(globalconf.connection,
+    get_sel_reply = A_XCB_WAIT(xcb_get_selection_owner_reply(globalconf.connection,
             xcb_get_selection_owner(globalconf.connection, globalconf.selection_atom),
-            NULL);
+            NULL));
     if (!get_sel_reply)
         fatal("GetSelectionOwner for WM_Sn failed");
     if (!replace && get_sel_reply->owner != XCB_NONE)
@@ -312,9 +349,9 @@ acquire_WM_Sn(bool replace)
         xcb_get_geometry_reply_t *geom_reply = NULL;
         do {
             p_delete(&geom_reply);
-            geom_reply = xcb_get_geometry_reply(globalconf.connection,
+            geom_reply = A_XCB_WAIT(xcb_get_geometry_reply(globalconf.connection,
                     xcb_get_geometry(globalconf.connection, get_sel_reply->owner),
-                    NULL);
+                    NULL));
         } while (geom_reply != NULL);
     }
     p_delete(&get_sel_reply);
@@ -386,36 +423,56 @@ static xcb_generic_event_t *poll_for_event(void)
     return xcb_poll_for_event(globalconf.connection);
 }
 
+DO_ARRAY(xcb_generic_event_t *, event, DO_NOTHING)
+
 static void
 a_xcb_check(void)
 {
+    static event_array_t events;
     xcb_generic_event_t *mouse = NULL, *event;
+    gint64 start = stats_now();
 
+    /* Read everything that is queued, drop what later events make redundant
+     * and handle the rest. Handlers may cause more events to be read. */
     while((event = poll_for_event()))
     {
-        /* We will treat mouse events later.
-         * We cannot afford to treat all mouse motion events,
-         * because that would be too much CPU intensive, so we just
-         * take the last we get after a bunch of events. */
-        if(XCB_EVENT_RESPONSE_TYPE(event) == XCB_MOTION_NOTIFY)
-        {
-            p_delete(&mouse);
-            mouse = event;
-        }
-        else
+        do
+            event_array_append(&events, event);
+        while((event = poll_for_event()));
+
+        event_coalesce(events.tab, events.len);
+
+        for(int i = 0; i < events.len; i++)
         {
-            uint8_t type = XCB_EVENT_RESPONSE_TYPE(event);
-            if(mouse && (type == XCB_ENTER_NOTIFY || type == XCB_LEAVE_NOTIFY
-                        || type == XCB_BUTTON_PRESS || type == XCB_BUTTON_RELEASE))
+            event = events.tab[i];
+            if(!event)
+                continue;
+
+            /* We will treat mouse events later.
+             * We cannot afford to treat all mouse motion events,
+             * because that would be too much CPU intensive, so we just
+             * take the last we get after a bunch of events. */
+            if(XCB_EVENT_RESPONSE_TYPE(event) == XCB_MOTION_NOTIFY)
             {
-                /* Make sure enter/motion/leave/press/release events are handled
-                 * in the correct order */
-                event_handle(mouse);
                 p_delete(&mouse);
+                mouse = event;
+            }
+            else
+            {
+                uint8_t type = XCB_EVENT_RESPONSE_TYPE(event);
+                if(mouse && (type == XCB_ENTER_NOTIFY || type == XCB_LEAVE_NOTIFY
+                            || type == XCB_BUTTON_PRESS || type == XCB_BUTTON_RELEASE))
+                {
+                    /* Make sure enter/motion/leave/press/release events are handled
+                     * in the correct order */
+                    event_handle(mouse);
+                    p_delete(&mouse);
+                }
+                event_handle(event);
+                p_delete(&event);
             }
-            event_handle(event);
-            p_delete(&event);
         }
+        events.len = 0;
     }
 
     if(mouse)
@@ -423,6 +480,8 @@ a_xcb_check(void)
         event_handle(mouse);
         p_delete(&mouse);
     }
+
+    stats_record(STATS_PHASE_EVENT_HANDLING, start);
 }
 
 static gboolean
@@ -448,6 +507,7 @@ a_glib_poll(GPollFD *ufds, guint nfsd, gint timeout)
 
     /* Do all deferred work now */
     awesome_refresh();
+    stats_iteration_end();
 
     /* Check if the Lua stack is the way it should be */
     if (lua_gettop(L) != 0) {
@@ -476,6 +536,7 @@ a_glib_poll(GPollFD *ufds, guint nfsd, gint timeout)
     res = g_poll(ufds, nfsd, timeout);
     saved_errno = errno;
     gettimeofday(&last_wakeup, NULL);
+    stats_wakeup();
     a_xcb_check();
     errno = saved_errno;
 
@@ -718,6 +779,9 @@ main(int argc, char **argv)
     xcb_prefetch_extension_data(globalconf.connection, &xcb_xinerama_id);
     xcb_prefetch_extension_data(globalconf.connection, &xcb_shape_id);
     xcb_prefetch_extension_data(globalconf.connection, &xcb_xfixes_id);
+    xcb_prefetch_extension_data(globalconf.connection, &xcb_shm_id);
+    xcb_prefetch_extension_data(globalconf.connection, &xcb_composite_id);
+    xcb_prefetch_extension_data(globalconf.connection, &xcb_damage_id);
 
     if (xcb_cursor_context_new(globalconf.connection, globalconf.screen, &globalconf.cursor_ctx) < 0)
         fatal("Failed to initialize xcb-cursor");
@@ -753,7 +817,7 @@ main(int argc, char **argv)
         cookie = xcb_change_window_attributes_checked(globalconf.connection,
                                                       globalconf.screen->root,
                                                       XCB_CW_EVENT_MASK, &select_input_val);
-        if (xcb_request_check(globalconf.connection, cookie))
+        if (A_XCB_WAIT(xcb_request_check(globalconf.connection, cookie)))
             fatal("another window manager is already running (can't select SubstructureRedirect)");
     }
 
@@ -771,9 +835,9 @@ main(int argc, char **argv)
     if (globalconf.have_shape)
     {
         xcb_shape_query_version_reply_t *reply =
-            xcb_shape_query_version_reply(globalconf.connection,
+            A_XCB_WAIT(xcb_shape_query_version_reply(globalconf.connection,
                     xcb_shape_query_version_unchecked(globalconf.connection),
-                    NULL);
+                    NULL));
         globalconf.have_input_shape = reply && (reply->major_version > 1 ||
                 (reply->major_version == 1 && reply->minor_version >= 1));
         p_delete(&reply);
@@ -786,6 +850,31 @@ main(int argc, char **argv)
         xcb_discard_reply(globalconf.connection,
                 xcb_xfixes_query_version(globalconf.connection, 1, 0).sequence);
 
+    /* check for MIT-SHM extension */
+    query = xcb_get_extension_data(globalconf.connection, &xcb_shm_id);
+    globalconf.have_shm = query && query->present;
+
+    /* check for Composite extension, NameWindowPixmap needs 0.2 */
+    query = xcb_get_extension_data(globalconf.connection, &xcb_composite_id);
+    globalconf.have_composite = query && query->present;
+    if (globalconf.have_composite)
+    {
+        xcb_composite_query_version_reply_t *reply =
+            A_XCB_WAIT(xcb_composite_query_version_reply(globalconf.connection,
+                    xcb_composite_query_version_unchecked(globalconf.connection, 0, 4),
+                    NULL));
+        globalconf.have_composite = reply && (reply->major_version > 0 ||
+                reply->minor_version >= 2);
+        p_delete(&reply);
+    }
+
+    /* check for DAMAGE extension, which has to be told our version first */
+    query = xcb_get_extension_data(globalconf.connection, &xcb_damage_id);
+    globalconf.have_damage = query && query->present;
+    if (globalconf.have_damage)
+        xcb_discard_reply(globalconf.connection,
+                xcb_damage_query_version(globalconf.connection, 1, 1).sequence);
+
     event_init();
 
     /* Allocate the key symbols */
@@ -793,6 +882,7 @@ main(int argc, char **argv)
 
     /* init atom cache */
     atoms_init(globalconf.connection);
+    property_handlers_init();
 
     ewmh_init();
     systray_init();
@@ -884,9 +974,9 @@ main(int argc, char **argv)
     client_emit_scanning();
 
     /* scan existing windows */
-    scan(tree_c);
+    double scan_time = scan(tree_c);
 
-    client_emit_scanned();
+    client_emit_scanned(scan_time);
 
     luaA_emit_startup();
 
@@ -148,6 +148,9 @@ set(AWESOME_DEPENDENCIES
     xcb-icccm
     xcb-icccm>=0.3.8
     xcb-xfixes
+    xcb-shm
+    xcb-composite
+    xcb-damage
     # NOTE: it's not clear what version is required, but 1.10 works at least.
     # See https://github.com/awesomeWM/awesome/pull/149#issuecomment-94208356.
     xcb-xkb
@@ -196,6 +199,20 @@ else()
     message(STATUS "checking for round -- builtin")
 endif()
 
+# Do we need librt for timer_create()? Only the profiler uses it.
+check_symbol_exists(timer_create time.h HAS_TIMER_CREATE_WITHOUT_LIBRT)
+if(NOT HAS_TIMER_CREATE_WITHOUT_LIBRT)
+    find_library(LIB_RT rt)
+    if(LIB_RT)
+        set(AWESOME_REQUIRED_LDFLAGS ${AWESOME_REQUIRED_LDFLAGS} ${LIB_RT})
+        message(STATUS "checking for timer_create -- in librt")
+    else()
+        message(STATUS "checking for timer_create -- not found")
+    endif()
+else()
+    message(STATUS "checking for timer_create -- builtin")
+endif()
+
 set(AWESOME_REQUIRED_LDFLAGS
     ${AWESOME_COMMON_REQUIRED_LDFLAGS}
     ${AWESOME_REQUIRED_LDFLAGS}
@@ -23,26 +23,47 @@
 #include "globalconf.h"
 #include "objects/client.h"
 
-/** Reban windows following current selected tags.
+/** Clients whose visibility might have changed since the last refresh */
+static client_array_t banning_pending;
+
+/** Statistics about the last banning_refresh() */
+static banning_stats_t banning_stats;
+
+/** Note that the visibility of a client might have changed.
+ * \param c The client.
  */
 void
-banning_need_update(void)
+banning_client_need_update(client_t *c)
 {
-    /* We update the complete banning only once per main loop to avoid
+    /* We update the banning only once per main loop to avoid
      * excessive updates...  */
     globalconf.need_lazy_banning = true;
 
-    /* But if a client will be banned in our next update we unfocus it now. */
-    foreach(_c, globalconf.clients)
+    if(!c->banning_pending)
     {
-        client_t *c = *_c;
-
-        if(!client_isvisible(c))
-            client_ban_unfocus(c);
+        c->banning_pending = true;
+        client_array_append(&banning_pending, c);
     }
+
+    /* But if the client will be banned in our next update we unfocus it now. */
+    if(!client_isvisible(c))
+        client_ban_unfocus(c);
 }
 
-/** Check all clients if they need to rebanned
+/** Forget about a client that is being unmanaged.
+ * \param c The client.
+ */
+void
+banning_client_remove(client_t *c)
+{
+    c->banning_pending = false;
+    /* Do not shift the array, we might be in the middle of a refresh */
+    foreach(item, banning_pending)
+        if(*item == c)
+            *item = NULL;
+}
+
+/** Ban or unban the clients whose visibility changed.
  */
 void
 banning_refresh(void)
@@ -50,17 +71,57 @@ banning_refresh(void)
     if (!globalconf.need_lazy_banning)
         return;
 
-    globalconf.need_lazy_banning = false;
+    banning_stats.checked = banning_stats.banned = banning_stats.unbanned = 0;
 
-    foreach(c, globalconf.clients)
-        if(client_isvisible(*c))
-            client_unban(*c);
+    /* Banning and unbanning runs Lua code, which might change the visibility
+     * of more clients. Those get appended and are handled in another round. */
+    for(int done = 0; done < banning_pending.len;)
+    {
+        int end = banning_pending.len;
 
-    /* Some people disliked the short flicker of background, so we first unban everything.
-     * Afterwards we ban everything we don't want. This should avoid that. */
-    foreach(c, globalconf.clients)
-        if(!client_isvisible(*c))
-            client_ban(*c);
+        for(int i = done; i < end; i++)
+            if(banning_pending.tab[i])
+            {
+                banning_pending.tab[i]->banning_pending = false;
+                banning_stats.checked++;
+            }
+
+        for(int i = done; i < end; i++)
+        {
+            client_t *c = banning_pending.tab[i];
+            if(c && c->isbanned && client_isvisible(c))
+            {
+                client_unban(c);
+                banning_stats.unbanned++;
+            }
+        }
+
+        /* Some people disliked the short flicker of background, so we first unban everything.
+         * Afterwards we ban everything we don't want. This should avoid that. */
+        for(int i = done; i < end; i++)
+        {
+            client_t *c = banning_pending.tab[i];
+            if(c && !c->isbanned && !client_isvisible(c))
+            {
+                client_ban(c);
+                banning_stats.banned++;
+            }
+        }
+
+        done = end;
+    }
+
+    banning_pending.len = 0;
+    globalconf.need_lazy_banning = false;
+}
+
+/** Get statistics about the last banning refresh.
+ * \return The number of clients checked, banned and unbanned.
+ */
+const banning_stats_t *
+banning_get_stats(void)
+{
+    return &banning_stats;
 }
 
 // vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
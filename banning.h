@@ -22,8 +22,22 @@
 #ifndef AWESOME_BANNING_H
 #define AWESOME_BANNING_H
 
-void banning_need_update(void);
+typedef struct client_t client_t;
+
+typedef struct
+{
+    /** Clients whose visibility was checked */
+    int checked;
+    /** Clients that got banned */
+    int banned;
+    /** Clients that got unbanned */
+    int unbanned;
+} banning_stats_t;
+
+void banning_client_need_update(client_t *);
+void banning_client_remove(client_t *);
 void banning_refresh(void);
+const banning_stats_t *banning_get_stats(void);
 
 #endif
 // vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
@@ -22,6 +22,7 @@
 
 #include "color.h"
 #include "globalconf.h"
+#include "stats.h"
 
 #include <ctype.h>
 
@@ -182,8 +183,8 @@ color_init_reply(color_init_request_t req)
 
     xcb_alloc_color_reply_t *hexa_color;
 
-    if((hexa_color = xcb_alloc_color_reply(globalconf.connection,
-                                           req.cookie_hexa, NULL)))
+    if((hexa_color = A_XCB_WAIT(xcb_alloc_color_reply(globalconf.connection,
+                                           req.cookie_hexa, NULL))))
     {
         req.color->pixel = hexa_color->pixel;
         req.color->red   = hexa_color->red;
@@ -36,10 +36,56 @@ struct lua_class_property
     lua_class_propfunc_t newindex;
 };
 
+/** Number of entries in the property cache of a class, a power of two */
+#define LUA_CLASS_CACHE_SIZE 128
+
+/** What a field name of an object resolves to */
+struct lua_class_cache_entry
+{
+    /** The contents of the Lua string with the field name. The string is kept
+     * alive by the anchor table while it is in the cache, so no other string
+     * can get the same address. */
+    const char *key;
+    /** Value of lua_class_cache_generation when the entry was filled */
+    unsigned int generation;
+    /** The class whose metatable has this field, if any */
+    lua_class_t *metatable_owner;
+    /** The property with that name, if any */
+    lua_class_property_t *prop;
+    /** Fields handled by luaA_class_index() itself */
+    enum
+    {
+        LUA_CLASS_FIELD_NONE,
+        LUA_CLASS_FIELD_VALID,
+        LUA_CLASS_FIELD_PRIVATE,
+        LUA_CLASS_FIELD_DATA
+    } special;
+};
+
 DO_ARRAY(lua_class_t *, lua_class, DO_NOTHING)
 
 static lua_class_array_t luaA_classes;
 
+/** Bumped whenever cached entries might have become wrong */
+static unsigned int lua_class_cache_generation = 1;
+/** Registry reference of the table keeping the cached field names alive */
+static int lua_class_cache_anchor = LUA_NOREF;
+
+/** Number of entries in the signal id cache, a power of two */
+#define SIGNAL_ID_CACHE_SIZE 256
+
+/** The id of a signal name passed from Lua */
+typedef struct
+{
+    /** The contents of the Lua string, kept alive by the anchor table */
+    const char *key;
+    unsigned long id;
+} signal_id_cache_entry_t;
+
+static signal_id_cache_entry_t signal_id_cache[SIGNAL_ID_CACHE_SIZE];
+/** Registry reference of the table keeping the cached signal names alive */
+static int signal_id_cache_anchor = LUA_NOREF;
+
 /** Convert a object to a udata if possible.
  * \param L The Lua VM state.
  * \param ud The index.
@@ -163,6 +209,22 @@ luaA_class_add_property(lua_class_t *lua_class,
                                         .index = cb_index,
                                         .newindex = cb_newindex
                                     });
+    /* Cached entries may point into the reallocated property array */
+    lua_class_cache_generation++;
+}
+
+/** Newindex meta function for the metatables of classes. A new field can hide
+ * a property or a field of a parent class, so cached lookups have to be done
+ * again. Fields written with rawset() are not noticed.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ */
+static int
+luaA_class_metatable_newindex(lua_State *L)
+{
+    lua_rawset(L, 1);
+    lua_class_cache_generation++;
+    return 0;
 }
 
 /** Newindex meta function for objects after they were GC'd.
@@ -261,6 +323,12 @@ luaA_class_setup(lua_State *L, lua_class_t *class,
     lua_pushlightuserdata(L, class);
     lua_rawset(L, LUA_REGISTRYINDEX);
 
+    /* Notice fields that are added to the object metatable later */
+    lua_newtable(L);
+    lua_pushcfunction(L, luaA_class_metatable_newindex);
+    lua_setfield(L, -2, "__newindex");
+    lua_setmetatable(L, -2);
+
     /* Duplicate objects metatable */
     lua_pushvalue(L, -1);
     /* Set garbage collector in the metatable */
@@ -338,7 +406,53 @@ void
 luaA_class_emit_signal(lua_State *L, lua_class_t *lua_class,
                        const char *name, int nargs)
 {
-    signal_object_emit(L, &lua_class->signals, name, nargs);
+    signal_object_emit_class(L, &lua_class->signals, lua_class->name, signal_id(name), nargs);
+}
+
+void
+luaA_class_emit_signal_id(lua_State *L, lua_class_t *lua_class,
+                          unsigned long id, int nargs)
+{
+    signal_object_emit_class(L, &lua_class->signals, lua_class->name, id, nargs);
+}
+
+/** Get the id of a signal name on the stack.
+ * Lua strings are interned, so the id is cached by the address of the string
+ * and the name only gets hashed the first time it is seen.
+ * \param L The Lua VM state.
+ * \param idx The index of the signal name, must be positive.
+ * \return The signal id, as signal_id() would return it.
+ */
+unsigned long
+luaA_signal_id(lua_State *L, int idx)
+{
+    const char *key = luaL_checkstring(L, idx);
+
+    /* luaL_checkstring() converts numbers in place, they are not worth it */
+    if(lua_type(L, idx) != LUA_TSTRING)
+        return signal_id(key);
+
+    uintptr_t h = (uintptr_t) key;
+    h = (h >> 4) ^ (h >> 11);
+
+    signal_id_cache_entry_t *entry = &signal_id_cache[h & (SIGNAL_ID_CACHE_SIZE - 1)];
+    if(entry->key == key)
+        return entry->id;
+
+    /* Keep the string alive while the entry refers to it */
+    if(signal_id_cache_anchor == LUA_NOREF)
+    {
+        lua_newtable(L);
+        signal_id_cache_anchor = luaL_ref(L, LUA_REGISTRYINDEX);
+    }
+    lua_rawgeti(L, LUA_REGISTRYINDEX, signal_id_cache_anchor);
+    lua_pushvalue(L, idx);
+    lua_rawseti(L, -2, (int) (entry - signal_id_cache) + 1);
+    lua_pop(L, 1);
+
+    entry->key = key;
+    entry->id = signal_id(key);
+    return entry->id;
 }
 
 /** Try to use the metatable of an object.
@@ -409,6 +523,120 @@ luaA_class_property_get(lua_State *L, lua_class_t *lua_class, int fieldidx)
     return NULL;
 }
 
+/** Find out what a field of an object of a class resolves to.
+ * \param L The Lua VM state.
+ * \param class The Lua class.
+ * \param fieldidx The index of the field name, must be positive.
+ * \param entry The entry to fill, its key and generation are not touched.
+ */
+static void
+luaA_class_resolve(lua_State *L, lua_class_t *class, int fieldidx,
+                   lua_class_cache_entry_t *entry)
+{
+    entry->metatable_owner = NULL;
+    entry->prop = NULL;
+    entry->special = LUA_CLASS_FIELD_NONE;
+
+    /* The metatables come first, like luaA_usemetatable() */
+    for(lua_class_t *c = class; c; c = c->parent)
+    {
+        lua_pushlightuserdata(L, c);
+        lua_rawget(L, LUA_REGISTRYINDEX);
+        lua_pushvalue(L, fieldidx);
+        lua_rawget(L, -2);
+        bool found = !lua_isnil(L, -1);
+        lua_pop(L, 2);
+        if(found)
+        {
+            entry->metatable_owner = c;
+            return;
+        }
+    }
+
+    const char *attr = luaL_checkstring(L, fieldidx);
+    if (A_STREQ(attr, "valid"))
+        entry->special = LUA_CLASS_FIELD_VALID;
+    else if (A_STREQ(attr, "_private"))
+        entry->special = LUA_CLASS_FIELD_PRIVATE;
+    else if (A_STREQ(attr, "data"))
+        entry->special = LUA_CLASS_FIELD_DATA;
+
+    entry->prop = luaA_class_property_get(L, class, fieldidx);
+}
+
+/** Get what a field of an object of a class resolves to, using the per-class
+ * cache when the field name is a string.
+ * \param L The Lua VM state.
+ * \param class The Lua class.
+ * \param fieldidx The index of the field name, must be positive.
+ * \param tmp An entry to use when the field can not be cached.
+ * \return The cache entry, or tmp.
+ */
+static lua_class_cache_entry_t *
+luaA_class_cache_get(lua_State *L, lua_class_t *class, int fieldidx,
+                     lua_class_cache_entry_t *tmp)
+{
+    if(lua_type(L, fieldidx) != LUA_TSTRING)
+    {
+        luaA_class_resolve(L, class, fieldidx, tmp);
+        return tmp;
+    }
+
+    /* Lua strings are interned, the same name gives the same pointer */
+    const char *key = lua_tostring(L, fieldidx);
+    uintptr_t h = (uintptr_t) key;
+    h = (h >> 4) ^ (h >> 11);
+
+    if(!class->cache)
+        class->cache = p_new(lua_class_cache_entry_t, LUA_CLASS_CACHE_SIZE);
+
+    lua_class_cache_entry_t *entry = &class->cache[h & (LUA_CLASS_CACHE_SIZE - 1)];
+    if(entry->key == key && entry->generation == lua_class_cache_generation)
+        return entry;
+
+    entry->key = NULL;
+    luaA_class_resolve(L, class, fieldidx, entry);
+
+    /* Keep the string alive while the entry refers to it: anchor[entry] = key */
+    if(lua_class_cache_anchor == LUA_NOREF)
+    {
+        lua_newtable(L);
+        lua_class_cache_anchor = luaL_ref(L, LUA_REGISTRYINDEX);
+    }
+    lua_rawgeti(L, LUA_REGISTRYINDEX, lua_class_cache_anchor);
+    lua_pushlightuserdata(L, entry);
+    lua_pushvalue(L, fieldidx);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    entry->key = key;
+    entry->generation = lua_class_cache_generation;
+    return entry;
+}
+
+/** Push the field of an object from the metatable of a class.
+ * \param L The Lua VM state.
+ * \param entry The resolved field, with a metatable owner.
+ * \return True if the field was pushed, false if the metatable changed.
+ */
+static bool
+luaA_class_cache_push_metatable_field(lua_State *L, lua_class_cache_entry_t *entry)
+{
+    lua_pushlightuserdata(L, entry->metatable_owner);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    lua_pushvalue(L, 2);
+    lua_rawget(L, -2);
+    if(lua_isnil(L, -1))
+    {
+        /* Somebody removed it, forget about it */
+        lua_pop(L, 2);
+        entry->key = NULL;
+        return false;
+    }
+    lua_remove(L, -2);
+    return true;
+}
+
 /** Generic index meta function for objects.
  * \param L The Lua VM state.
  * \return The number of elements pushed on stack.
@@ -416,16 +644,25 @@ luaA_class_property_get(lua_State *L, lua_class_t *lua_class, int fieldidx)
 int
 luaA_class_index(lua_State *L)
 {
-    /* Try to use metatable first. */
-    if(luaA_usemetatable(L, 1, 2))
-        return 1;
-
     lua_class_t *class = luaA_class_get(L, 1);
+    lua_class_cache_entry_t tmp;
+
+    if(!class)
+        return luaA_usemetatable(L, 1, 2);
+
+    lua_class_cache_entry_t *entry = luaA_class_cache_get(L, class, 2, &tmp);
+
+    /* Try to use metatable first. */
+    if(entry->metatable_owner)
+    {
+        if(luaA_class_cache_push_metatable_field(L, entry))
+            return 1;
+        return luaA_class_index(L);
+    }
 
     /* Is this the special 'valid' property? This is the only property
      * accessible for invalid objects and thus needs special handling. */
-    const char *attr = luaL_checkstring(L, 2);
-    if (A_STREQ(attr, "valid"))
+    if (entry->special == LUA_CLASS_FIELD_VALID)
     {
         void *p = luaA_toudata(L, 1, class);
         if (class->checker)
@@ -435,18 +672,16 @@ luaA_class_index(lua_State *L)
         return 1;
     }
 
-    lua_class_property_t *prop = luaA_class_property_get(L, class, 2);
-
     /* This is the table storing the object private variables.
      */
-    if (A_STREQ(attr, "_private"))
+    if (entry->special == LUA_CLASS_FIELD_PRIVATE)
     {
         luaA_checkudata(L, 1, class);
         luaA_getuservalue(L, 1);
         lua_getfield(L, -1, "data");
         return 1;
     }
-    else if (A_STREQ(attr, "data"))
+    else if (entry->special == LUA_CLASS_FIELD_DATA)
     {
         luaA_deprecate(L, "Use `._private` instead of `.data`");
         luaA_checkudata(L, 1, class);
@@ -455,6 +690,8 @@ luaA_class_index(lua_State *L)
         return 1;
     }
 
+    lua_class_property_t *prop = entry->prop;
+
     /* Property does exist and has an index callback */
     if(prop)
     {
@@ -479,13 +716,23 @@ luaA_class_index(lua_State *L)
 int
 luaA_class_newindex(lua_State *L)
 {
-    /* Try to use metatable first. */
-    if(luaA_usemetatable(L, 1, 2))
-        return 1;
-
     lua_class_t *class = luaA_class_get(L, 1);
+    lua_class_cache_entry_t tmp;
+
+    if(!class)
+        return luaA_usemetatable(L, 1, 2);
+
+    lua_class_cache_entry_t *entry = luaA_class_cache_get(L, class, 2, &tmp);
+
+    /* Try to use metatable first. */
+    if(entry->metatable_owner)
+    {
+        if(luaA_class_cache_push_metatable_field(L, entry))
+            return 1;
+        return luaA_class_newindex(L);
+    }
 
-    lua_class_property_t *prop = luaA_class_property_get(L, class, 2);
+    lua_class_property_t *prop = entry->prop;
 
     /* Property does exist and has a newindex callback */
     if(prop)
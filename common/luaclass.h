@@ -28,6 +28,7 @@
 #include <lauxlib.h>
 
 typedef struct lua_class_property lua_class_property_t;
+typedef struct lua_class_cache_entry lua_class_cache_entry_t;
 
 ARRAY_TYPE(lua_class_property_t, lua_class_property)
 
@@ -78,6 +79,8 @@ struct lua_class_t
     int index_miss_handler;
     /** Function to call on newindex misses */
     int newindex_miss_handler;
+    /** Cache of resolved property names, allocated on first use */
+    lua_class_cache_entry_t *cache;
 };
 
 const char * luaA_typename(lua_State *, int);
@@ -87,6 +90,8 @@ void luaA_class_connect_signal(lua_State *, lua_class_t *, const char *, lua_CFu
 void luaA_class_connect_signal_from_stack(lua_State *, lua_class_t *, const char *, int);
 void luaA_class_disconnect_signal_from_stack(lua_State *, lua_class_t *, const char *, int);
 void luaA_class_emit_signal(lua_State *, lua_class_t *, const char *, int);
+void luaA_class_emit_signal_id(lua_State *, lua_class_t *, unsigned long, int);
+unsigned long luaA_signal_id(lua_State *, int);
 
 void luaA_openlib(lua_State *, const char *, const struct luaL_Reg[], const struct luaL_Reg[]);
 void luaA_class_setup(lua_State *, lua_class_t *, const char *, lua_class_t *,
@@ -146,8 +151,8 @@ luaA_checkudataornil(lua_State *L, int udx, lua_class_t *class)
     static inline int                                                          \
     luaA_##prefix##_class_emit_signal(lua_State *L)                            \
     {                                                                          \
-        luaA_class_emit_signal(L, &(lua_class), luaL_checkstring(L, 1),        \
-                               lua_gettop(L) - 1);                             \
+        luaA_class_emit_signal_id(L, &(lua_class), luaA_signal_id(L, 1),       \
+                                  lua_gettop(L) - 1);                          \
         return 0;                                                              \
     }                                                                          \
                                                                                \
@@ -21,6 +21,7 @@
 #include "luaa.h"
 
 lua_CFunction lualib_dofunction_on_error;
+lualib_context_t lualib_context;
 
 void luaA_checkfunction(lua_State *L, int idx)
 {
@@ -30,6 +30,55 @@
 /** Lua function to call on dofunction() error */
 extern lua_CFunction lualib_dofunction_on_error;
 
+/** The C code that is currently calling into Lua, outermost first */
+typedef struct
+{
+    /** The frames are only recorded while this is set (by the profiler) */
+    bool enabled;
+    /** Number of frames, can be larger than countof(frames) */
+    int len;
+    struct
+    {
+        /** What kind of code this is, e.g. "signal" or "event" */
+        const char *kind;
+        /** A copy of the name, signals can be freed by their own handlers */
+        char name[64];
+    } frames[16];
+} lualib_context_t;
+
+extern lualib_context_t lualib_context;
+
+/** Record that C code is about to call into Lua.
+ * \param kind What kind of code this is, must be a static string.
+ * \param name The name of the signal, event... It is copied.
+ * \return The value to pass to lualib_context_leave().
+ */
+static inline int
+lualib_context_enter(const char *kind, const char *name)
+{
+    if(!lualib_context.enabled)
+        return -1;
+
+    int depth = lualib_context.len++;
+    if(depth < countof(lualib_context.frames))
+    {
+        lualib_context.frames[depth].kind = kind;
+        a_strcpy(lualib_context.frames[depth].name,
+                 sizeof(lualib_context.frames[depth].name), NONULL(name));
+    }
+    return depth;
+}
+
+/** Undo lualib_context_enter().
+ * \param depth The value returned by lualib_context_enter().
+ */
+static inline void
+lualib_context_leave(int depth)
+{
+    if(depth >= 0)
+        lualib_context.len = depth;
+}
+
 void luaA_checkfunction(lua_State *, int);
 void luaA_checktable(lua_State *, int);
 
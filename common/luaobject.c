@@ -30,6 +30,11 @@
 #include "common/luaobject.h"
 #include "common/backtrace.h"
 
+#include <time.h>
+
+/** Reference of the object registry table in the Lua registry */
+int luaA_object_registry_ref = LUA_NOREF;
+
 /** Setup the object system at startup.
  * \param L The Lua VM state.
  */
@@ -45,6 +50,9 @@ luaA_object_setup(lua_State *L)
     /* Set this empty table as the registry metatable.
      * It's used to store the number of reference on stored objects. */
     lua_setmetatable(L, -2);
+    /* Keep a reference for luaA_object_registry_push() */
+    lua_pushvalue(L, -1);
+    luaA_object_registry_ref = luaL_ref(L, LUA_REGISTRYINDEX);
     /* Register table inside registry */
     lua_rawset(L, LUA_REGISTRYINDEX);
 }
@@ -227,35 +235,234 @@ luaA_object_disconnect_signal_from_stack(lua_State *L, int oud,
     lua_remove(L, ud);
 }
 
-void
-signal_object_emit(lua_State *L, signal_array_t *arr, const char *name, int nargs)
+/** Dispatch statistics of one signal of one class */
+typedef struct
 {
-    signal_t *sigfound = signal_array_getbyname(arr, name);
+    /** The class name, or NULL for signals that do not belong to a class */
+    const char *class_name;
+    unsigned long id;
+    char *name;
+    /** Number of emissions that had at least one handler */
+    unsigned long count;
+    /** Number of handlers that were called */
+    unsigned long handlers;
+    /** Time spent in the handlers, including nested emissions, in seconds */
+    double time;
+    double max_time;
+} signal_profile_t;
+
+static int
+signal_profile_cmp(const void *a, const void *b)
+{
+    const signal_profile_t *x = a, *y = b;
+    if(x->id != y->id)
+        return x->id > y->id ? 1 : -1;
+    return a_strcmp(x->class_name, y->class_name);
+}
 
-    if(sigfound)
+static void
+signal_profile_wipe(signal_profile_t *profile)
+{
+    p_delete(&profile->name);
+}
+
+DO_BARRAY(signal_profile_t, signal_profile, signal_profile_wipe, signal_profile_cmp)
+
+static bool signal_profile_enabled;
+static signal_profile_array_t signal_profiles;
+
+static double
+signal_profile_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/** Start measuring the emission of a signal.
+ * \param class_name The class of the emitting object, or NULL.
+ * \param sig The signal that is about to be emitted.
+ * \return The value to pass to signal_profile_end().
+ */
+static double
+signal_profile_begin(const char *class_name, signal_t *sig)
+{
+    if(!signal_profile_enabled)
+        return 0;
+
+    /* Handlers may add entries, only the key is kept until the end */
+    signal_profile_t key = { .class_name = class_name, .id = sig->id };
+    if(!signal_profile_array_lookup(&signal_profiles, &key))
     {
-        int nbfunc = sigfound->sigfuncs.len;
-        luaL_checkstack(L, nbfunc + nargs + 1, "too much signal");
-        /* Push all functions and then execute, because this list can change
-         * while executing funcs. */
-        foreach(func, sigfound->sigfuncs)
-            luaA_object_push(L, *func);
+        key.name = a_strdup(sig->name);
+        signal_profile_array_insert(&signal_profiles, key);
+    }
+    return signal_profile_now();
+}
 
-        for(int i = 0; i < nbfunc; i++)
+/** Record the emission of a signal.
+ * \param class_name The class of the emitting object, or NULL.
+ * \param id The signal id.
+ * \param handlers The number of handlers that were called.
+ * \param start The value returned by signal_profile_begin().
+ */
+static void
+signal_profile_end(const char *class_name, unsigned long id, int handlers, double start)
+{
+    signal_profile_t key = { .class_name = class_name, .id = id }, *profile;
+
+    /* Profiling was enabled during the emission or disabled and reset */
+    if(start == 0 || !(profile = signal_profile_array_lookup(&signal_profiles, &key)))
+        return;
+
+    double time = signal_profile_now() - start;
+    profile->count++;
+    profile->handlers += handlers;
+    profile->time += time;
+    profile->max_time = MAX(profile->max_time, time);
+}
+
+static int
+signal_profile_time_cmp(const void *a, const void *b)
+{
+    const signal_profile_t *x = *(const signal_profile_t **) a, *y = *(const signal_profile_t **) b;
+    return (x->time < y->time) - (x->time > y->time);
+}
+
+/** Enable or disable signal dispatch profiling, awesome.profiler.signals().
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ */
+int
+luaA_signal_profile_set_enabled(lua_State *L)
+{
+    signal_profile_enabled = luaA_checkboolean(L, 1);
+    return 0;
+}
+
+/** Forget the signal dispatch statistics, awesome.profiler.reset_signals().
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ */
+int
+luaA_signal_profile_reset(lua_State *L)
+{
+    signal_profile_array_wipe(&signal_profiles);
+    signal_profile_array_init(&signal_profiles);
+    return 0;
+}
+
+/** Push the signal dispatch statistics, awesome.profiler.signal_stats().
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ */
+int
+luaA_signal_profile_stats(lua_State *L)
+{
+    signal_profile_t **sorted = p_alloca(signal_profile_t *, signal_profiles.len);
+
+    for(int i = 0; i < signal_profiles.len; i++)
+        sorted[i] = &signal_profiles.tab[i];
+    qsort(sorted, signal_profiles.len, sizeof(*sorted), signal_profile_time_cmp);
+
+    lua_createtable(L, signal_profiles.len, 0);
+    for(int i = 0; i < signal_profiles.len; i++)
+    {
+        lua_createtable(L, 0, 6);
+        if(sorted[i]->class_name)
         {
-            /* push all args */
-            for(int j = 0; j < nargs; j++)
-                lua_pushvalue(L, - nargs - nbfunc + i);
-            /* push first function */
-            lua_pushvalue(L, - nargs - nbfunc + i);
-            /* remove this first function */
-            lua_remove(L, - nargs - nbfunc - 1 + i);
-            luaA_dofunction(L, nargs, 0);
+            lua_pushstring(L, sorted[i]->class_name);
+            lua_setfield(L, -2, "class");
         }
+        lua_pushstring(L, sorted[i]->name);
+        lua_setfield(L, -2, "name");
+        lua_pushnumber(L, sorted[i]->count);
+        lua_setfield(L, -2, "count");
+        lua_pushnumber(L, sorted[i]->handlers);
+        lua_setfield(L, -2, "handlers");
+        lua_pushnumber(L, sorted[i]->time);
+        lua_setfield(L, -2, "time");
+        lua_pushnumber(L, sorted[i]->max_time);
+        lua_setfield(L, -2, "max_time");
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+}
+
+void
+signal_object_emit(lua_State *L, signal_array_t *arr, const char *name, int nargs)
+{
+    signal_object_emit_id(L, arr, signal_id(name), nargs);
+}
+
+/** Call all handlers of a signal and remove the arguments from the stack.
+ * \param L The Lua VM state.
+ * \param sigfound The signal.
+ * \param nargs The number of arguments on the stack.
+ * \return The number of handlers called.
+ */
+static int
+signal_object_call(lua_State *L, signal_t *sigfound, int nargs)
+{
+    int nbfunc = sigfound->sigfuncs.len;
+    int context = lualib_context_enter("signal", sigfound->name);
+    luaL_checkstack(L, nbfunc + nargs + 1, "too much signal");
+    /* Push all functions and then execute, because this list can change
+     * while executing funcs. */
+    foreach(func, sigfound->sigfuncs)
+        luaA_object_push(L, *func);
+
+    for(int i = 0; i < nbfunc; i++)
+    {
+        /* push all args */
+        for(int j = 0; j < nargs; j++)
+            lua_pushvalue(L, - nargs - nbfunc + i);
+        /* push first function */
+        lua_pushvalue(L, - nargs - nbfunc + i);
+        /* remove this first function */
+        lua_remove(L, - nargs - nbfunc - 1 + i);
+        luaA_dofunction(L, nargs, 0);
     }
+    lualib_context_leave(context);
 
     /* remove args */
     lua_pop(L, nargs);
+    return nbfunc;
+}
+
+/** Emit a signal from the signal array of a class.
+ * \param L The Lua VM state.
+ * \param arr The signal array.
+ * \param class_name The name of the class, used by the signal profiler.
+ * \param id The signal id, as returned by signal_id().
+ * \param nargs The number of arguments on the stack, they are removed.
+ */
+void
+signal_object_emit_class(lua_State *L, signal_array_t *arr, const char *class_name,
+                         unsigned long id, int nargs)
+{
+    signal_t *sigfound = arr->len ? signal_array_getbyid(arr, id) : NULL;
+
+    if(sigfound)
+    {
+        double start = signal_profile_begin(class_name, sigfound);
+        int handlers = signal_object_call(L, sigfound, nargs);
+        signal_profile_end(class_name, id, handlers, start);
+    }
+    else
+        lua_pop(L, nargs);
+}
+
+/** Emit a signal from a signal array, identified by its id.
+ * \param L The Lua VM state.
+ * \param arr The signal array.
+ * \param id The signal id, as returned by signal_id().
+ * \param nargs The number of arguments on the stack, they are removed.
+ */
+void
+signal_object_emit_id(lua_State *L, signal_array_t *arr, unsigned long id, int nargs)
+{
+    signal_object_emit_class(L, arr, NULL, id, nargs);
 }
 
 /** Emit a signal.
@@ -263,25 +470,38 @@ signal_object_emit(lua_State *L, signal_array_t *arr, const char *name, int narg
  * @param[opt] ... Various arguments.
  * @function emit_signal
  */
-void
-luaA_object_emit_signal(lua_State *L, int oud,
-                        const char *name, int nargs)
+static void
+luaA_object_emit_signal_real(lua_State *L, int oud,
+                             const char *name, unsigned long id, int nargs)
 {
     int oud_abs = luaA_absindex(L, oud);
     lua_class_t *lua_class = luaA_class_get(L, oud);
     lua_object_t *obj = luaA_toudata(L, oud, lua_class);
     if(!obj) {
-        luaA_warn(L, "Trying to emit signal '%s' on non-object", name);
+        luaA_warn(L, "Trying to emit signal '%s' on non-object", NONULL(name));
         return;
     }
     else if(lua_class->checker && !lua_class->checker(obj)) {
-        luaA_warn(L, "Trying to emit signal '%s' on invalid object", name);
+        luaA_warn(L, "Trying to emit signal '%s' on invalid object", NONULL(name));
         return;
     }
-    signal_t *sigfound = signal_array_getbyname(&obj->signals, name);
+    signal_t *sigfound = obj->signals.len ? signal_array_getbyid(&obj->signals, id) : NULL;
+    signal_t *classsig = lua_class->signals.len ? signal_array_getbyid(&lua_class->signals, id) : NULL;
+
+    /* Nobody listens, don't bother shuffling the stack */
+    if(!sigfound && !classsig)
+    {
+        lua_pop(L, nargs);
+        return;
+    }
+
+    double start = signal_profile_begin(lua_class->name, sigfound ? sigfound : classsig);
+    int handlers = 0;
+
     if(sigfound)
     {
         int nbfunc = sigfound->sigfuncs.len;
+        int context = lualib_context_enter("signal", sigfound->name);
         luaL_checkstack(L, nbfunc + nargs + 2, "too much signal");
         /* Push all functions and then execute, because this list can change
          * while executing funcs. */
@@ -301,32 +521,94 @@ luaA_object_emit_signal(lua_State *L, int oud,
             lua_remove(L, - nargs - nbfunc - 2 + i);
             luaA_dofunction(L, nargs + 1, 0);
         }
+        lualib_context_leave(context);
+        handlers += nbfunc;
     }
 
-    /* Then emit signal on the class */
+    /* Then emit signal on the class, the object handlers might have changed
+     * its handlers */
     lua_pushvalue(L, oud);
     lua_insert(L, - nargs - 1);
-    luaA_class_emit_signal(L, luaA_class_get(L, - nargs - 1), name, nargs + 1);
+    classsig = signal_array_getbyid(&lua_class->signals, id);
+    if(classsig)
+        handlers += signal_object_call(L, classsig, nargs + 1);
+    else
+        lua_pop(L, nargs + 1);
+
+    signal_profile_end(lua_class->name, id, handlers, start);
+}
+
+void
+luaA_object_emit_signal(lua_State *L, int oud,
+                        const char *name, int nargs)
+{
+    luaA_object_emit_signal_real(L, oud, name, signal_id(name), nargs);
+}
+
+/** Check if anything is connected to a signal of an object or its class.
+ * Callers can use this to avoid preparing signal arguments for nobody.
+ * \param L The Lua VM state.
+ * \param oud The object index on the stack.
+ * \param id The signal id, as returned by signal_id() or SIGNAL_ID().
+ * \return True if the signal has at least one listener.
+ */
+bool
+luaA_object_has_signal_listeners(lua_State *L, int oud, unsigned long id)
+{
+    lua_class_t *lua_class = luaA_class_get(L, oud);
+    lua_object_t *obj = luaA_toudata(L, oud, lua_class);
+
+    /* Let luaA_object_emit_signal_id() complain about bad objects */
+    if(!obj)
+        return true;
+
+    return signal_has_listeners(&obj->signals, id)
+        || signal_has_listeners(&lua_class->signals, id);
+}
+
+/** Emit a signal on an object, identified by its id.
+ * This avoids hashing the signal name on hot paths.
+ * \param L The Lua VM state.
+ * \param oud The object index on the stack.
+ * \param id The signal id, as returned by signal_id() or SIGNAL_ID().
+ * \param nargs The number of arguments on the stack, they are removed.
+ */
+void
+luaA_object_emit_signal_id(lua_State *L, int oud,
+                           unsigned long id, int nargs)
+{
+    luaA_object_emit_signal_real(L, oud, NULL, id, nargs);
 }
 
 int
 luaA_object_connect_signal_simple(lua_State *L)
 {
-    luaA_object_connect_signal_from_stack(L, 1, luaL_checkstring(L, 2), 3);
+    unsigned long id = luaA_signal_id(L, 2);
+    luaA_checkfunction(L, 3);
+    lua_object_t *obj = lua_touserdata(L, 1);
+    signal_connect_id(&obj->signals, id, lua_tostring(L, 2),
+                      luaA_object_ref_item(L, 1, 3));
     return 0;
 }
 
 int
 luaA_object_disconnect_signal_simple(lua_State *L)
 {
-    luaA_object_disconnect_signal_from_stack(L, 1, luaL_checkstring(L, 2), 3);
+    unsigned long id = luaA_signal_id(L, 2);
+    luaA_checkfunction(L, 3);
+    lua_object_t *obj = lua_touserdata(L, 1);
+    void *ref = (void *) lua_topointer(L, 3);
+    if (signal_disconnect_id(&obj->signals, id, ref))
+        luaA_object_unref_item(L, 1, ref);
+    lua_remove(L, 3);
     return 0;
 }
 
 int
 luaA_object_emit_signal_simple(lua_State *L)
 {
-    luaA_object_emit_signal(L, 1, luaL_checkstring(L, 2), lua_gettop(L) - 2);
+    unsigned long id = luaA_signal_id(L, 2);
+    luaA_object_emit_signal_real(L, 1, lua_tostring(L, 2), id, lua_gettop(L) - 2);
     return 0;
 }
 
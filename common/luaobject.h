@@ -27,6 +27,8 @@
 
 #define LUAA_OBJECT_REGISTRY_KEY "awesome.object.registry"
 
+extern int luaA_object_registry_ref;
+
 int luaA_settype(lua_State *, lua_class_t *);
 void luaA_object_setup(lua_State *);
 void * luaA_object_incref(lua_State *, int, int);
@@ -88,8 +90,8 @@ luaA_object_push_item(lua_State *L, int ud, const void *pointer)
 static inline void
 luaA_object_registry_push(lua_State *L)
 {
-    lua_pushliteral(L, LUAA_OBJECT_REGISTRY_KEY);
-    lua_rawget(L, LUA_REGISTRYINDEX);
+    /* Going through the reference avoids a string key lookup */
+    lua_rawgeti(L, LUA_REGISTRYINDEX, luaA_object_registry_ref);
 }
 
 /** Reference an object and return a pointer to it.
@@ -150,12 +152,20 @@ luaA_object_push(lua_State *L, const void *pointer)
 }
 
 void signal_object_emit(lua_State *, signal_array_t *, const char *, int);
+void signal_object_emit_id(lua_State *, signal_array_t *, unsigned long, int);
+void signal_object_emit_class(lua_State *, signal_array_t *, const char *, unsigned long, int);
+
+int luaA_signal_profile_set_enabled(lua_State *);
+int luaA_signal_profile_reset(lua_State *);
+int luaA_signal_profile_stats(lua_State *);
 
 void luaA_object_connect_signal(lua_State *, int, const char *, lua_CFunction);
 void luaA_object_disconnect_signal(lua_State *, int, const char *, lua_CFunction);
 void luaA_object_connect_signal_from_stack(lua_State *, int, const char *, int);
 void luaA_object_disconnect_signal_from_stack(lua_State *, int, const char *, int);
 void luaA_object_emit_signal(lua_State *, int, const char *, int);
+void luaA_object_emit_signal_id(lua_State *, int, unsigned long, int);
+bool luaA_object_has_signal_listeners(lua_State *, int, unsigned long);
 
 int luaA_object_connect_signal_simple(lua_State *);
 int luaA_object_disconnect_signal_simple(lua_State *);
@@ -0,0 +1,271 @@
+/*
+ * pixel.c - pixel format conversion
+ *
+ * Copyright © 2026 Awesome Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "common/pixel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PIXEL_HAVE_X86
+#include <immintrin.h>
+#endif
+
+/** Compute x / 255 rounded down, for x <= 255 * 255. This is the only rounding
+ * used by all kernels, which is what makes them agree bit for bit.
+ */
+static inline uint32_t
+pixel_div255(uint32_t x)
+{
+    return (x + (x >> 8) + 1) >> 8;
+}
+
+static bool
+scalar_supported(void)
+{
+    return true;
+}
+
+static void
+scalar_premultiply_argb32(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        uint32_t a = src[i] >> 24;
+        uint32_t r = pixel_div255(((src[i] >> 16) & 0xff) * a);
+        uint32_t g = pixel_div255(((src[i] >>  8) & 0xff) * a);
+        uint32_t b = pixel_div255(((src[i] >>  0) & 0xff) * a);
+        dst[i] = (a << 24) | (r << 16) | (g << 8) | b;
+    }
+}
+
+static void
+scalar_premultiply_rgba8(uint32_t *dst, const uint8_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++, src += 4)
+    {
+        uint32_t a = src[3];
+        uint32_t r = pixel_div255(src[0] * a);
+        uint32_t g = pixel_div255(src[1] * a);
+        uint32_t b = pixel_div255(src[2] * a);
+        dst[i] = (a << 24) | (r << 16) | (g << 8) | b;
+    }
+}
+
+static void
+scalar_rgb8_to_rgb24(uint32_t *dst, const uint8_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++, src += 3)
+        dst[i] = ((uint32_t) src[0] << 16) | ((uint32_t) src[1] << 8) | src[2];
+}
+
+static const pixel_kernels_t pixel_kernels_scalar =
+{
+    .name = "scalar",
+    .supported = scalar_supported,
+    .premultiply_argb32 = scalar_premultiply_argb32,
+    .premultiply_rgba8 = scalar_premultiply_rgba8,
+    .rgb8_to_rgb24 = scalar_rgb8_to_rgb24,
+};
+
+#ifdef PIXEL_HAVE_X86
+/* The SIMD kernels work on little-endian BGRA bytes, which is what a
+ * native-endian ARGB32 pixel is on x86. Each channel is widened to 16 bits,
+ * multiplied with the pixel's alpha (or with 255 for the alpha channel itself)
+ * and divided with the same formula as pixel_div255(). The three-byte RGB
+ * layout gains nothing from SSE2 and uses the plain C version everywhere.
+ */
+
+static bool
+sse2_supported(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+/** Premultiply two pixels with 16 bit channels.
+ * \param px The pixels, BGRA or, with swap_rb, RGBA.
+ * \param swap_rb Whether to swap the red and blue channel.
+ * \return The premultiplied BGRA pixels.
+ */
+__attribute__((target("sse2")))
+static inline __m128i
+sse2_premultiply_2(__m128i px, bool swap_rb)
+{
+    const __m128i alpha_lanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3)),
+                                        _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm_or_si128(_mm_andnot_si128(alpha_lanes, alpha),
+                         _mm_and_si128(alpha_lanes, _mm_set1_epi16(255)));
+    if (swap_rb)
+        px = _mm_shufflehi_epi16(_mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 0, 1, 2)),
+                                 _MM_SHUFFLE(3, 0, 1, 2));
+
+    __m128i x = _mm_mullo_epi16(px, alpha);
+    x = _mm_add_epi16(x, _mm_srli_epi16(x, 8));
+    x = _mm_add_epi16(x, _mm_set1_epi16(1));
+    return _mm_srli_epi16(x, 8);
+}
+
+__attribute__((target("sse2")))
+static inline size_t
+sse2_premultiply(uint32_t *dst, const uint8_t *src, size_t n, bool swap_rb)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + 4 * i));
+        __m128i lo = sse2_premultiply_2(_mm_unpacklo_epi8(v, zero), swap_rb);
+        __m128i hi = sse2_premultiply_2(_mm_unpackhi_epi8(v, zero), swap_rb);
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi16(lo, hi));
+    }
+
+    return i;
+}
+
+__attribute__((target("sse2")))
+static void
+sse2_premultiply_argb32(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    size_t done = sse2_premultiply(dst, (const uint8_t *) src, n, false);
+    scalar_premultiply_argb32(dst + done, src + done, n - done);
+}
+
+__attribute__((target("sse2")))
+static void
+sse2_premultiply_rgba8(uint32_t *dst, const uint8_t *src, size_t n)
+{
+    size_t done = sse2_premultiply(dst, src, n, true);
+    scalar_premultiply_rgba8(dst + done, src + 4 * done, n - done);
+}
+
+static const pixel_kernels_t pixel_kernels_sse2 =
+{
+    .name = "sse2",
+    .supported = sse2_supported,
+    .premultiply_argb32 = sse2_premultiply_argb32,
+    .premultiply_rgba8 = sse2_premultiply_rgba8,
+    .rgb8_to_rgb24 = scalar_rgb8_to_rgb24,
+};
+
+static bool
+avx2_supported(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+/** Premultiply four pixels with 16 bit channels, two in each 128 bit lane.
+ * \param px The pixels, BGRA or, with swap_rb, RGBA.
+ * \param swap_rb Whether to swap the red and blue channel.
+ * \return The premultiplied BGRA pixels.
+ */
+__attribute__((target("avx2")))
+static inline __m256i
+avx2_premultiply_4(__m256i px, bool swap_rb)
+{
+    const __m256i alpha_lanes = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0,
+                                                 -1, 0, 0, 0, -1, 0, 0, 0);
+    __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3)),
+                                           _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm256_blendv_epi8(alpha, _mm256_set1_epi16(255), alpha_lanes);
+    if (swap_rb)
+        px = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(px, _MM_SHUFFLE(3, 0, 1, 2)),
+                                    _MM_SHUFFLE(3, 0, 1, 2));
+
+    __m256i x = _mm256_mullo_epi16(px, alpha);
+    x = _mm256_add_epi16(x, _mm256_srli_epi16(x, 8));
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(1));
+    return _mm256_srli_epi16(x, 8);
+}
+
+__attribute__((target("avx2")))
+static inline size_t
+avx2_premultiply(uint32_t *dst, const uint8_t *src, size_t n, bool swap_rb)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+
+    /* Unpacking and packing both work within 128 bit lanes, so the pixels
+     * come out in the order they went in. */
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (src + 4 * i));
+        __m256i lo = avx2_premultiply_4(_mm256_unpacklo_epi8(v, zero), swap_rb);
+        __m256i hi = avx2_premultiply_4(_mm256_unpackhi_epi8(v, zero), swap_rb);
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_packus_epi16(lo, hi));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+static void
+avx2_premultiply_argb32(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    size_t done = avx2_premultiply(dst, (const uint8_t *) src, n, false);
+    sse2_premultiply_argb32(dst + done, src + done, n - done);
+}
+
+__attribute__((target("avx2")))
+static void
+avx2_premultiply_rgba8(uint32_t *dst, const uint8_t *src, size_t n)
+{
+    size_t done = avx2_premultiply(dst, src, n, true);
+    sse2_premultiply_rgba8(dst + done, src + 4 * done, n - done);
+}
+
+static const pixel_kernels_t pixel_kernels_avx2 =
+{
+    .name = "avx2",
+    .supported = avx2_supported,
+    .premultiply_argb32 = avx2_premultiply_argb32,
+    .premultiply_rgba8 = avx2_premultiply_rgba8,
+    .rgb8_to_rgb24 = scalar_rgb8_to_rgb24,
+};
+#endif
+
+const pixel_kernels_t * const pixel_kernels_all[] =
+{
+    &pixel_kernels_scalar,
+#ifdef PIXEL_HAVE_X86
+    &pixel_kernels_sse2,
+    &pixel_kernels_avx2,
+#endif
+    NULL
+};
+
+/** Get the fastest kernels that this CPU supports.
+ * \return The kernels.
+ */
+const pixel_kernels_t *
+pixel_kernels(void)
+{
+    static const pixel_kernels_t *best;
+
+    if (!best)
+        for (int i = 0; pixel_kernels_all[i]; i++)
+            if (pixel_kernels_all[i]->supported())
+                best = pixel_kernels_all[i];
+
+    return best;
+}
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
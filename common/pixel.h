@@ -0,0 +1,70 @@
+/*
+ * pixel.h - pixel format conversion header
+ *
+ * Copyright © 2026 Awesome Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef AWESOME_COMMON_PIXEL_H
+#define AWESOME_COMMON_PIXEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** A set of conversion functions for one instruction set. All of them produce
+ * exactly the same results. Destinations are in cairo's native-endian
+ * premultiplied ARGB32 format.
+ */
+typedef struct
+{
+    const char *name;
+    /** Can this CPU run the kernels? */
+    bool (*supported)(void);
+    /** Premultiply native-endian ARGB, e.g. from _NET_WM_ICON. */
+    void (*premultiply_argb32)(uint32_t *dst, const uint32_t *src, size_t n);
+    /** Premultiply and swizzle RGBA bytes, e.g. from GdkPixbuf. */
+    void (*premultiply_rgba8)(uint32_t *dst, const uint8_t *src, size_t n);
+    /** Swizzle RGB bytes into RGB24. */
+    void (*rgb8_to_rgb24)(uint32_t *dst, const uint8_t *src, size_t n);
+} pixel_kernels_t;
+
+/** All compiled kernel sets, the plain C one first, NULL terminated. */
+extern const pixel_kernels_t * const pixel_kernels_all[];
+
+const pixel_kernels_t *pixel_kernels(void);
+
+static inline void
+pixel_premultiply_argb32(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    pixel_kernels()->premultiply_argb32(dst, src, n);
+}
+
+static inline void
+pixel_premultiply_rgba8(uint32_t *dst, const uint8_t *src, size_t n)
+{
+    pixel_kernels()->premultiply_rgba8(dst, src, n);
+}
+
+static inline void
+pixel_rgb8_to_rgb24(uint32_t *dst, const uint8_t *src, size_t n)
+{
+    pixel_kernels()->rgb8_to_rgb24(dst, src, n);
+}
+
+#endif
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
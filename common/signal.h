@@ -29,6 +29,8 @@ DO_ARRAY(const void *, cptr, DO_NOTHING)
 typedef struct
 {
     unsigned long id;
+    /** Name the signal was first connected with, for diagnostics */
+    char *name;
     cptr_array_t sigfuncs;
 } signal_t;
 
@@ -43,10 +45,36 @@ static inline void
 signal_wipe(signal_t *sig)
 {
     cptr_array_wipe(&sig->sigfuncs);
+    p_delete(&sig->name);
 }
 
 DO_BARRAY(signal_t, signal, signal_wipe, signal_cmp)
 
+/** Get the id of a signal from its name.
+ * Callers emitting a signal often can compute this once and use the
+ * *_emit_*_id() functions.
+ * \param name The signal name.
+ * \return The signal id.
+ */
+static inline unsigned long
+signal_id(const char *name)
+{
+    return a_strhash((const unsigned char *) NONULL(name));
+}
+
+/** Get the id of a constant signal name, hashing it only on its first use at
+ * this call site.
+ * \param name The signal name, a string constant.
+ * \return The signal id.
+ */
+#define SIGNAL_ID(name) \
+    ({ \
+        static unsigned long signal_id_cache_; \
+        if(!signal_id_cache_) \
+            signal_id_cache_ = signal_id(name); \
+        signal_id_cache_; \
+    })
+
 static inline signal_t *
 signal_array_getbyid(signal_array_t *arr, unsigned long id)
 {
@@ -54,44 +82,67 @@ signal_array_getbyid(signal_array_t *arr, unsigned long id)
     return signal_array_lookup(arr, &sig);
 }
 
+/** Check if anything is connected to a signal.
+ * \param arr The signal array.
+ * \param id The signal id.
+ * \return True if the signal has at least one listener.
+ */
+static inline bool
+signal_has_listeners(signal_array_t *arr, unsigned long id)
+{
+    /* Signals are removed when their last function is disconnected */
+    return arr->len && signal_array_getbyid(arr, id);
+}
+
 static inline signal_t *
 signal_array_getbyname(signal_array_t *arr, const char *name)
 {
-    signal_t sig = { .id = a_strhash((const unsigned char *) NONULL(name)) };
-    return signal_array_lookup(arr, &sig);
+    return signal_array_getbyid(arr, signal_id(name));
 }
 
-/** Connect a signal inside a signal array.
+/** Connect a signal inside a signal array, identified by its id.
  * You are in charge of reference counting.
  * \param arr The signal array.
+ * \param id The signal id, as returned by signal_id().
  * \param name The signal name.
  * \param ref The reference to add.
  */
 static inline void
-signal_connect(signal_array_t *arr, const char *name, const void *ref)
+signal_connect_id(signal_array_t *arr, unsigned long id, const char *name, const void *ref)
 {
-    unsigned long tok = a_strhash((const unsigned char *) name);
-    signal_t *sigfound = signal_array_getbyid(arr, tok);
+    signal_t *sigfound = signal_array_getbyid(arr, id);
     if(sigfound)
         cptr_array_append(&sigfound->sigfuncs, ref);
     else
     {
-        signal_t sig = { .id = tok };
+        signal_t sig = { .id = id, .name = a_strdup(name) };
         cptr_array_append(&sig.sigfuncs, ref);
         signal_array_insert(arr, sig);
     }
 }
 
-/** Disconnect a signal inside a signal array.
+/** Connect a signal inside a signal array.
  * You are in charge of reference counting.
  * \param arr The signal array.
  * \param name The signal name.
+ * \param ref The reference to add.
+ */
+static inline void
+signal_connect(signal_array_t *arr, const char *name, const void *ref)
+{
+    signal_connect_id(arr, signal_id(name), name, ref);
+}
+
+/** Disconnect a signal inside a signal array, identified by its id.
+ * You are in charge of reference counting.
+ * \param arr The signal array.
+ * \param id The signal id, as returned by signal_id().
  * \param ref The reference to remove.
  */
 static inline bool
-signal_disconnect(signal_array_t *arr, const char *name, const void *ref)
+signal_disconnect_id(signal_array_t *arr, unsigned long id, const void *ref)
 {
-    signal_t *sigfound = signal_array_getbyname(arr, name);
+    signal_t *sigfound = signal_array_getbyid(arr, id);
     if(sigfound)
     {
         foreach(func, sigfound->sigfuncs)
@@ -99,13 +150,28 @@ signal_disconnect(signal_array_t *arr, const char *name, const void *ref)
             {
                 cptr_array_remove(&sigfound->sigfuncs, func);
                 if(sigfound->sigfuncs.len == 0)
-                    signal_array_remove(arr, sigfound);
+                {
+                    signal_t sig = signal_array_remove(arr, sigfound);
+                    signal_wipe(&sig);
+                }
                 return true;
             }
     }
     return false;
 }
 
+/** Disconnect a signal inside a signal array.
+ * You are in charge of reference counting.
+ * \param arr The signal array.
+ * \param name The signal name.
+ * \param ref The reference to remove.
+ */
+static inline bool
+signal_disconnect(signal_array_t *arr, const char *name, const void *ref)
+{
+    return signal_disconnect_id(arr, signal_id(name), ref);
+}
+
 #endif
 
 // vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
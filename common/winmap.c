@@ -0,0 +1,138 @@
+/*
+ * common/winmap.c - window to object index
+ *
+ * Copyright © 2026 Awesome Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "common/winmap.h"
+
+/** Put an entry into the first free slot of its probe sequence.
+ * The caller makes sure that the window is not yet present and that there is
+ * a free slot.
+ */
+static void
+winmap_place(winmap_t *map, winmap_entry_t entry)
+{
+    uint32_t mask = map->size - 1;
+    uint32_t i = winmap_hash(entry.window) & mask;
+
+    while(map->tab[i].window != XCB_NONE)
+        i = (i + 1) & mask;
+
+    map->tab[i] = entry;
+}
+
+/** Double the size of the table and rehash all entries.
+ * \param map The window map.
+ */
+static void
+winmap_grow(winmap_t *map)
+{
+    winmap_entry_t *old = map->tab;
+    int old_size = map->size;
+
+    map->size = old_size ? old_size * 2 : 64;
+    map->tab = p_new(winmap_entry_t, map->size);
+
+    for(int i = 0; i < old_size; i++)
+        if(old[i].window != XCB_NONE)
+            winmap_place(map, old[i]);
+
+    p_delete(&old);
+}
+
+/** Index a window.
+ * An existing entry for the same window is replaced.
+ * \param map The window map.
+ * \param win The window.
+ * \param kind The role of the window for its owner.
+ * \param object The object owning the window.
+ */
+void
+winmap_insert(winmap_t *map, xcb_window_t win, winmap_kind_t kind, void *object)
+{
+    if(win == XCB_NONE)
+        return;
+
+    if(map->len)
+    {
+        uint32_t mask = map->size - 1;
+        for(uint32_t i = winmap_hash(win) & mask; map->tab[i].window != XCB_NONE; i = (i + 1) & mask)
+            if(map->tab[i].window == win)
+            {
+                map->tab[i].kind = kind;
+                map->tab[i].object = object;
+                return;
+            }
+    }
+
+    /* Keep the load factor at or below one half so probe sequences stay short */
+    if((map->len + 1) * 2 > map->size)
+        winmap_grow(map);
+
+    winmap_place(map, (winmap_entry_t) { .window = win, .kind = kind, .object = object });
+    map->len++;
+}
+
+/** Remove a window from the index.
+ * \param map The window map.
+ * \param win The window.
+ */
+void
+winmap_remove(winmap_t *map, xcb_window_t win)
+{
+    if(!map->len || win == XCB_NONE)
+        return;
+
+    uint32_t mask = map->size - 1;
+    uint32_t i = winmap_hash(win) & mask;
+
+    while(map->tab[i].window != win)
+    {
+        if(map->tab[i].window == XCB_NONE)
+            return;
+        i = (i + 1) & mask;
+    }
+
+    /* Shift back the following entries of the cluster instead of leaving a
+     * tombstone, so lookups never have to skip deleted slots. */
+    for(uint32_t j = (i + 1) & mask; map->tab[j].window != XCB_NONE; j = (j + 1) & mask)
+    {
+        uint32_t home = winmap_hash(map->tab[j].window) & mask;
+        /* The entry may stay if its home slot lies cyclically in (i, j] */
+        if(i <= j ? (i < home && home <= j) : (i < home || home <= j))
+            continue;
+        map->tab[i] = map->tab[j];
+        i = j;
+    }
+
+    p_clear(&map->tab[i], 1);
+    map->len--;
+}
+
+/** Free all memory used by a window map.
+ * \param map The window map.
+ */
+void
+winmap_wipe(winmap_t *map)
+{
+    p_delete(&map->tab);
+    map->len = map->size = 0;
+}
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
@@ -0,0 +1,91 @@
+/*
+ * common/winmap.h - window to object index header
+ *
+ * Copyright © 2026 Awesome Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef AWESOME_COMMON_WINMAP_H
+#define AWESOME_COMMON_WINMAP_H
+
+#include <xcb/xcb.h>
+
+#include "common/util.h"
+
+/** What an indexed window is to the object owning it. */
+typedef enum
+{
+    WINMAP_CLIENT_WINDOW,
+    WINMAP_CLIENT_FRAME,
+    WINMAP_CLIENT_NOFOCUS,
+    WINMAP_DRAWIN
+} winmap_kind_t;
+
+typedef struct
+{
+    /** The window, XCB_NONE for a free slot */
+    xcb_window_t window;
+    /** The role of the window */
+    winmap_kind_t kind;
+    /** The object owning the window */
+    void *object;
+} winmap_entry_t;
+
+/** Open-addressing hash table from windows to the objects owning them.
+ * Collisions are resolved by linear probing, size is always a power of two.
+ */
+typedef struct
+{
+    winmap_entry_t *tab;
+    int len, size;
+} winmap_t;
+
+void winmap_insert(winmap_t *, xcb_window_t, winmap_kind_t, void *);
+void winmap_remove(winmap_t *, xcb_window_t);
+void winmap_wipe(winmap_t *);
+
+static inline uint32_t
+winmap_hash(xcb_window_t win)
+{
+    /* X resource ids of one client only differ in their low bits, spread
+     * them over the whole word. */
+    uint32_t h = win * 0x9e3779b1u;
+    return h ^ (h >> 16);
+}
+
+/** Find the object owning a window.
+ * \param map The window map.
+ * \param win The window to look for.
+ * \param kind The role the window must have.
+ * \return The object, or NULL if the window is not indexed with that role.
+ */
+static inline void *
+winmap_lookup(winmap_t *map, xcb_window_t win, winmap_kind_t kind)
+{
+    if(!map->len || win == XCB_NONE)
+        return NULL;
+
+    uint32_t mask = map->size - 1;
+    for(uint32_t i = winmap_hash(win) & mask; map->tab[i].window != XCB_NONE; i = (i + 1) & mask)
+        if(map->tab[i].window == win)
+            return map->tab[i].kind == kind ? map->tab[i].object : NULL;
+
+    return NULL;
+}
+
+#endif
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
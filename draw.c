@@ -22,6 +22,7 @@
 #include "config.h"
 #include "draw.h"
 #include "globalconf.h"
+#include "common/pixel.h"
 
 #include <langinfo.h>
 #include <errno.h>
@@ -50,20 +51,11 @@ cairo_surface_t *
 draw_surface_from_data(int width, int height, uint32_t *data)
 {
     unsigned long int len = width * height;
-    unsigned long int i;
     uint32_t *buffer = p_new(uint32_t, len);
     cairo_surface_t *surface;
 
     /* Cairo wants premultiplied alpha, meh :( */
-    for(i = 0; i < len; i++)
-    {
-        uint8_t a = (data[i] >> 24) & 0xff;
-        double alpha = a / 255.0;
-        uint8_t r = ((data[i] >> 16) & 0xff) * alpha;
-        uint8_t g = ((data[i] >>  8) & 0xff) * alpha;
-        uint8_t b = ((data[i] >>  0) & 0xff) * alpha;
-        buffer[i] = (a << 24) | (r << 16) | (g << 8) | b;
-    }
+    pixel_premultiply_argb32(buffer, data, len);
 
     surface =
         cairo_image_surface_create_for_data((unsigned char *) buffer,
@@ -77,6 +69,153 @@ draw_surface_from_data(int width, int height, uint32_t *data)
     return surface;
 }
 
+/** A decoded icon that other icons with the same content can share */
+typedef struct
+{
+    uint32_t width, height;
+    uint64_t hash;
+    /** Not referenced, the entry goes away together with the surface */
+    cairo_surface_t *surface;
+} icon_cache_entry_t;
+
+static struct
+{
+    /** The entries, each being its own key */
+    GHashTable *entries;
+    size_t bytes;
+    uint64_t hits, misses;
+} icon_cache;
+
+static cairo_user_data_key_t icon_cache_key;
+
+static guint
+icon_cache_entry_hash(gconstpointer key)
+{
+    const icon_cache_entry_t *entry = key;
+    return entry->hash ^ (entry->hash >> 32) ^ entry->width ^ (entry->height << 16);
+}
+
+static gboolean
+icon_cache_entry_equal(gconstpointer a, gconstpointer b)
+{
+    const icon_cache_entry_t *x = a, *y = b;
+    return x->hash == y->hash && x->width == y->width && x->height == y->height;
+}
+
+static void
+icon_cache_entry_remove(void *data)
+{
+    icon_cache_entry_t *entry = data;
+    icon_cache.bytes -= entry->width * (size_t) entry->height * 4;
+    g_hash_table_remove(icon_cache.entries, entry);
+    p_delete(&entry);
+}
+
+/** Hash premultiplied pixels with 64 bit FNV-1a over whole pixels.
+ * \param data The pixels.
+ * \param n The number of pixels.
+ * \return The hash.
+ */
+static uint64_t
+icon_cache_hash(const uint32_t *data, size_t n)
+{
+    uint64_t hash = UINT64_C(0xcbf29ce484222325);
+    for (size_t i = 0; i < n; i++)
+        hash = (hash ^ data[i]) * UINT64_C(0x100000001b3);
+    return hash;
+}
+
+/** Get the surface of an icon, decoding it if this did not happen yet.
+ *
+ * The raw data is premultiplied into memory of its own, so that the icon
+ * stops holding on to the reply that it came from. Once all icons of a reply
+ * were decoded or are gone, the reply is freed. If another icon with exactly
+ * the same pixels is alive, its surface is shared. Otherwise the new surface
+ * becomes available for sharing.
+ * \param icon The icon.
+ * \return The surface, owned by the icon.
+ */
+cairo_surface_t *
+draw_icon_get_surface(draw_icon_t *icon)
+{
+    if (icon->surface || !icon->data)
+        return icon->surface;
+
+    size_t len = icon->width * (size_t) icon->height;
+    uint32_t *buffer = p_new(uint32_t, len);
+    pixel_premultiply_argb32(buffer, icon->data, len);
+
+    /* Only this size is needed from now on */
+    icon->data = NULL;
+    if (icon->bytes)
+        g_bytes_unref(icon->bytes);
+    icon->bytes = NULL;
+
+    if (!icon_cache.entries)
+        icon_cache.entries = g_hash_table_new(icon_cache_entry_hash, icon_cache_entry_equal);
+    icon_cache_entry_t key = {
+        .width = icon->width,
+        .height = icon->height,
+        .hash = icon_cache_hash(buffer, len),
+    };
+    icon_cache_entry_t *entry = g_hash_table_lookup(icon_cache.entries, &key);
+
+    /* Only share if the pixels really are the same */
+    if (entry && memcmp(cairo_image_surface_get_data(entry->surface), buffer, len * 4) == 0)
+    {
+        icon_cache.hits++;
+        icon->surface = cairo_surface_reference(entry->surface);
+        p_delete(&buffer);
+        return icon->surface;
+    }
+
+    icon_cache.misses++;
+    icon->surface = cairo_image_surface_create_for_data((unsigned char *) buffer,
+                                                        CAIRO_FORMAT_ARGB32,
+                                                        icon->width,
+                                                        icon->height,
+                                                        icon->width * 4);
+    /* This makes sure that buffer will be freed */
+    cairo_surface_set_user_data(icon->surface, &data_key, buffer, &free_data);
+
+    /* On a hash collision, the older icon stays in the cache */
+    if (!entry)
+    {
+        entry = p_new(icon_cache_entry_t, 1);
+        *entry = key;
+        entry->surface = icon->surface;
+        g_hash_table_add(icon_cache.entries, entry);
+        icon_cache.bytes += len * 4;
+        cairo_surface_set_user_data(icon->surface, &icon_cache_key, entry,
+                                    icon_cache_entry_remove);
+    }
+
+    return icon->surface;
+}
+
+/** Push statistics about the shared icon cache.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ */
+int
+draw_icon_cache_push_stats(lua_State *L)
+{
+    uint64_t total = icon_cache.hits + icon_cache.misses;
+
+    lua_createtable(L, 0, 5);
+    lua_pushinteger(L, icon_cache.entries ? g_hash_table_size(icon_cache.entries) : 0);
+    lua_setfield(L, -2, "icons");
+    lua_pushnumber(L, icon_cache.bytes);
+    lua_setfield(L, -2, "bytes");
+    lua_pushnumber(L, icon_cache.hits);
+    lua_setfield(L, -2, "hits");
+    lua_pushnumber(L, icon_cache.misses);
+    lua_setfield(L, -2, "misses");
+    lua_pushnumber(L, total ? (double) icon_cache.hits / total : 0);
+    lua_setfield(L, -2, "hit_rate");
+    return 1;
+}
+
 /** Create a surface object from this pixbuf
  * \param buf The pixbuf
  * \return Number of items pushed on the lua stack.
@@ -104,27 +243,11 @@ draw_surface_from_pixbuf(GdkPixbuf *buf)
 
     for (int y = 0; y < height; y++)
     {
-        guchar *row = pixels;
         uint32_t *cairo = (uint32_t *) cairo_pixels;
-        for (int x = 0; x < width; x++) {
-            if (channels == 3)
-            {
-                uint8_t r = *row++;
-                uint8_t g = *row++;
-                uint8_t b = *row++;
-                *cairo++ = (r << 16) | (g << 8) | b;
-            } else {
-                uint8_t r = *row++;
-                uint8_t g = *row++;
-                uint8_t b = *row++;
-                uint8_t a = *row++;
-                double alpha = a / 255.0;
-                r = r * alpha;
-                g = g * alpha;
-                b = b * alpha;
-                *cairo++ = (a << 24) | (r << 16) | (g << 8) | b;
-            }
-        }
+        if (channels == 3)
+            pixel_rgb8_to_rgb24(cairo, pixels, width);
+        else
+            pixel_premultiply_rgba8(cairo, pixels, width);
         pixels += pix_stride;
         cairo_pixels += cairo_stride;
     }
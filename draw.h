@@ -50,12 +50,31 @@ struct area_t
 #define AREA_EQUAL(a, b) ((a).x == (b).x && (a).y == (b).y && \
         (a).width == (b).width && (a).height == (b).height)
 
+/** One size of an icon, which is only decoded when it is actually used */
+typedef struct
+{
+    uint32_t width, height;
+    /** ARGB data that is not premultiplied yet, or NULL once decoded */
+    uint32_t *data;
+    /** The reply that data points into, or NULL. It is only kept alive by
+     * icons that were not decoded yet. */
+    GBytes *bytes;
+    /** The decoded icon, NULL until draw_icon_get_surface() is called */
+    cairo_surface_t *surface;
+} draw_icon_t;
+
 static inline void
-cairo_surface_array_destroy_surface(cairo_surface_t **s)
+draw_icon_wipe(draw_icon_t *icon)
 {
-    cairo_surface_destroy(*s);
+    if (icon->surface)
+        cairo_surface_destroy(icon->surface);
+    if (icon->bytes)
+        g_bytes_unref(icon->bytes);
 }
-DO_ARRAY(cairo_surface_t *, cairo_surface, cairo_surface_array_destroy_surface)
+DO_ARRAY(draw_icon_t, draw_icon, draw_icon_wipe)
+
+cairo_surface_t *draw_icon_get_surface(draw_icon_t *icon);
+int draw_icon_cache_push_stats(lua_State *L);
 
 cairo_surface_t *draw_surface_from_data(int width, int height, uint32_t *data);
 cairo_surface_t *draw_dup_image_surface(cairo_surface_t *surface);
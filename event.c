@@ -38,6 +38,8 @@
 #include "objects/screen.h"
 #include "common/atoms.h"
 #include "common/xutil.h"
+#include "stats.h"
+#include "thumbnail.h"
 
 #include <xcb/xcb.h>
 #include <xcb/randr.h>
@@ -47,6 +49,7 @@
 #include <xcb/xcb_event.h>
 #include <xcb/xkb.h>
 #include <xcb/xfixes.h>
+#include <xcb/damage.h>
 
 #define DO_EVENT_HOOK_CALLBACK(type, xcbtype, xcbeventprefix, arraytype, match) \
     static void \
@@ -431,9 +434,9 @@ event_handle_configurerequest(xcb_configure_request_event_t *ev)
             xcb_translate_coordinates_unchecked(globalconf.connection,
                     ev->window, globalconf.screen->root, 0, 0);
         xcb_get_geometry_reply_t *geom =
-            xcb_get_geometry_reply(globalconf.connection, geom_cookie, NULL);
+            A_XCB_WAIT(xcb_get_geometry_reply(globalconf.connection, geom_cookie, NULL));
         xcb_translate_coordinates_reply_t *coords =
-            xcb_translate_coordinates_reply(globalconf.connection, coords_cookie, NULL);
+            A_XCB_WAIT(xcb_translate_coordinates_reply(globalconf.connection, coords_cookie, NULL));
 
         if (geom && coords)
         {
@@ -738,12 +741,11 @@ event_handle_expose(xcb_expose_event_t *ev)
     drawin_t *drawin;
     client_t *client;
 
+    /* The damage is repaired in awesome_refresh() */
     if((drawin = drawin_getbywin(ev->window)))
-        drawin_refresh_pixmap_partial(drawin,
-                                      ev->x, ev->y,
-                                      ev->width, ev->height);
+        drawin_damage(drawin, ev->x, ev->y, ev->width, ev->height);
     if ((client = client_getbyframewin(ev->window)))
-        client_refresh_partial(client, ev->x, ev->y, ev->width, ev->height);
+        client_damage(client, ev->x, ev->y, ev->width, ev->height);
 }
 
 /** The key press event handler.
@@ -798,7 +800,7 @@ event_handle_maprequest(xcb_map_request_event_t *ev)
 
     wa_c = xcb_get_window_attributes_unchecked(globalconf.connection, ev->window);
 
-    if(!(wa_r = xcb_get_window_attributes_reply(globalconf.connection, wa_c, NULL)))
+    if(!(wa_r = A_XCB_WAIT(xcb_get_window_attributes_reply(globalconf.connection, wa_c, NULL))))
         return;
 
     if(wa_r->override_redirect)
@@ -833,12 +835,14 @@ event_handle_maprequest(xcb_map_request_event_t *ev)
     {
         geom_c = xcb_get_geometry_unchecked(globalconf.connection, ev->window);
 
-        if(!(geom_r = xcb_get_geometry_reply(globalconf.connection, geom_c, NULL)))
+        if(!(geom_r = A_XCB_WAIT(xcb_get_geometry_reply(globalconf.connection, geom_c, NULL))))
         {
             goto bailout;
         }
 
-        client_manage(ev->window, geom_r, wa_r);
+        client_manage_cookies_t cookies;
+        client_manage_request(ev->window, &cookies);
+        client_manage(ev->window, geom_r, wa_r, &cookies, NULL);
 
         p_delete(&geom_r);
     }
@@ -901,11 +905,11 @@ event_handle_randr_output_change_notify(xcb_randr_notify_event_t *ev)
          * the final state of the connection. There could be more notification
          * events underway and using some "old" timestamp causes problems.
          */
-        info = xcb_randr_get_output_info_reply(globalconf.connection,
+        info = A_XCB_WAIT(xcb_randr_get_output_info_reply(globalconf.connection,
             xcb_randr_get_output_info_unchecked(globalconf.connection,
                 output,
                 XCB_CURRENT_TIME),
-            NULL);
+            NULL));
         if(!info)
             return;
 
@@ -952,6 +956,17 @@ event_handle_shape_notify(xcb_shape_notify_event_t *ev)
     }
 }
 
+/** The damage notify event handler.
+ * \param ev The event.
+ */
+static void
+event_handle_damage_notify(xcb_damage_notify_event_t *ev)
+{
+    client_t *c = client_getbywin(ev->drawable);
+    if (c)
+        thumbnail_client_damaged(c);
+}
+
 /** The client message event handler.
  * \param ev The event.
  */
@@ -1089,13 +1104,16 @@ should_ignore(xcb_generic_event_t *event)
     return false;
 }
 
-void event_handle(xcb_generic_event_t *event)
+static void
+event_dispatch(xcb_generic_event_t *event)
 {
     uint8_t response_type = XCB_EVENT_RESPONSE_TYPE(event);
 
     if (should_ignore(event))
         return;
 
+    stats_count_event(response_type);
+
     if(response_type == 0)
     {
         /* This is an error, not a event */
@@ -1138,9 +1156,248 @@ void event_handle(xcb_generic_event_t *event)
     EXTENSION_EVENT(shape, XCB_SHAPE_NOTIFY, event_handle_shape_notify);
     EXTENSION_EVENT(xkb, 0, event_handle_xkb_notify);
     EXTENSION_EVENT(xfixes, XCB_XFIXES_SELECTION_NOTIFY, event_handle_xfixes_selection_notify);
+    EXTENSION_EVENT(damage, XCB_DAMAGE_NOTIFY, event_handle_damage_notify);
 #undef EXTENSION_EVENT
 }
 
+void event_handle(xcb_generic_event_t *event)
+{
+    if(!lualib_context.enabled)
+    {
+        event_dispatch(event);
+        return;
+    }
+
+    const char *label = xcb_event_get_label(XCB_EVENT_RESPONSE_TYPE(event));
+    int context = lualib_context_enter("event", label ? label : "extension");
+
+    event_dispatch(event);
+
+    lualib_context_leave(context);
+}
+
+/** Events dropped by event_coalesce() since startup */
+static event_coalesce_stats_t coalesce_stats;
+
+typedef struct
+{
+    xcb_window_t window;
+    xcb_atom_t atom;
+} coalesce_property_t;
+
+typedef struct
+{
+    xcb_window_t window;
+    /** The closest later ConfigureRequest still to be handled, or NULL */
+    xcb_configure_request_event_t *later;
+} coalesce_configure_t;
+
+DO_ARRAY(coalesce_property_t, coalesce_property, DO_NOTHING)
+DO_ARRAY(coalesce_configure_t, coalesce_configure, DO_NOTHING)
+DO_ARRAY(xcb_expose_event_t *, coalesce_expose, DO_NOTHING)
+
+/** Get the window whose lifetime or mapping state an event changes.
+ * \param event The event.
+ * \return The window, or XCB_NONE.
+ */
+static xcb_window_t
+event_coalesce_barrier_window(xcb_generic_event_t *event)
+{
+    switch(XCB_EVENT_RESPONSE_TYPE(event))
+    {
+      case XCB_MAP_REQUEST:
+        return ((xcb_map_request_event_t *) event)->window;
+      case XCB_MAP_NOTIFY:
+        return ((xcb_map_notify_event_t *) event)->window;
+      case XCB_UNMAP_NOTIFY:
+        return ((xcb_unmap_notify_event_t *) event)->window;
+      case XCB_DESTROY_NOTIFY:
+        return ((xcb_destroy_notify_event_t *) event)->window;
+      case XCB_REPARENT_NOTIFY:
+        return ((xcb_reparent_notify_event_t *) event)->window;
+    }
+    return XCB_NONE;
+}
+
+/** Check if a ConfigureRequest makes an earlier one useless.
+ * \param earlier The earlier request.
+ * \param later The later request for the same window.
+ * \return True if only handling the later request has the same result.
+ */
+static bool
+event_coalesce_configure_covers(xcb_configure_request_event_t *earlier,
+                                xcb_configure_request_event_t *later)
+{
+    if((later->value_mask & earlier->value_mask) != earlier->value_mask)
+        return false;
+    /* The result of the other stack modes depends on the current stacking */
+    if(earlier->value_mask & XCB_CONFIG_WINDOW_STACK_MODE)
+        return later->stack_mode == XCB_STACK_MODE_ABOVE
+            || later->stack_mode == XCB_STACK_MODE_BELOW;
+    return true;
+}
+
+/** Try to merge an Expose rectangle into another one of the same window.
+ * \param into The rectangle that is kept, grown as needed.
+ * \param ev The rectangle to merge.
+ * \return True if ev is now covered by into.
+ */
+static bool
+event_coalesce_expose_merge(xcb_expose_event_t *into, xcb_expose_event_t *ev)
+{
+    int x1 = MIN(into->x, ev->x), y1 = MIN(into->y, ev->y);
+    int x2 = MAX(into->x + into->width, ev->x + ev->width);
+    int y2 = MAX(into->y + into->height, ev->y + ev->height);
+
+    /* Only merge if the bounding box does not repaint much that is not
+     * damaged, so contained and adjacent or overlapping rectangles */
+    if((x2 - x1) * (y2 - y1) > into->width * into->height + ev->width * ev->height)
+        return false;
+
+    into->x = x1;
+    into->y = y1;
+    into->width = x2 - x1;
+    into->height = y2 - y1;
+    return true;
+}
+
+/** Drop events from a batch that later events of the batch make redundant.
+ * Dropped events are freed and replaced by NULL.
+ *
+ * - MotionNotify is dropped if followed by another one without an Enter,
+ *   Leave or button event in between, so the pointer events keep their order.
+ * - PropertyNotify for a new value is dropped if followed by one for the same
+ *   window and atom, the handlers read the current value anyway.
+ * - ConfigureRequest is dropped if the next one for the same window sets at
+ *   least the same fields, with no (un)mapping or reparenting in between.
+ * - Expose rectangles of a window are merged when that does not grow the
+ *   repainted area beyond the damaged one.
+ *
+ * \param events The events, in the order they were received.
+ * \param len The number of events.
+ */
+void
+event_coalesce(xcb_generic_event_t **events, int len)
+{
+    static coalesce_property_array_t properties;
+    static coalesce_configure_array_t configures;
+    static coalesce_expose_array_t exposes;
+    bool motion_follows = false;
+
+    if(len < 2)
+        return;
+
+    /* Go backwards, so we know what follows each event */
+    for(int i = len - 1; i >= 0; i--)
+    {
+        xcb_generic_event_t *event = events[i];
+        bool drop = false;
+
+        /* Leave events sent by clients alone */
+        if(event->response_type & 0x80)
+            continue;
+
+        switch(XCB_EVENT_RESPONSE_TYPE(event))
+        {
+          case XCB_MOTION_NOTIFY:
+            if(motion_follows)
+            {
+                drop = true;
+                coalesce_stats.motion_notify++;
+            }
+            motion_follows = true;
+            break;
+          case XCB_ENTER_NOTIFY:
+          case XCB_LEAVE_NOTIFY:
+          case XCB_BUTTON_PRESS:
+          case XCB_BUTTON_RELEASE:
+            motion_follows = false;
+            break;
+          case XCB_PROPERTY_NOTIFY:
+            {
+                xcb_property_notify_event_t *ev = (void *) event;
+                /* Deletions and selection transfers are part of protocols
+                 * that need to see every step */
+                if(ev->state != XCB_PROPERTY_NEW_VALUE || ev->atom == AWESOME_SELECTION_ATOM)
+                    break;
+                foreach(prop, properties)
+                    if(prop->window == ev->window && prop->atom == ev->atom)
+                    {
+                        drop = true;
+                        coalesce_stats.property_notify++;
+                        break;
+                    }
+                if(!drop)
+                    coalesce_property_array_append(&properties,
+                            (coalesce_property_t) { .window = ev->window, .atom = ev->atom });
+            }
+            break;
+          case XCB_CONFIGURE_REQUEST:
+            {
+                xcb_configure_request_event_t *ev = (void *) event;
+                coalesce_configure_t *found = NULL;
+                foreach(conf, configures)
+                    if(conf->window == ev->window)
+                    {
+                        found = conf;
+                        break;
+                    }
+                if(found && found->later && event_coalesce_configure_covers(ev, found->later))
+                {
+                    drop = true;
+                    coalesce_stats.configure_request++;
+                }
+                else if(found)
+                    found->later = ev;
+                else
+                    coalesce_configure_array_append(&configures,
+                            (coalesce_configure_t) { .window = ev->window, .later = ev });
+            }
+            break;
+          case XCB_EXPOSE:
+            {
+                xcb_expose_event_t *ev = (void *) event;
+                foreach(other, exposes)
+                    if((*other)->window == ev->window && event_coalesce_expose_merge(*other, ev))
+                    {
+                        drop = true;
+                        coalesce_stats.expose++;
+                        break;
+                    }
+                if(!drop)
+                    coalesce_expose_array_append(&exposes, ev);
+            }
+            break;
+          default:
+            {
+                /* Earlier ConfigureRequests must not jump over this event */
+                xcb_window_t win = event_coalesce_barrier_window(event);
+                if(win != XCB_NONE)
+                    foreach(conf, configures)
+                        if(conf->window == win)
+                            conf->later = NULL;
+            }
+            break;
+        }
+
+        if(drop)
+        {
+            p_delete(&events[i]);
+        }
+    }
+
+    properties.len = configures.len = exposes.len = 0;
+}
+
+/** Get the number of events dropped by event_coalesce() since startup.
+ * \return The counters, per event type.
+ */
+const event_coalesce_stats_t *
+event_get_coalesce_stats(void)
+{
+    return &coalesce_stats;
+}
+
 void event_init(void)
 {
     const xcb_query_extension_reply_t *reply;
@@ -1160,6 +1417,10 @@ void event_init(void)
     reply = xcb_get_extension_data(globalconf.connection, &xcb_xfixes_id);
     if (reply && reply->present)
         globalconf.event_base_xfixes = reply->first_event;
+
+    reply = xcb_get_extension_data(globalconf.connection, &xcb_damage_id);
+    if (reply && reply->present)
+        globalconf.event_base_damage = reply->first_event;
 }
 
 // vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
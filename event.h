@@ -25,6 +25,7 @@
 #include "banning.h"
 #include "globalconf.h"
 #include "stack.h"
+#include "stats.h"
 
 #include <xcb/xcb.h>
 
@@ -42,17 +43,34 @@ void client_destroy_later(void);
 static inline int
 awesome_refresh(void)
 {
+    gint64 t = stats_now();
     luaA_emit_refresh();
+    t = stats_record(STATS_PHASE_REFRESH_SIGNAL, t);
     drawin_refresh();
+    t = stats_record(STATS_PHASE_DRAWIN_REFRESH, t);
     client_refresh();
+    t = stats_record(STATS_PHASE_CLIENT_REFRESH, t);
     banning_refresh();
+    t = stats_record(STATS_PHASE_BANNING_REFRESH, t);
     stack_refresh();
+    t = stats_record(STATS_PHASE_STACK_REFRESH, t);
     client_destroy_later();
+    stats_record(STATS_PHASE_DESTROY_LATER, t);
     return xcb_flush(globalconf.connection);
 }
 
+typedef struct
+{
+    int motion_notify;
+    int property_notify;
+    int configure_request;
+    int expose;
+} event_coalesce_stats_t;
+
 void event_init(void);
 void event_handle(xcb_generic_event_t *);
+void event_coalesce(xcb_generic_event_t **, int);
+const event_coalesce_stats_t *event_get_coalesce_stats(void);
 void event_drawable_under_mouse(lua_State *, int);
 
 #endif
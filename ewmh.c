@@ -24,6 +24,7 @@
 #include "objects/tag.h"
 #include "common/atoms.h"
 #include "xwindow.h"
+#include "stats.h"
 
 #include <sys/types.h>
 #include <unistd.h>
@@ -584,27 +585,37 @@ ewmh_update_window_type(xcb_window_t window, uint32_t type)
                         window, _NET_WM_WINDOW_TYPE, XCB_ATOM_ATOM, 32, 1, &type);
 }
 
+/** Send the GetProperty requests needed by ewmh_client_check_hints().
+ * \param window The client window.
+ * \return The cookies to pass to ewmh_client_check_hints().
+ */
+ewmh_client_hints_cookies_t
+ewmh_client_get_hints_unchecked(xcb_window_t window)
+{
+    ewmh_client_hints_cookies_t cookies;
+
+    cookies.desktop = xcb_get_property_unchecked(globalconf.connection, false, window,
+                                                 _NET_WM_DESKTOP, XCB_GET_PROPERTY_TYPE_ANY, 0, 1);
+
+    cookies.state = xcb_get_property_unchecked(globalconf.connection, false, window,
+                                               _NET_WM_STATE, XCB_ATOM_ATOM, 0, UINT32_MAX);
+
+    cookies.window_type = xcb_get_property_unchecked(globalconf.connection, false, window,
+                                                     _NET_WM_WINDOW_TYPE, XCB_ATOM_ATOM, 0, UINT32_MAX);
+
+    return cookies;
+}
+
 void
-ewmh_client_check_hints(client_t *c)
+ewmh_client_check_hints(client_t *c, ewmh_client_hints_cookies_t cookies)
 {
     xcb_atom_t *state;
     void *data = NULL;
-    xcb_get_property_cookie_t c0, c1, c2;
     xcb_get_property_reply_t *reply;
     bool is_h_max = false;
     bool is_v_max = false;
 
-    /* Send the GetProperty requests which will be processed later */
-    c0 = xcb_get_property_unchecked(globalconf.connection, false, c->window,
-                                    _NET_WM_DESKTOP, XCB_GET_PROPERTY_TYPE_ANY, 0, 1);
-
-    c1 = xcb_get_property_unchecked(globalconf.connection, false, c->window,
-                                    _NET_WM_STATE, XCB_ATOM_ATOM, 0, UINT32_MAX);
-
-    c2 = xcb_get_property_unchecked(globalconf.connection, false, c->window,
-                                    _NET_WM_WINDOW_TYPE, XCB_ATOM_ATOM, 0, UINT32_MAX);
-
-    reply = xcb_get_property_reply(globalconf.connection, c0, NULL);
+    reply = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, cookies.desktop, NULL));
     if(reply && reply->value_len && (data = xcb_get_property_value(reply)))
     {
         ewmh_process_desktop(c, *(uint32_t *) data);
@@ -612,7 +623,7 @@ ewmh_client_check_hints(client_t *c)
 
     p_delete(&reply);
 
-    reply = xcb_get_property_reply(globalconf.connection, c1, NULL);
+    reply = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, cookies.state, NULL));
     if(reply && (data = xcb_get_property_value(reply)))
     {
         state = (xcb_atom_t *) data;
@@ -649,7 +660,7 @@ ewmh_client_check_hints(client_t *c)
 
     p_delete(&reply);
 
-    reply = xcb_get_property_reply(globalconf.connection, c2, NULL);
+    reply = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, cookies.window_type, NULL));
     if(reply && (data = xcb_get_property_value(reply)))
     {
         c->has_NET_WM_WINDOW_TYPE = true;
@@ -675,18 +686,28 @@ ewmh_client_check_hints(client_t *c)
     p_delete(&reply);
 }
 
+/** Send the GetProperty request for the WM strut of a window.
+ * \param window The client window.
+ * \return The cookie to pass to ewmh_process_client_strut().
+ */
+xcb_get_property_cookie_t
+ewmh_client_strut_get_unchecked(xcb_window_t window)
+{
+    return xcb_get_property_unchecked(globalconf.connection, false, window,
+                                      _NET_WM_STRUT_PARTIAL, XCB_ATOM_CARDINAL, 0, 12);
+}
+
 /** Process the WM strut of a client.
  * \param c The client.
+ * \param strut_q Cookie returned by ewmh_client_strut_get_unchecked().
  */
 void
-ewmh_process_client_strut(client_t *c)
+ewmh_process_client_strut(client_t *c, xcb_get_property_cookie_t strut_q)
 {
     void *data;
     xcb_get_property_reply_t *strut_r;
 
-    xcb_get_property_cookie_t strut_q = xcb_get_property_unchecked(globalconf.connection, false, c->window,
-                                                                   _NET_WM_STRUT_PARTIAL, XCB_ATOM_CARDINAL, 0, 12);
-    strut_r = xcb_get_property_reply(globalconf.connection, strut_q, NULL);
+    strut_r = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, strut_q, NULL));
 
     if(strut_r
        && strut_r->value_len
@@ -741,15 +762,14 @@ ewmh_window_icon_get_unchecked(xcb_window_t w)
                                     _NET_WM_ICON, XCB_ATOM_CARDINAL, 0, UINT32_MAX);
 }
 
-static cairo_surface_t *
-ewmh_window_icon_from_reply_next(uint32_t **data, uint32_t *data_end)
+static bool
+ewmh_window_icon_from_reply_next(uint32_t **data, uint32_t *data_end, draw_icon_t *icon)
 {
     uint32_t width, height;
     uint64_t data_len;
-    uint32_t *icon_data;
 
     if(data_end - *data <= 2)
-        return NULL;
+        return false;
 
     width = (*data)[0];
     height = (*data)[1];
@@ -757,47 +777,59 @@ ewmh_window_icon_from_reply_next(uint32_t **data, uint32_t *data_end)
     /* Check that we have enough data, handling overflow */
     data_len = width * (uint64_t) height;
     if (width < 1 || height < 1 || data_len > (uint64_t) (data_end - *data) - 2)
-        return NULL;
+        return false;
 
-    icon_data = *data + 2;
+    icon->width = width;
+    icon->height = height;
+    icon->data = *data + 2;
     *data += 2 + data_len;
-    return draw_surface_from_data(width, height, icon_data);
+    return true;
 }
 
-static cairo_surface_array_t
+/** Split a _NET_WM_ICON reply into its icons without decoding them.
+ * \param r The reply, which is taken over.
+ * \return An array of icons which share the reply's memory.
+ */
+static draw_icon_array_t
 ewmh_window_icon_from_reply(xcb_get_property_reply_t *r)
 {
     uint32_t *data, *data_end;
-    cairo_surface_array_t result;
-    cairo_surface_t *s;
+    draw_icon_array_t result;
+    draw_icon_t icon = { .surface = NULL };
 
-    cairo_surface_array_init(&result);
+    draw_icon_array_init(&result);
     if(!r || r->type != XCB_ATOM_CARDINAL || r->format != 32)
+    {
+        p_delete(&r);
         return result;
+    }
 
     data = (uint32_t*) xcb_get_property_value(r);
     data_end = &data[r->length];
-    if(!data)
-        return result;
+    GBytes *bytes = g_bytes_new_with_free_func(r, sizeof(*r) + r->length * 4, free, r);
 
-    while ((s = ewmh_window_icon_from_reply_next(&data, data_end)) != NULL) {
-        cairo_surface_array_push(&result, s);
+    while (ewmh_window_icon_from_reply_next(&data, data_end, &icon))
+    {
+        /* Cairo cannot handle anything larger */
+        if (icon.width > INT16_MAX || icon.height > INT16_MAX)
+            continue;
+        icon.bytes = g_bytes_ref(bytes);
+        draw_icon_array_append(&result, icon);
     }
 
+    g_bytes_unref(bytes);
     return result;
 }
 
-/** Get NET_WM_ICON.
+/** Get NET_WM_ICON. The icons are only decoded when they are used.
  * \param cookie The cookie.
  * \return An array of icons.
  */
-cairo_surface_array_t
+draw_icon_array_t
 ewmh_window_icon_get_reply(xcb_get_property_cookie_t cookie)
 {
-    xcb_get_property_reply_t *r = xcb_get_property_reply(globalconf.connection, cookie, NULL);
-    cairo_surface_array_t result = ewmh_window_icon_from_reply(r);
-    p_delete(&r);
-    return result;
+    return ewmh_window_icon_from_reply(
+            A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, cookie, NULL)));
 }
 
 // vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
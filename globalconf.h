@@ -41,6 +41,7 @@
 #include "objects/key.h"
 #include "common/xembed.h"
 #include "common/buffer.h"
+#include "common/winmap.h"
 
 #define ROOT_WINDOW_EVENT_MASK \
     (const uint32_t []) { \
@@ -70,6 +71,7 @@ typedef struct sequence_pair sequence_pair_t;
 
 ARRAY_TYPE(button_t *, button)
 ARRAY_TYPE(tag_t *, tag)
+ARRAY_TYPE(tag_t *, client_tag)
 ARRAY_TYPE(screen_t *, screen)
 ARRAY_TYPE(client_t *, client)
 ARRAY_TYPE(drawin_t *, drawin)
@@ -126,6 +128,12 @@ typedef struct
     bool have_xkb;
     /** Check for XFixes extension */
     bool have_xfixes;
+    /** Check for MIT-SHM extension */
+    bool have_shm;
+    /** Check for Composite extension with NameWindowPixmap support */
+    bool have_composite;
+    /** Check for DAMAGE extension */
+    bool have_damage;
     /** Custom searchpaths are present, the runtime is tinted */
     bool have_searchpaths;
     /** When --no-argb is used in the modeline or command line */
@@ -134,8 +142,11 @@ typedef struct
     uint8_t event_base_xkb;
     uint8_t event_base_randr;
     uint8_t event_base_xfixes;
+    uint8_t event_base_damage;
     /** Clients list */
     client_array_t clients;
+    /** Index from client and drawin windows to their objects */
+    winmap_t windows;
     /** Embedded windows */
     xembed_window_array_t embedded;
     /** Stack client history */
@@ -243,6 +254,7 @@ static inline lua_State *globalconf_get_lua_State(void) {
 
 /* Defined in root.c */
 void root_update_wallpaper(void);
+void root_wallpaper_flush(void);
 
 #endif
 // vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
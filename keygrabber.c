@@ -31,6 +31,7 @@
 
 #include "keygrabber.h"
 #include "globalconf.h"
+#include "stats.h"
 
 /** Grab the keyboard.
  * \return True if keyboard was grabbed.
@@ -43,12 +44,12 @@ keygrabber_grab(void)
 
     for(i = 1000; i; i--)
     {
-        if((xgb = xcb_grab_keyboard_reply(globalconf.connection,
+        if((xgb = A_XCB_WAIT(xcb_grab_keyboard_reply(globalconf.connection,
                                           xcb_grab_keyboard(globalconf.connection, true,
                                                             globalconf.screen->root,
                                                             XCB_CURRENT_TIME, XCB_GRAB_MODE_ASYNC,
                                                             XCB_GRAB_MODE_ASYNC),
-                                          NULL)))
+                                          NULL))))
         {
             p_delete(&xgb);
             return true;
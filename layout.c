@@ -0,0 +1,591 @@
+/*
+ * layout.c - native client layouts
+ *
+ * Copyright © 2026 Awesome Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/* These are the tile, fair, max and spiral layouts of awful.layout.suit, which
+ * use them through awesome._layout. They take the same parameter table as the
+ * Lua versions and fill p.geometries with exactly the same numbers: all math
+ * is done in doubles in the same order as in Lua. apply() then replaces the
+ * loop over p.geometries in awful.layout.arrange, so that an arrange crosses
+ * into C twice instead of once per client.
+ */
+
+#include "globalconf.h"
+#include "luaa.h"
+#include "objects/client.h"
+#include "common/xutil.h"
+
+#include <math.h>
+
+typedef struct
+{
+    double x, y, width, height;
+} layout_area_t;
+
+/** The state of one call to a layout */
+typedef struct
+{
+    lua_State *L;
+    /** Stack indices of p.clients and p.geometries */
+    int clients, geometries;
+    int n;
+    layout_area_t wa;
+} layout_t;
+
+/** Get one of the areas of a layout parameter table.
+ * \param L The Lua VM state.
+ * \param idx The index of the parameter table.
+ * \param name The name of the area, e.g. "workarea".
+ * \return The area.
+ */
+static layout_area_t
+layout_getarea(lua_State *L, int idx, const char *name)
+{
+    layout_area_t area;
+
+    lua_getfield(L, idx, name);
+    luaA_checktable(L, -1);
+    area.x = luaA_getopt_number(L, -1, "x", 0);
+    area.y = luaA_getopt_number(L, -1, "y", 0);
+    area.width = luaA_getopt_number(L, -1, "width", 0);
+    area.height = luaA_getopt_number(L, -1, "height", 0);
+    lua_pop(L, 1);
+
+    return area;
+}
+
+/** Prepare a layout call, pushing p.clients and p.geometries.
+ * \param L The Lua VM state.
+ * \param layout The layout state to fill.
+ * \param area The name of the area to arrange the clients in.
+ */
+static void
+layout_init(lua_State *L, layout_t *layout, const char *area)
+{
+    luaA_checktable(L, 1);
+    layout->L = L;
+    layout->wa = layout_getarea(L, 1, area);
+
+    lua_getfield(L, 1, "clients");
+    luaA_checktable(L, -1);
+    layout->clients = lua_gettop(L);
+    layout->n = luaA_rawlen(L, layout->clients);
+
+    lua_getfield(L, 1, "geometries");
+    luaA_checktable(L, -1);
+    layout->geometries = lua_gettop(L);
+}
+
+/** Get a client of the layout.
+ * \param layout The layout state.
+ * \param i The client's index in p.clients, starting at 1.
+ * \return The client.
+ */
+static client_t *
+layout_client(layout_t *layout, int i)
+{
+    client_t *c;
+
+    lua_rawgeti(layout->L, layout->clients, i);
+    c = luaA_checkudata(layout->L, -1, &client_class);
+    lua_pop(layout->L, 1);
+
+    return c;
+}
+
+/** Set p.geometries[p.clients[i]].
+ * \param layout The layout state.
+ * \param i The client's index in p.clients, starting at 1.
+ * \param g The client's geometry.
+ */
+static void
+layout_set_geometry(layout_t *layout, int i, layout_area_t g)
+{
+    lua_State *L = layout->L;
+
+    lua_rawgeti(L, layout->clients, i);
+    lua_createtable(L, 0, 4);
+    lua_pushnumber(L, g.x);
+    lua_setfield(L, -2, "x");
+    lua_pushnumber(L, g.y);
+    lua_setfield(L, -2, "y");
+    lua_pushnumber(L, g.width);
+    lua_setfield(L, -2, "width");
+    lua_pushnumber(L, g.height);
+    lua_setfield(L, -2, "height");
+    lua_rawset(L, layout->geometries);
+}
+
+static layout_area_t
+layout_area_swap(layout_area_t area)
+{
+    return (layout_area_t) {
+        .x = area.y, .y = area.x,
+        .width = area.height, .height = area.width
+    };
+}
+
+/** Get the smallest size a client wants, like size_hints.min_width or
+ * size_hints.base_width.
+ * \param c The client.
+ * \param vertical Whether to get the height instead of the width.
+ * \return The size or 0.
+ */
+static double
+layout_size_hint(client_t *c, bool vertical)
+{
+    if (c->size_hints.flags & XCB_ICCCM_SIZE_HINT_P_MIN_SIZE)
+        return vertical ? c->size_hints.min_height : c->size_hints.min_width;
+    if (c->size_hints.flags & XCB_ICCCM_SIZE_HINT_BASE_SIZE)
+        return vertical ? c->size_hints.base_height : c->size_hints.base_width;
+    return 0;
+}
+
+/** Apply a client's size hints to the space given to it, like the
+ * apply_size_hints() helper of the Lua tile layout.
+ * \param c The client.
+ * \param width The width including border and gap.
+ * \param height The height including border and gap.
+ * \param useless_gap The gap.
+ * \return The size that the client will use, including border and gap.
+ */
+static layout_area_t
+layout_size_hinted(client_t *c, double width, double height, double useless_gap)
+{
+    double bw = c->border_width;
+    area_t hinted;
+
+    width = width - 2 * bw - useless_gap;
+    height = height - 2 * bw - useless_gap;
+    hinted = client_size_hinted(c,
+                                ceil(MIN(MAX(1, width), MAX_X11_SIZE)),
+                                ceil(MIN(MAX(1, height), MAX_X11_SIZE)));
+
+    return (layout_area_t) {
+        .width = hinted.width + 2 * bw + useless_gap,
+        .height = hinted.height + 2 * bw + useless_gap
+    };
+}
+
+/** Get a window factor, fact[i] of the Lua tile layout.
+ * \param L The Lua VM state.
+ * \param fact The index of the factor table.
+ * \param i The client's index in its group.
+ * \return The factor, or 0 if it is not set.
+ */
+static double
+layout_tile_fact(lua_State *L, int fact, int i)
+{
+    double value;
+
+    lua_rawgeti(L, fact, i);
+    value = lua_tonumber(L, -1);
+    lua_pop(L, 1);
+
+    return value;
+}
+
+/** Arrange a master or slave column of the tile layout. The work area and all
+ * geometries are swapped for the top and bottom layouts, so that "width" is
+ * always the column width.
+ * \return The width used by the column.
+ */
+static double
+layout_tile_group(layout_t *layout, bool swap, double useless_gap, int fact,
+                  int first, int last, double group_coord, double group_size)
+{
+    lua_State *L = layout->L;
+    layout_area_t wa = layout->wa;
+    double available = wa.width - (group_coord - wa.x);
+    double total_fact = 0, min_fact = 1;
+    double size = group_size;
+
+    for (int c = first; c <= last; c++)
+    {
+        int i = c - first + 1;
+        size = MAX(layout_size_hint(layout_client(layout, c), swap), size);
+
+        double f;
+        lua_rawgeti(L, fact, i);
+        if (!lua_toboolean(L, -1))
+        {
+            f = min_fact;
+            lua_pushnumber(L, f);
+            lua_rawseti(L, fact, i);
+        }
+        else
+        {
+            f = lua_tonumber(L, -1);
+            min_fact = MIN(f, min_fact);
+        }
+        lua_pop(L, 1);
+        total_fact = total_fact + f;
+    }
+    size = MAX(1, MIN(size, available));
+
+    double coord = wa.y;
+    double used_size = 0;
+    double unused = wa.height;
+    for (int c = first; c <= last; c++)
+    {
+        client_t *cl = layout_client(layout, c);
+        double f = layout_tile_fact(L, fact, c - first + 1);
+        layout_area_t geom = {
+            .x = group_coord,
+            .y = coord,
+            .width = size,
+            .height = MAX(1, floor(unused * f / total_fact))
+        };
+        if (swap)
+            geom = layout_area_swap(geom);
+        layout_set_geometry(layout, c, geom);
+
+        layout_area_t hints = layout_size_hinted(cl, geom.width, geom.height, useless_gap);
+        if (swap)
+            hints = layout_area_swap(hints);
+        coord = coord + hints.height;
+        unused = unused - hints.height;
+        total_fact = total_fact - f;
+        used_size = MAX(used_size, hints.width);
+    }
+
+    return used_size;
+}
+
+/** Get a column's window factors, creating the table if needed.
+ * \param L The Lua VM state.
+ * \param data The index of the tag's windowfact table.
+ * \param column The column, 0 for the master column.
+ * \return The stack index of the factor table.
+ */
+static int
+layout_tile_column_facts(lua_State *L, int data, int column)
+{
+    lua_rawgeti(L, data, column);
+    if (!lua_toboolean(L, -1))
+    {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, data, column);
+    }
+    return lua_gettop(L);
+}
+
+/** The tile layouts.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam The layout parameters.
+ * \lparam The orientation: "right", "left", "top" or "bottom".
+ * \lparam The tag's master_count.
+ * \lparam The tag's master_width_factor.
+ * \lparam The tag's column_count.
+ * \lparam Whether the tag's master_fill_policy is "expand".
+ * \lparam The tag's windowfact table.
+ */
+static int
+luaA_layout_tile(lua_State *L)
+{
+    const char *orientation = luaL_checkstring(L, 2);
+    int master_count = luaA_checkinteger(L, 3);
+    double mwfact = luaL_checknumber(L, 4);
+    int ncol = luaA_checkinteger(L, 5);
+    bool grow_master = lua_toboolean(L, 6);
+    bool swap = A_STREQ(orientation, "top") || A_STREQ(orientation, "bottom");
+    bool master_last = A_STREQ(orientation, "left") || A_STREQ(orientation, "top");
+    double useless_gap;
+    layout_t layout;
+
+    luaA_checktable(L, 7);
+    lua_settop(L, 7);
+    useless_gap = luaA_getopt_number(L, 1, "useless_gap", 0);
+    layout_init(L, &layout, "workarea");
+    if (swap)
+        layout.wa = layout_area_swap(layout.wa);
+
+    layout_area_t wa = layout.wa;
+    int n = layout.n;
+    int nmaster = MIN(master_count, n);
+    int nother = MAX(n - nmaster, 0);
+    double coord = wa.x;
+    bool place_master = !master_last;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if (place_master && nmaster > 0)
+        {
+            double size = wa.width;
+            if (nother > 0 || !grow_master)
+                size = MIN(wa.width * mwfact, wa.width - (coord - wa.x));
+            if (nother == 0 && !grow_master)
+                coord = coord + (wa.width - size) / 2;
+            int fact = layout_tile_column_facts(L, 7, 0);
+            coord = coord + layout_tile_group(&layout, swap, useless_gap, fact,
+                                              1, nmaster, coord, size);
+            lua_pop(L, 1);
+        }
+
+        if (!place_master && nother > 0)
+        {
+            int last = nmaster;
+            double wasize = wa.width;
+            if (nmaster > 0 && master_last)
+                wasize = wa.width - wa.width * mwfact;
+            for (int i = 1; i <= ncol; i++)
+            {
+                double size = (wasize - (coord - wa.x)) / (ncol - i + 1);
+                int first = last + 1;
+                last = last + floor((double) (n - last) / (ncol - i + 1));
+                int fact = layout_tile_column_facts(L, 7, i);
+                coord = coord + layout_tile_group(&layout, swap, useless_gap, fact,
+                                                  first, last, coord, size);
+                lua_pop(L, 1);
+            }
+        }
+        place_master = !place_master;
+    }
+
+    return 0;
+}
+
+/** The fair layouts.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam The layout parameters.
+ * \lparam The orientation: "east" or "south".
+ */
+static int
+luaA_layout_fair(lua_State *L)
+{
+    bool east = A_STREQ(luaL_checkstring(L, 2), "east");
+    layout_t layout;
+
+    layout_init(L, &layout, "workarea");
+    if (east)
+        layout.wa = layout_area_swap(layout.wa);
+
+    layout_area_t wa = layout.wa;
+    int n = layout.n;
+    if (n == 0)
+        return 0;
+
+    int rows, cols;
+    if (n == 2)
+    {
+        rows = 1;
+        cols = 2;
+    }
+    else
+    {
+        rows = ceil(sqrt(n));
+        cols = ceil((double) n / rows);
+    }
+
+    for (int k = 0; k < n; k++)
+    {
+        layout_area_t g;
+        int row = k % rows;
+        int col = k / rows;
+        int lrows = rows, lcols = cols;
+
+        if (k >= rows * cols - rows)
+            lrows = n - (rows * cols - rows);
+
+        if (row == lrows - 1)
+        {
+            g.height = wa.height - ceil(wa.height / lrows) * row;
+            g.y = wa.height - g.height;
+        }
+        else
+        {
+            g.height = ceil(wa.height / lrows);
+            g.y = g.height * row;
+        }
+
+        if (col == lcols - 1)
+        {
+            g.width = wa.width - ceil(wa.width / lcols) * col;
+            g.x = wa.width - g.width;
+        }
+        else
+        {
+            g.width = ceil(wa.width / lcols);
+            g.x = g.width * col;
+        }
+
+        g.y = g.y + wa.y;
+        g.x = g.x + wa.x;
+
+        if (east)
+            g = layout_area_swap(g);
+        layout_set_geometry(&layout, k + 1, g);
+    }
+
+    return 0;
+}
+
+/** The max layouts.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam The layout parameters.
+ * \lparam Whether to use the whole screen instead of the work area.
+ */
+static int
+luaA_layout_max(lua_State *L)
+{
+    bool fullscreen = lua_toboolean(L, 2);
+    layout_t layout;
+
+    layout_init(L, &layout, fullscreen ? "geometry" : "workarea");
+    for (int i = 1; i <= layout.n; i++)
+        layout_set_geometry(&layout, i, layout.wa);
+
+    return 0;
+}
+
+/** The spiral and dwindle layouts.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam The layout parameters.
+ * \lparam True for spiral, false for dwindle.
+ */
+static int
+luaA_layout_spiral(lua_State *L)
+{
+    bool spiral = lua_toboolean(L, 2);
+    layout_t layout;
+
+    layout_init(L, &layout, "workarea");
+
+    layout_area_t wa = layout.wa;
+    int n = layout.n;
+    double old_width = wa.width, old_height = 2 * wa.height;
+
+    for (int k = 1; k <= n; k++)
+    {
+        double size;
+
+        if (k % 2 == 0)
+        {
+            size = ceil(old_width / 2);
+            old_width = wa.width;
+            wa.width = size;
+            if (k != n)
+            {
+                size = floor(wa.height / 2);
+                old_height = wa.height;
+                wa.height = size;
+            }
+        }
+        else
+        {
+            size = ceil(old_height / 2);
+            old_height = wa.height;
+            wa.height = size;
+            if (k != n)
+            {
+                size = floor(wa.width / 2);
+                old_width = wa.width;
+                wa.width = size;
+            }
+        }
+
+        if (k % 4 == 0 && spiral)
+            wa.x = wa.x - wa.width;
+        else if (k % 2 == 0)
+            wa.x = wa.x + old_width;
+        else if (k % 4 == 3 && k < n && spiral)
+            wa.x = wa.x + ceil(old_width / 2);
+
+        if (k % 4 == 1 && k != 1 && spiral)
+            wa.y = wa.y - wa.height;
+        else if (k % 2 == 1 && k != 1)
+            wa.y = wa.y + old_height;
+        else if (k % 4 == 0 && k < n && spiral)
+            wa.y = wa.y + ceil(old_height / 2);
+
+        layout_set_geometry(&layout, k, wa);
+    }
+
+    return 0;
+}
+
+/** Apply the geometries computed by a layout, like the loop at the end of
+ * awful.layout.arrange used to do with c:geometry(). The geometry tables are
+ * updated to what was applied.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ * \luastack
+ * \lparam The p.geometries table, mapping clients to geometries.
+ * \lparam The useless gap.
+ */
+static int
+luaA_layout_apply(lua_State *L)
+{
+    double useless_gap;
+
+    luaA_checktable(L, 1);
+    useless_gap = luaL_checknumber(L, 2);
+    lua_settop(L, 2);
+
+    lua_pushnil(L);
+    while (lua_next(L, 1))
+    {
+        client_t *c = luaA_checkudata(L, -2, &client_class);
+        double bw = c->border_width;
+        int g = lua_gettop(L);
+
+        luaA_checktable(L, g);
+        double width = luaA_getopt_number(L, g, "width", 0);
+        double height = luaA_getopt_number(L, g, "height", 0);
+        double x = luaA_getopt_number(L, g, "x", 0);
+        double y = luaA_getopt_number(L, g, "y", 0);
+
+        lua_pushnumber(L, MAX(1, width - bw * 2 - useless_gap * 2));
+        lua_setfield(L, g, "width");
+        lua_pushnumber(L, MAX(1, height - bw * 2 - useless_gap * 2));
+        lua_setfield(L, g, "height");
+        lua_pushnumber(L, x + useless_gap);
+        lua_setfield(L, g, "x");
+        lua_pushnumber(L, y + useless_gap);
+        lua_setfield(L, g, "y");
+
+        luaA_client_set_geometry(L, c, g);
+        lua_pop(L, 1);
+    }
+
+    return 0;
+}
+
+const struct luaL_Reg awesome_layout_lib[] =
+{
+    { "tile", luaA_layout_tile },
+    { "fair", luaA_layout_fair },
+    { "max", luaA_layout_max },
+    { "spiral", luaA_layout_spiral },
+    { "apply", luaA_layout_apply },
+    { NULL, NULL }
+};
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
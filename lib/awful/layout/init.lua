@@ -232,6 +232,13 @@ function layout.arrange(screen)
 
             p.geometries = setmetatable({}, {__mode = "k"})
             layout.get(screen).arrange(p)
+
+            -- Resize all clients with one call into C
+            if capi.awesome._layout then
+                capi.awesome._layout.apply(p.geometries, useless_gap)
+                return
+            end
+
             for c, g in pairs(p.geometries) do
                 g.width = math.max(1, g.width - c.border_width * 2 - useless_gap * 2)
                 g.height = math.max(1, g.height - c.border_width * 2 - useless_gap * 2)
@@ -9,6 +9,7 @@
 -- Grab environment we need
 local ipairs = ipairs
 local math = math
+local capi = { awesome = awesome }
 
 --- The fairh layout layoutbox icon.
 -- @beautiful beautiful.layout_fairh
@@ -22,7 +23,16 @@ local math = math
 
 local fair = {}
 
+--- Compute the fair layouts in C. The result is the same, only faster.
+-- @field awful.layout.suit.fair.native
+fair.native = true
+
 local function do_fair(p, orientation)
+    local native = fair.native and capi.awesome and capi.awesome._layout
+    if native then
+        return native.fair(p, orientation)
+    end
+
     local wa = p.workarea
     local cls = p.clients
 
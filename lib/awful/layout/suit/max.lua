@@ -8,6 +8,7 @@
 
 -- Grab environment we need
 local pairs = pairs
+local capi = { awesome = awesome }
 
 local max = {}
 
@@ -21,7 +22,16 @@ local max = {}
 -- @param surface
 -- @see gears.surface
 
+--- Compute the max layouts in C. The result is the same, only faster.
+-- @field awful.layout.suit.max.native
+max.native = true
+
 local function fmax(p, fs)
+    local native = max.native and capi.awesome and capi.awesome._layout
+    if native then
+        return native.max(p, fs)
+    end
+
     -- Fullscreen?
     local area
     if fs then
@@ -11,6 +11,7 @@
 -- Grab environment we need
 local ipairs = ipairs
 local math = math
+local capi = { awesome = awesome }
 
 --- The spiral layout layoutbox icon.
 -- @beautiful beautiful.layout_spiral
@@ -24,7 +25,16 @@ local math = math
 
 local spiral = {}
 
+--- Compute the spiral layouts in C. The result is the same, only faster.
+-- @field awful.layout.suit.spiral.native
+spiral.native = true
+
 local function do_spiral(p, _spiral)
+    local native = spiral.native and capi.awesome and capi.awesome._layout
+    if native then
+        return native.spiral(p, _spiral)
+    end
+
     local wa = p.workarea
     local cls = p.clients
     local n = #cls
@@ -17,7 +17,8 @@ local capi =
 {
     mouse = mouse,
     screen = screen,
-    mousegrabber = mousegrabber
+    mousegrabber = mousegrabber,
+    awesome = awesome
 }
 
 local tile = {}
@@ -46,6 +47,10 @@ local tile = {}
 -- @field awful.layout.suit.tile.resize_jump_to_corner
 tile.resize_jump_to_corner = true
 
+--- Compute the tile layouts in C. The result is the same, only faster.
+-- @field awful.layout.suit.tile.native
+tile.native = true
+
 local function mouse_resize_handler(c, _, _, _, orientation)
     orientation = orientation or "tile"
     local wa = c.screen.workarea
@@ -254,6 +259,12 @@ local function do_tile(param, orientation)
         tag.getdata(t).windowfact = data
     end
 
+    local native = tile.native and capi.awesome and capi.awesome._layout
+    if native then
+        return native.tile(param, orientation, t.master_count, mwfact, ncol,
+                           t.master_fill_policy == "expand", data)
+    end
+
     local coord = wa[x]
     local place_master = true
     if orientation == "left" or orientation == "top" then
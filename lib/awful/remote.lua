@@ -15,10 +15,29 @@ local table = table
 local unpack = unpack or table.unpack -- luacheck: globals unpack (compatibility with Lua 5.1)
 local dbus = dbus
 local type = type
+local pairs = pairs
+local capi = { awesome = awesome }
+
+--- Flatten `awesome.stats()` into sorted "key.subkey=value" lines.
+local function format_stats(stats, prefix, lines)
+    for k, v in pairs(stats) do
+        local key = prefix and prefix .. "." .. k or k
+        if type(v) == "table" then
+            format_stats(v, key, lines)
+        else
+            table.insert(lines, key .. "=" .. tostring(v))
+        end
+    end
+    return lines
+end
 
 if dbus then
     dbus.connect_signal("org.awesomewm.awful.Remote", function(data, code)
-        if data.member == "Eval" then
+        if data.member == "Stats" then
+            local lines = format_stats(capi.awesome.stats(), nil, {})
+            table.sort(lines)
+            return "s", table.concat(lines, "\n")
+        elseif data.member == "Eval" then
             local f, e = load(code)
             if not f then
                 return "s", e
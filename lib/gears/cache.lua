@@ -10,6 +10,9 @@
 --
 --@DOC_text_gears_cache_another_cache_EXAMPLE@
 --
+-- A cache can also be created with a maximum number of entries. Such a cache
+-- is not cleared by the garbage collector. Instead, the least recently used
+-- entries are removed when it is full.
 --
 -- @author Uli Schlachter
 -- @copyright 2015 Uli Schlachter
@@ -18,15 +21,133 @@
 
 local select = select
 local setmetatable = setmetatable
+local type = type
+local string = string
+local table = table
 local unpack = unpack or table.unpack -- luacheck: globals unpack (compatibility with Lua 5.1)
 
 local cache = {}
 
+-- Numbers for objects that appear in the keys of bounded caches. These are
+-- never reused, so an entry can not be found with a different object that
+-- happens to have the same address as a collected one.
+local object_ids = setmetatable({}, { __mode = "k" })
+local last_object_id = 0
+
+-- Turn an argument into a part of a key of a bounded cache. All parts can be
+-- concatenated without becoming ambiguous.
+local function key_part(arg)
+    local kind = type(arg)
+    if kind == "number" then
+        return string.format("n%.17g", arg)
+    elseif kind == "string" then
+        return "s" .. #arg .. ":" .. arg
+    elseif kind == "boolean" then
+        return arg and "t" or "f"
+    elseif kind == "nil" then
+        return "_"
+    end
+
+    local id = object_ids[arg]
+    if not id then
+        last_object_id = last_object_id + 1
+        id = last_object_id
+        object_ids[arg] = id
+    end
+    return "o" .. id
+end
+
+local function make_key(...)
+    local n = select("#", ...)
+    if n == 1 then
+        return key_part(...)
+    end
+    local parts = {}
+    for i = 1, n do
+        parts[i] = key_part((select(i, ...)))
+    end
+    return table.concat(parts, "|")
+end
+
+-- The entries of a bounded cache form a list from the most recently used one
+-- (_newest) to the least recently used one (_oldest).
+local function unlink(self, entry)
+    if entry.newer then
+        entry.newer.older = entry.older
+    else
+        self._newest = entry.older
+    end
+    if entry.older then
+        entry.older.newer = entry.newer
+    else
+        self._oldest = entry.newer
+    end
+    entry.newer, entry.older = nil, nil
+end
+
+local function push_newest(self, entry)
+    entry.older = self._newest
+    if self._newest then
+        self._newest.newer = entry
+    else
+        self._oldest = entry
+    end
+    self._newest = entry
+end
+
+local function get_bounded(self, ...)
+    local key = make_key(...)
+    local entry = self._entries[key]
+    if entry then
+        self._hits = self._hits + 1
+        if entry ~= self._newest then
+            unlink(self, entry)
+            push_newest(self, entry)
+        end
+        return unpack(entry.value)
+    end
+
+    self._misses = self._misses + 1
+    local generation = self._generation
+    local value = { self._creation_cb(...) }
+
+    -- The cache was cleared while the entry was created, so it is outdated
+    if generation ~= self._generation then
+        return unpack(value)
+    end
+
+    -- The callback might have created the same entry through get()
+    entry = self._entries[key]
+    if entry then
+        entry.value = value
+        return unpack(value)
+    end
+
+    entry = { key = key, value = value }
+    self._entries[key] = entry
+    push_newest(self, entry)
+    self._count = self._count + 1
+
+    if self._count > self._max_entries then
+        local oldest = self._oldest
+        unlink(self, oldest)
+        self._entries[oldest.key] = nil
+        self._count = self._count - 1
+        self._evictions = self._evictions + 1
+    end
+
+    return unpack(value)
+end
+
 --- Get an entry from the cache, creating it if it's missing.
 -- @param ... Arguments for the creation callback. These are checked against the
 --   cache contents for equality.
 -- @return The entry from the cache
 function cache:get(...)
+    if self._max_entries then
+        return get_bounded(self, ...)
+    end
+
     local result = self._cache
     for i = 1, select("#", ...) do
         local arg = select(i, ...)
@@ -39,24 +160,72 @@ function cache:get(...)
     end
     local ret = result._entry
     if not ret then
+        self._misses = self._misses + 1
         ret = { self._creation_cb(...) }
         result._entry = ret
+    else
+        self._hits = self._hits + 1
     end
     return unpack(ret)
 end
 
+--- Remove all entries from the cache.
+-- @method clear
+function cache:clear()
+    if self._max_entries then
+        self._entries = {}
+        self._newest, self._oldest = nil, nil
+        self._count = 0
+        self._generation = self._generation + 1
+    else
+        self._cache = setmetatable({}, { __mode = "v" })
+    end
+end
+
+--- Get statistics about the use of this cache.
+-- @treturn table A table with the number of `hits`, `misses` and `evictions`.
+--   For caches with a maximum size, it also contains the number of `entries`
+--   and the `max_entries`.
+-- @method stats
+function cache:stats()
+    return {
+        hits = self._hits,
+        misses = self._misses,
+        evictions = self._evictions,
+        entries = self._count,
+        max_entries = self._max_entries,
+    }
+end
+
 --- Create a new cache object. A cache keeps some data that can be
 -- garbage-collected at any time, but might be useful to keep.
 -- @param creation_cb Callback that is used for creating missing cache entries.
+-- @tparam[opt] integer max_entries Keep at most this many entries and remove
+--   the least recently used ones instead of letting the garbage collector
+--   clear the cache.
 -- @return A new cache object.
 -- @constructorfct gears.cache
-function cache.new(creation_cb)
-    return setmetatable({
-        _cache = setmetatable({}, { __mode = "v" }),
-        _creation_cb = creation_cb
+function cache.new(creation_cb, max_entries)
+    local ret = setmetatable({
+        _creation_cb = creation_cb,
+        _max_entries = max_entries,
+        _hits = 0,
+        _misses = 0,
+        _evictions = 0,
     }, {
         __index = cache
     })
+
+    if max_entries then
+        assert(max_entries >= 1, "A cache needs room for at least one entry")
+        ret._entries = {}
+        ret._count = 0
+        ret._generation = 0
+    else
+        ret._cache = setmetatable({}, { __mode = "v" })
+    end
+
+    return ret
 end
 
 return setmetatable(cache, { __call = function(_, ...) return cache.new(...) end })
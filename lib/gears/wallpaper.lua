@@ -24,6 +24,7 @@
 ---------------------------------------------------------------------------
 
 local cairo = require("lgi").cairo
+local Gio = require("lgi").Gio
 local color = require("gears.color")
 local surface = require("gears.surface")
 local timer = require("gears.timer")
@@ -37,69 +38,254 @@ local function root_geometry()
     return { x = 0, y = 0, width = width, height = height }
 end
 
--- Information about a pending wallpaper change, see prepare_context()
-local pending_wallpaper = nil
+-- Pending wallpaper changes in the order they were made, see prepare_context()
+local pending = {}
+
+--- The maximum number of bytes that rendered wallpapers may use in the cache.
+-- Rendered wallpapers are cached by file, screen geometry and mode, so that
+-- setting the same wallpaper again, for example after the screen layout
+-- changed back, does not have to scale the image again. The most recently used
+-- one is kept even if it is larger than this.
+-- @tfield[opt=134217728] integer gears.wallpaper.cache_limit
+wallpaper.cache_limit = 128 * 1024 * 1024
+
+-- The rendered wallpapers by key, and the keys from least to most recently
+-- used.
+local cache = { surfaces = {}, order = {}, bytes = 0, hits = 0, misses = 0 }
+
+local function cache_size(geom)
+    return cairo.Format.stride_for_width(cairo.Format.RGB24, geom.width) * geom.height
+end
+
+local function cache_touch(key)
+    for i, k in ipairs(cache.order) do
+        if k == key then
+            table.remove(cache.order, i)
+            break
+        end
+    end
+    table.insert(cache.order, key)
+end
+
+-- The updates that were sent to root.wallpaper() and may not be uploaded yet,
+-- oldest first. Their cache entry, if any, is in flight until then: the worker
+-- may still be painting its image, so it must not be read.
+local sent = {}
+
+local function update_sent()
+    -- Updates are uploaded in order. Others might have queued updates as well,
+    -- so this may keep entries in flight for longer than needed, but never
+    -- for too short.
+    for _ = 1, #sent - root._wallpaper_queued() do
+        local entry = table.remove(sent, 1)
+        if entry then
+            entry.in_flight = nil
+        end
+    end
+end
+
+local function send(pattern, geom, target, entry)
+    if root.wallpaper(pattern._native, geom, target and target._native) then
+        table.insert(sent, entry or false)
+    end
+end
+
+local function cache_get(key)
+    update_sent()
+    local entry = key and cache.surfaces[key]
+    if entry and not entry.in_flight then
+        cache.hits = cache.hits + 1
+        cache_touch(key)
+    elseif key then
+        cache.misses = cache.misses + 1
+    end
+    return entry and entry.surface
+end
+
+local function cache_put(key, surf, geom)
+    if cache.surfaces[key] then
+        cache.bytes = cache.bytes - cache.surfaces[key].bytes
+    end
+    local entry = { surface = surf, bytes = cache_size(geom), in_flight = true }
+    cache.surfaces[key] = entry
+    cache.bytes = cache.bytes + entry.bytes
+    cache_touch(key)
+
+    while cache.bytes > wallpaper.cache_limit and #cache.order > 1 do
+        local old = table.remove(cache.order, 1)
+        cache.bytes = cache.bytes - cache.surfaces[old].bytes
+        cache.surfaces[old] = nil
+    end
+    return entry
+end
+
+-- Build the cache key for a wallpaper. Only file names and plain arguments are
+-- cacheable, for anything else nil is returned. Surfaces can be drawn to after
+-- they were used, so they are never cached. Files are identified by their
+-- modification time and size, so that a file that was rewritten is rendered
+-- again.
+local function cache_key(mode, surf, geom, ...)
+    if type(surf) ~= "string" then
+        return nil
+    end
+
+    local info = Gio.File.new_for_path(surf):query_info(
+        "standard::size,time::modified,time::modified-usec", Gio.FileQueryInfoFlags.NONE)
+    if not info then
+        return nil
+    end
+    surf = table.concat({ surf, info:get_size(),
+        info:get_attribute_uint64("time::modified"),
+        info:get_attribute_uint32("time::modified-usec") }, "\0")
+
+    local key = { mode, surf, geom.x, geom.y, geom.width, geom.height }
+    for i = 1, select("#", ...) do
+        local arg = select(i, ...)
+        if type(arg) == "table" and type(arg.x) == "number" and type(arg.y) == "number" then
+            arg = arg.x .. "," .. arg.y
+        elseif arg ~= nil and type(arg) ~= "string" and type(arg) ~= "number"
+                and type(arg) ~= "boolean" then
+            return nil
+        end
+        table.insert(key, tostring(arg))
+    end
+    return table.concat(key, "\0")
+end
+
+local function same_geometry(a, b)
+    return a.x == b.x and a.y == b.y and a.width == b.width and a.height == b.height
+end
 
 local function get_screen(s)
     return s and screen[s]
 end
 
+local function flush_pending()
+    local changes = pending
+    pending = {}
+    for _, change in ipairs(changes) do
+        local target, pattern, entry = change.surface, nil, nil
+        if target then
+            pattern = cairo.Pattern.create_for_surface(target)
+        else
+            target = cairo.ImageSurface(cairo.Format.RGB24, change.geom.width, change.geom.height)
+            pattern = cairo.Pattern.create_for_surface(change.recording)
+            if change.key then
+                entry = cache_put(change.key, target, change.geom)
+            end
+        end
+        send(pattern, change.geom, target, entry)
+    end
+end
+
+-- Queue a change of the given area. Changes are sent from a delayed call, so
+-- that several drawing operations on the same area are sent together.
+local function queue_change(change)
+    if #pending == 0 then
+        timer.delayed_call(flush_pending)
+    end
+    table.insert(pending, change)
+    return change
+end
+
+-- Queue a change that replaces everything in the area with the given mode.
+-- Earlier changes to the same area are dropped. If the result is cached, no
+-- cairo context is returned and there is nothing left to draw.
+local function replace_area(s, mode, surf, ...)
+    s = get_screen(s)
+    local geom = s and s.geometry or root_geometry()
+    local key = cache_key(mode, surf, geom, ...)
+
+    for i = #pending, 1, -1 do
+        if same_geometry(pending[i].geom, geom) then
+            table.remove(pending, i)
+        end
+    end
+
+    local cached = cache_get(key)
+    if cached then
+        queue_change { geom = geom, surface = cached }
+        return geom, nil
+    end
+
+    local change = queue_change {
+        geom = geom,
+        key = key,
+        recording = cairo.RecordingSurface(cairo.Content.COLOR,
+            cairo.Rectangle { x = 0, y = 0, width = geom.width, height = geom.height })
+    }
+    return geom, cairo.Context(change.recording)
+end
+
+-- Paint what the area shows once the pending changes are applied, so that new
+-- drawing ends up on top of the current wallpaper. root.wallpaper() does not
+-- wait for the updates that were already sent, so only the ones that were not
+-- sent yet are layered here.
+local function paint_current(cr, geom)
+    cr:save()
+    cr.operator = cairo.Operator.SOURCE
+
+    local current = surface.load_silently(root.wallpaper(), false)
+    if current then
+        -- Recordings are replayed off the main loop, where the X11 surface can
+        -- not be used. Copy the area now.
+        local copy = cairo.ImageSurface(cairo.Format.RGB24, geom.width, geom.height)
+        local copy_cr = cairo.Context(copy)
+        copy_cr.operator = cairo.Operator.SOURCE
+        copy_cr:set_source_surface(current, -geom.x, -geom.y)
+        copy_cr:paint()
+        cr:set_source_surface(copy, 0, 0)
+        cr:paint()
+    end
+
+    -- Cached images are only handed out once the worker is done with them,
+    -- see cache_get()
+    for _, change in ipairs(pending) do
+        local x, y = change.geom.x - geom.x, change.geom.y - geom.y
+        cr:set_source_surface(change.surface or change.recording, x, y)
+        cr:rectangle(x, y, change.geom.width, change.geom.height)
+        cr:fill()
+    end
+
+    cr:restore()
+end
+
 --- Prepare the needed state for setting a wallpaper.
 -- This function returns a cairo context through which a wallpaper can be drawn.
 -- The context is only valid for a short time and should not be saved in a
 -- global variable.
+--
+-- The context starts with the current wallpaper of the area, including changes
+-- that were not sent yet. Changes that are still being rendered are not
+-- included. The drawing is recorded and replayed on a worker
+-- thread, so only image surfaces should be used as sources and they must not
+-- be changed afterwards.
 -- @param s The screen to set the wallpaper on or nil for all screens
 -- @return[1] The available geometry (table with entries width and height)
 -- @return[1] A cairo context that the wallpaper should be drawn to.
 -- @staticfct gears.wallpaper.prepare_context
 function wallpaper.prepare_context(s)
     s = get_screen(s)
-
-    local root_width, root_height = root.size()
     local geom = s and s.geometry or root_geometry()
-    local source, target, cr
-
-    if not pending_wallpaper then
-        -- Prepare a pending wallpaper
-        source = surface(root.wallpaper())
-        target = source:create_similar(cairo.Content.COLOR, root_width, root_height)
-
-        -- Set the wallpaper (delayed)
-        timer.delayed_call(function()
-            local paper = pending_wallpaper
-            pending_wallpaper = nil
-            wallpaper.set(paper.surface)
-            paper.surface:finish()
-        end)
-    elseif root_width > pending_wallpaper.width or root_height > pending_wallpaper.height then
-        -- The root window was resized while a wallpaper is pending
-        source = pending_wallpaper.surface
-        target = source:create_similar(cairo.Content.COLOR, root_width, root_height)
-    else
-        -- Draw to the already-pending wallpaper
-        source = nil
-        target = pending_wallpaper.surface
-    end
-
-    cr = cairo.Context(target)
-
-    if source then
-        -- Copy the old wallpaper to the new one
-        cr:save()
-        cr.operator = cairo.Operator.SOURCE
-        cr:set_source_surface(source, 0, 0)
-        cr:paint()
-        cr:restore()
+    local last = pending[#pending]
+
+    if not last or not last.recording or not same_geometry(last.geom, geom) then
+        local recording = cairo.RecordingSurface(cairo.Content.COLOR,
+            cairo.Rectangle { x = 0, y = 0, width = geom.width, height = geom.height })
+        paint_current(cairo.Context(recording), geom)
+
+        -- A pending cached wallpaper of this area is part of the new change now
+        if last and same_geometry(last.geom, geom) then
+            table.remove(pending)
+        end
+        last = queue_change { geom = geom, recording = recording }
     end
+    -- Whatever gets drawn now is not described by the key anymore
+    last.key = nil
 
-    pending_wallpaper = {
-        surface = target,
-        width = root_width,
-        height = root_height
-    }
+    local cr = cairo.Context(last.recording)
 
     -- Only draw to the selected area
-    cr:translate(geom.x, geom.y)
     cr:rectangle(0, 0, geom.width, geom.height)
     cr:clip()
 
@@ -121,7 +307,21 @@ function wallpaper.set(pattern)
     if not cairo.Pattern:is_type_of(pattern) then
         error("wallpaper.set() called with an invalid argument")
     end
-    root.wallpaper(pattern._native)
+    send(pattern)
+end
+
+--- Get statistics about the cache of rendered wallpapers.
+-- @treturn table A table with the `entries`, `bytes`, `hits` and `misses`
+--   keys.
+-- @see cache_limit
+-- @staticfct gears.wallpaper.cache_info
+function wallpaper.cache_info()
+    return {
+        entries = #cache.order,
+        bytes = cache.bytes,
+        hits = cache.hits,
+        misses = cache.misses,
+    }
 end
 
 --- Set a centered wallpaper.
@@ -134,8 +334,10 @@ end
 -- @see gears.color
 -- @staticfct gears.wallpaper.centered
 function wallpaper.centered(surf, s, background, scale)
-    local geom, cr = wallpaper.prepare_context(s)
-    local original_surf = surf
+    local geom, cr = replace_area(s, "centered", surf, background, scale)
+    if not cr then
+        return
+    end
     surf = surface.load_uncached(surf)
     background = color(background)
 
@@ -159,9 +361,6 @@ function wallpaper.centered(surf, s, background, scale)
 
     cr:set_source_surface(surf, 0, 0)
     cr:paint()
-    if surf ~= original_surf then
-        surf:finish()
-    end
     if cr.status ~= "SUCCESS" then
         debug.print_warning("Cairo context entered error state: " .. cr.status)
     end
@@ -174,22 +373,21 @@ end
 -- @param offset This can be set to a table with entries x and y.
 -- @staticfct gears.wallpaper.tiled
 function wallpaper.tiled(surf, s, offset)
-    local _, cr = wallpaper.prepare_context(s)
+    local _, cr = replace_area(s, "tiled", surf, offset)
+    if not cr then
+        return
+    end
 
     if offset then
         cr:translate(offset.x, offset.y)
     end
 
-    local original_surf = surf
     surf = surface.load_uncached(surf)
     local pattern = cairo.Pattern.create_for_surface(surf)
     pattern.extend = cairo.Extend.REPEAT
     cr.source = pattern
     cr.operator = cairo.Operator.SOURCE
     cr:paint()
-    if surf ~= original_surf then
-        surf:finish()
-    end
     if cr.status ~= "SUCCESS" then
         debug.print_warning("Cairo context entered error state: " .. cr.status)
     end
@@ -204,8 +402,10 @@ end
 -- @param offset This can be set to a table with entries x and y.
 -- @staticfct gears.wallpaper.maximized
 function wallpaper.maximized(surf, s, ignore_aspect, offset)
-    local geom, cr = wallpaper.prepare_context(s)
-    local original_surf = surf
+    local geom, cr = replace_area(s, "maximized", surf, ignore_aspect, offset)
+    if not cr then
+        return
+    end
     surf = surface.load_uncached(surf)
     local w, h = surface.get_size(surf)
     local aspect_w = geom.width / w
@@ -228,9 +428,6 @@ function wallpaper.maximized(surf, s, ignore_aspect, offset)
     cr:set_source_surface(surf, 0, 0)
     cr.operator = cairo.Operator.SOURCE
     cr:paint()
-    if surf ~= original_surf then
-        surf:finish()
-    end
     if cr.status ~= "SUCCESS" then
         debug.print_warning("Cairo context entered error state: " .. cr.status)
     end
@@ -245,8 +442,10 @@ end
 -- @see gears.color
 -- @staticfct gears.wallpaper.fit
 function wallpaper.fit(surf, s, background)
-    local geom, cr = wallpaper.prepare_context(s)
-    local original_surf = surf
+    local geom, cr = replace_area(s, "fit", surf, background)
+    if not cr then
+        return
+    end
     surf = surface.load_uncached(surf)
     background = color(background)
 
@@ -267,9 +466,6 @@ function wallpaper.fit(surf, s, background)
     cr:scale(scale, scale)
     cr:set_source_surface(surf, 0, 0)
     cr:paint()
-    if surf ~= original_surf then
-        surf:finish()
-    end
     if cr.status ~= "SUCCESS" then
         debug.print_warning("Cairo context entered error state: " .. cr.status)
     end
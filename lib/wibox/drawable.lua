@@ -111,9 +111,13 @@ local function do_redraw(self)
     if self._dirty_area:is_empty() then
         return
     end
+    local clip_rects = {}
     for i = 0, self._dirty_area:num_rectangles() - 1 do
         local rect = self._dirty_area:get_rectangle(i)
         cr:rectangle(rect.x, rect.y, rect.width, rect.height)
+        clip_rects[i + 1] = {
+            x = rect.x, y = rect.y, width = rect.width, height = rect.height
+        }
     end
     self._dirty_area = cairo.Region.create()
     cr:clip()
@@ -161,7 +165,8 @@ local function do_redraw(self)
         self._widget_hierarchy:draw(context, cr)
     end
 
-    self.drawable:refresh()
+    -- Only copy what was actually redrawn to the screen
+    self.drawable:refresh(clip_rects)
 
     assert(cr.status == "SUCCESS", "Cairo context entered error state: " .. cr.status)
 end
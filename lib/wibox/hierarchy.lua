@@ -18,6 +18,9 @@ local hierarchy = {}
 
 local widgets_to_count = setmetatable({}, { __mode = "k" })
 
+-- How many widgets were laid out so far, for get_relayout_count()
+local relayout_count = 0
+
 --- Add a widget to the list of widgets for which hierarchies should count their
 -- occurrences. Note that for correct operations, the widget must not yet be
 -- visible in any hierarchy.
@@ -56,9 +59,12 @@ local function hierarchy_new(redraw_callback, layout_callback, callback_arg)
         redraw_callback(result, callback_arg)
     end
     function result._layout()
-        local h = result
-        while h do
-            h._need_update = true
+        -- Our parents only need a new layout if we now fit differently, which
+        -- is decided in settle(). Until then, just mark the path to us.
+        result._need_update = true
+        local h = result._parent
+        while h and not h._child_dirty do
+            h._child_dirty = true
             h = h._parent
         end
         layout_callback(result, callback_arg)
@@ -82,6 +88,67 @@ local function hierarchy_new(redraw_callback, layout_callback, callback_arg)
     return result
 end
 
+-- Find the hierarchies below self that need a new layout. A hierarchy whose
+-- widget emitted widget::layout_changed needs one and so does its parent, but
+-- only if the widget's size changed. Returns whether self's size changed.
+-- `changed` remembers the answer for widgets that appear more than once.
+local settle
+function settle(self, changed)
+    local relayout = self._need_update
+    if self._child_dirty then
+        for _, child in ipairs(self._children) do
+            if (child._need_update or child._child_dirty) and settle(child, changed) then
+                relayout = true
+            end
+        end
+    end
+    local widget = self._widget
+    if not relayout then
+        -- Only our caches were cleared, we still fit like before
+        if widget then
+            base.keep_fits(widget, self._context)
+        end
+        return false
+    end
+    self._need_update = true
+    if not widget then
+        return true
+    end
+    if changed[widget] == nil then
+        changed[widget] = base.fits_changed(widget, self._context)
+    end
+    return changed[widget]
+end
+
+local function update_draw_extents(self)
+    local x1, y1, x2, y2 = 0, 0, self._size.width, self._size.height
+    for _, h in ipairs(self._children) do
+        local px, py, pwidth, pheight = matrix.transform_rectangle(h._matrix, h:get_draw_extents())
+        x1 = math.min(x1, px)
+        y1 = math.min(y1, py)
+        x2 = math.max(x2, px + pwidth)
+        y2 = math.max(y2, py + pheight)
+    end
+    self._draw_extents = {
+        x = x1, y = y1,
+        width = x2 - x1,
+        height = y2 - y1
+    }
+end
+
+local function update_widget_counts(self)
+    local widget = self._widget
+    self._widget_counts = {}
+    if widgets_to_count[widget] and self._size.width > 0 and self._size.height > 0 then
+        self._widget_counts[widget] = 1
+    end
+    for _, h in ipairs(self._children) do
+        for w, count in pairs(h._widget_counts) do
+            self._widget_counts[w] = (self._widget_counts[w] or 0) + count
+        end
+    end
+end
+
 local hierarchy_update
 function hierarchy_update(self, context, widget, width, height, region, matrix_to_parent, matrix_to_device)
     if (not self._need_update) and self._widget == widget and
@@ -89,11 +156,22 @@ function hierarchy_update(self, context, widget, width, height, region, matrix_t
             self._size.width == width and self._size.height == height and
             matrix.equals(self._matrix, matrix_to_parent) and
             matrix.equals(self._matrix_to_device, matrix_to_device) then
-        -- Nothing changed
+        -- Nothing changed, but maybe something below us
+        if self._child_dirty then
+            self._child_dirty = false
+            for _, h in ipairs(self._children) do
+                hierarchy_update(h, context, h._widget, h._size.width, h._size.height,
+                    region, h._matrix, h._matrix_to_device)
+            end
+            update_draw_extents(self)
+            update_widget_counts(self)
+        end
         return
     end
 
+    relayout_count = relayout_count + 1
     self._need_update = false
+    self._child_dirty = false
 
     local old_x, old_y, old_width, old_height
     local old_widget = self._widget
@@ -141,31 +219,8 @@ function hierarchy_update(self, context, widget, width, height, region, matrix_t
         table.insert(self._children, r)
     end
 
-    -- Calculate the draw extents
-    local x1, y1, x2, y2 = 0, 0, width, height
-    for _, h in ipairs(self._children) do
-        local px, py, pwidth, pheight = matrix.transform_rectangle(h._matrix, h:get_draw_extents())
-        x1 = math.min(x1, px)
-        y1 = math.min(y1, py)
-        x2 = math.max(x2, px + pwidth)
-        y2 = math.max(y2, py + pheight)
-    end
-    self._draw_extents = {
-        x = x1, y = y1,
-        width = x2 - x1,
-        height = y2 - y1
-    }
-
-    -- Update widget counts
-    self._widget_counts = {}
-    if widgets_to_count[widget] and width > 0 and height > 0 then
-        self._widget_counts[widget] = 1
-    end
-    for _, h in ipairs(self._children) do
-        for w, count in pairs(h._widget_counts) do
-            self._widget_counts[w] = (self._widget_counts[w] or 0) + count
-        end
-    end
+    update_draw_extents(self)
+    update_widget_counts(self)
 
     -- Check which part needs to be redrawn
 
@@ -221,11 +276,25 @@ end
 --   argument or a new, internally created region).
 -- @method update
 function hierarchy:update(context, widget, width, height, region)
+    local count = relayout_count
     region = region or cairo.Region.create()
+    settle(self, {})
     hierarchy_update(self, context, widget, width, height, region, self._matrix, self._matrix_to_device)
+    self._relayout_count = relayout_count - count
     return region
 end
 
+--- Get the number of widgets that the last `update` laid out.
+--
+-- A widget that emitted `widget::layout_changed` is laid out again, as are
+-- its parents up to the first one whose size did not change and everything
+-- that moved or was resized as a result.
+-- @treturn integer The number of widgets.
+-- @method get_relayout_count
+function hierarchy:get_relayout_count()
+    return self._relayout_count
+end
+
 --- Get the widget that this hierarchy manages.
 -- @method get_widget
 function hierarchy:get_widget()
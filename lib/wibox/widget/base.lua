@@ -15,6 +15,7 @@ local setmetatable = setmetatable
 local pairs = pairs
 local type = type
 local table = table
+local unpack = unpack or table.unpack -- luacheck: globals unpack (compatibility with Lua 5.1)
 
 local base = {}
 
@@ -448,13 +449,17 @@ end
 -- Indexes are widgets, allow them to be garbage-collected.
 local widget_dependencies = setmetatable({}, { __mode = "kv" })
 
+-- How many results of each kind are cached per widget. The caches are bounded
+-- instead of weak, so that they survive garbage collections.
+local widget_cache_size = 32
+
 -- Get the cache of the given kind for this widget. This returns a gears.cache
 -- that calls the callback of kind `kind` on the widget.
 local function get_cache(widget, kind)
     if not widget._private.widget_caches[kind] then
         widget._private.widget_caches[kind] = cache.new(function(...)
             return protected_call(widget[kind], widget, ...)
-        end)
+        end, widget_cache_size)
     end
     return widget._private.widget_caches[kind]
 end
@@ -480,12 +485,106 @@ local function record_dependency(parent, child)
     widget_dependencies[child] = deps
 end
 
+-- How many different fit results of a widget are remembered per context for
+-- base.fits_changed(). Widgets that are fit in more ways always count as
+-- changed.
+local max_fit_log = 16
+
+-- Fits without a context are logged under this key.
+local no_context = {}
+
+-- Get the fit results of `widget` in `context` from one of its logs. The logs
+-- are kept per context, because every drawable that shows a widget checks on
+-- its own whether the widget's size changed.
+local function get_fits(widget, which, context, create)
+    local log = widget._private[which]
+    if not log then
+        if not create then
+            return nil
+        end
+        log = setmetatable({}, { __mode = "k" })
+        widget._private[which] = log
+    end
+    if context == nil then
+        context = no_context
+    end
+    local fits = log[context]
+    if not fits and create then
+        fits = {}
+        log[context] = fits
+    end
+    return fits
+end
+
+local function has_fit(fits, width, height)
+    for _, entry in ipairs(fits) do
+        if entry[1] == width and entry[2] == height then
+            return true
+        end
+    end
+    return false
+end
+
+-- Remember the result of base.fit_widget() until the caches are cleared.
+local function log_fit(widget, context, width, height, w, h)
+    local fits = get_fits(widget, "fit_log", context, true)
+    if has_fit(fits, width, height) then
+        return
+    end
+    if #fits < max_fit_log then
+        table.insert(fits, { width, height, w, h })
+    else
+        fits.overflow = true
+    end
+end
+
+-- Keep the fit results from before a cache clear for base.fits_changed(). If
+-- the widget changes again before anyone checked, the older results win.
+local function stash_fits(widget)
+    local log = widget._private.fit_log
+    if not log then
+        return
+    end
+    widget._private.fit_log = nil
+
+    for context, fits in pairs(log) do
+        local stale = get_fits(widget, "stale_fits", context, true)
+        for _, entry in ipairs(fits) do
+            if not has_fit(stale, entry[1], entry[2]) then
+                if #stale >= max_fit_log then
+                    stale.overflow = true
+                    break
+                end
+                table.insert(stale, entry)
+            end
+        end
+        stale.overflow = stale.overflow or fits.overflow
+    end
+end
+
+-- Remove and return the fit results from before the last cache clear in
+-- `context`.
+local function take_stale_fits(widget, context)
+    local stale = get_fits(widget, "stale_fits", context, false)
+    if stale then
+        widget._private.stale_fits[context == nil and no_context or context] = nil
+    end
+    return stale
+end
+
 -- Clear the caches for `widget` and all widgets that depend on it.
 local clear_caches
 function clear_caches(widget)
     local deps = widget_dependencies[widget] or {}
     widget_dependencies[widget] = {}
-    widget._private.widget_caches = {}
+    if widget._private.widget_caches then
+        for _, c in pairs(widget._private.widget_caches) do
+            c:clear()
+        end
+    else
+        widget._private.widget_caches = {}
+    end
+    stash_fits(widget)
     for w in pairs(deps) do
         clear_caches(w)
     end
@@ -518,14 +617,15 @@ end
 function base.fit_widget(parent, context, widget, width, height)
     record_dependency(parent, widget)
 
-    if not widget._private.visible then
-        return 0, 0
-    end
-
     -- Sanitize the input. This also filters out e.g. NaN.
     width = math.max(0, width)
     height = math.max(0, height)
 
+    if not widget._private.visible then
+        log_fit(widget, context, width, height, 0, 0)
+        return 0, 0
+    end
+
     local w, h = 0, 0
     if widget.fit then
         w, h = get_cache(widget, "fit"):get(context, width, height)
@@ -546,9 +646,62 @@ function base.fit_widget(parent, context, widget, width, height)
     -- Also sanitize the output.
     w = math.max(0, math.min(w, width))
     h = math.max(0, math.min(h, height))
+    log_fit(widget, context, width, height, w, h)
     return w, h
 end
 
+--- Check whether a widget now fits differently than before its last
+-- `widget::layout_changed`.
+--
+-- All sizes that `fit_widget` returned for the widget in the given context
+-- before that are computed again. If they are all the same, the layout of the
+-- widget's parents in this context does not change. Each change is only
+-- reported once per context.
+-- @tparam widget widget The widget to check.
+-- @tparam table context The context in which the widget was fit.
+-- @treturn boolean Whether any size changed.
+-- @staticfct wibox.widget.base.fits_changed
+function base.fits_changed(widget, context)
+    local stale = take_stale_fits(widget, context)
+    if not stale then
+        return false
+    end
+    if stale.overflow then
+        return true
+    end
+
+    for _, entry in ipairs(stale) do
+        local w, h = base.fit_widget(base.no_parent_I_know_what_I_am_doing,
+            context, widget, entry[1], entry[2])
+        if w ~= entry[3] or h ~= entry[4] then
+            return true
+        end
+    end
+    return false
+end
+
+--- Keep the sizes a widget had in a context before its last
+-- `widget::layout_changed` without computing them again.
+--
+-- This is for widgets whose caches were only cleared because a child changed,
+-- when `fits_changed` returned false for all of these children.
+-- @tparam widget widget The widget.
+-- @tparam table context The context in which the widget was fit.
+-- @staticfct wibox.widget.base.keep_fits
+function base.keep_fits(widget, context)
+    local stale = take_stale_fits(widget, context)
+    if not stale then
+        return
+    end
+
+    for _, entry in ipairs(stale) do
+        log_fit(widget, context, unpack(entry))
+    end
+    if stale.overflow then
+        get_fits(widget, "fit_log", context, true).overflow = true
+    end
+end
+
 --- Lay out a widget for the given available width and height.
 --
 -- This calls the widget's `:layout` callback and caches the result for later
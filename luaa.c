@@ -39,6 +39,58 @@
  * @staticfct register_xproperty
  */
 
+/** Enable or disable signal dispatch profiling.
+ *
+ * While it is enabled, the number of emissions, the number of handlers called
+ * and the time spent in them are recorded for each signal of each class.
+ *
+ * @tparam boolean enabled
+ * @staticfct profiler.signals
+ */
+
+/** Forget the signal dispatch statistics collected so far.
+ * @staticfct profiler.reset_signals
+ */
+
+/** Get the signal dispatch statistics.
+ *
+ * @treturn table A list sorted by decreasing time, with one entry per signal
+ *  and class. Each entry has the keys `class` (nil for global signals),
+ *  `name`, `count` (number of emissions), `handlers` (number of handlers
+ *  called), `time` and `max_time` (in seconds, including nested emissions).
+ * @staticfct profiler.signal_stats
+ */
+
+/** Get statistics about the main loop.
+ *
+ * Timings are in seconds. Each entry of `phases` and the `requests` entry are
+ * tables with the `min`, `avg`, `p99` and `max` of the most recent `samples`
+ * main loop iterations.
+ *
+ * The `x11` entry describes the connection to the X11 server: the number of
+ * `requests` sent while they are counted, how often awesome waited for the server (`waits`) and for
+ * how long (`wait_time`), the same per iteration (`waits_per_iteration`,
+ * `wait_time_per_iteration`) and a list of the places in the code that waited
+ * (`sites`), sorted by decreasing `time`. Each site has the keys `func`,
+ * `file`, `line`, `waits`, `time` and `max_waits_per_iteration`.
+ *
+ * @treturn table A table with the keys `iterations`, `wakeups`,
+ *  `wakeups_per_second`, `phases` (indexed by phase name), `requests` (X11
+ *  requests sent per iteration while they are counted), `events` (events
+ *  handled, indexed by event name) and `x11`.
+ * @staticfct stats
+ * @see stats_count_requests
+ */
+
+/** Enable or disable counting the X11 requests sent per main loop iteration.
+ *
+ * Counting needs an extra request per iteration, so it is disabled by default.
+ *
+ * @tparam boolean enable Whether requests should be counted.
+ * @staticfct stats_count_requests
+ * @see stats
+ */
+
 #define _GNU_SOURCE
 
 #include "luaa.h"
@@ -58,6 +110,7 @@
 #include "objects/selection_watcher.h"
 #include "objects/tag.h"
 #include "property.h"
+#include "stats.h"
 #include "selection.h"
 #include "spawn.h"
 #include "systray.h"
@@ -69,9 +122,13 @@
 #include <lualib.h>
 
 /* for strings and Unicode handling */
+#include <errno.h>
 #include <glib.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
 
 #include <basedir_fs.h>
 
@@ -85,6 +142,7 @@
 extern const struct luaL_Reg awesome_dbus_lib[];
 #endif
 extern const struct luaL_Reg awesome_keygrabber_lib[];
+extern const struct luaL_Reg awesome_layout_lib[];
 extern const struct luaL_Reg awesome_mousegrabber_lib[];
 extern const struct luaL_Reg awesome_mouse_methods[];
 extern const struct luaL_Reg awesome_mouse_meta[];
@@ -206,18 +264,18 @@ composite_manager_running(void)
         return false;
     }
 
-    atom_r = xcb_intern_atom_reply(globalconf.connection,
+    atom_r = A_XCB_WAIT(xcb_intern_atom_reply(globalconf.connection,
                                    xcb_intern_atom_unchecked(globalconf.connection, false,
                                                              a_strlen(atom_name), atom_name),
-                                   NULL);
+                                   NULL));
     p_delete(&atom_name);
     if(!atom_r)
         return false;
 
-    selection_r = xcb_get_selection_owner_reply(globalconf.connection,
+    selection_r = A_XCB_WAIT(xcb_get_selection_owner_reply(globalconf.connection,
                                                 xcb_get_selection_owner_unchecked(globalconf.connection,
                                                                                   atom_r->atom),
-                                                NULL);
+                                                NULL));
     p_delete(&atom_r);
 
     result = selection_r != NULL && selection_r->owner != XCB_NONE;
@@ -294,10 +352,220 @@ luaA_kill(lua_State *L)
 static int
 luaA_sync(lua_State *L)
 {
-    xcb_aux_sync(globalconf.connection);
+    A_XCB_SYNC(globalconf.connection);
+    return 0;
+}
+
+/** Maximum number of Lua frames recorded per profiler sample */
+#define PROFILER_MAX_DEPTH 64
+
+/* The profiler needs a timer that signals the main thread only */
+#if defined(SIGEV_THREAD_ID) && defined(SYS_gettid)
+#define PROFILER_SUPPORTED
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#endif
+
+static struct
+{
+    bool running;
+    /** Number of samples per folded stack */
+    GHashTable *stacks;
+    /** The SIGPROF handler to restore when stopping */
+    struct sigaction old_action;
+#ifdef PROFILER_SUPPORTED
+    /** Fires on the CPU time of the main thread and only signals it */
+    timer_t timer;
+#endif
+    /** The debug hook that was installed before, e.g. by luacov */
+    lua_Hook old_hook;
+    int old_hook_mask;
+    int old_hook_count;
+} profiler;
+
+/** Record the current Lua stack. This hook is only installed for the next
+ * instruction after SIGPROF was received.
+ */
+static void
+luaA_profiler_hook(lua_State *L, lua_Debug *ar)
+{
+    lua_Debug frame;
+    buffer_t buf;
+    int depth = 0;
+
+    lua_sethook(L, profiler.old_hook, profiler.old_hook_mask, profiler.old_hook_count);
+    if(!profiler.running)
+        return;
+
+    while(depth < PROFILER_MAX_DEPTH && lua_getstack(L, depth, &frame))
+        depth++;
+
+    buffer_init(&buf);
+    for(int i = 0; i < MIN(lualib_context.len, countof(lualib_context.frames)); i++)
+        buffer_addf(&buf, "%s:%s;", lualib_context.frames[i].kind,
+                    lualib_context.frames[i].name);
+    /* Folded stacks start with the outermost frame */
+    for(int level = depth - 1; level >= 0; level--)
+    {
+        lua_getstack(L, level, &frame);
+        lua_getinfo(L, "Sn", &frame);
+        if(*frame.what == 'C')
+            buffer_addf(&buf, "%s [C];", frame.name ? frame.name : "?");
+        else
+            buffer_addf(&buf, "%s (%s:%d);", frame.name ? frame.name : "?",
+                        frame.short_src, frame.linedefined);
+    }
+    if(buf.len == 0)
+        buffer_addsl(&buf, "[unknown];");
+    /* Remove the last ';' */
+    buf.s[--buf.len] = '\0';
+
+    char *stack = buffer_detach(&buf);
+    guint count = GPOINTER_TO_UINT(g_hash_table_lookup(profiler.stacks, stack));
+    /* This frees stack if it is already in the table */
+    g_hash_table_insert(profiler.stacks, stack, GUINT_TO_POINTER(count + 1));
+}
+
+static void
+luaA_profiler_signal(int signum)
+{
+    /* Everything else has to wait until Lua is in a consistent state.
+     * lua_sethook() is safe to call from a signal handler. */
+    lua_sethook(globalconf_get_lua_State(), luaA_profiler_hook, LUA_MASKCOUNT, 1);
+}
+
+/** Start the Lua sampling profiler.
+ *
+ * The profiler samples the Lua stack while the main thread of awesome uses the
+ * CPU and adds the signal emissions and X11 events that are being handled.
+ * Time spent in other threads, e.g. rendering wallpapers, is not sampled. It
+ * has no overhead while it is not running. Use `awesome.profiler.stop` to get
+ * the result. It is only available on Linux.
+ *
+ * Samples are only taken from the main Lua thread, time spent in coroutines
+ * is attributed to the code resuming them.
+ *
+ * @tparam[opt] table args
+ * @tparam[opt=100] number args.hz How many samples to take per second of CPU
+ *  time.
+ * @staticfct profiler.start
+ */
+static int
+luaA_profiler_start(lua_State *L)
+{
+    double hz = 100;
+
+    if(!lua_isnoneornil(L, 1))
+    {
+        luaA_checktable(L, 1);
+        hz = luaA_getopt_number(L, 1, "hz", hz);
+    }
+    if(hz < 1 || hz > 10000)
+        return luaL_error(L, "profiler frequency must be between 1 and 10000 Hz");
+    if(profiler.running)
+        return luaL_error(L, "profiler is already running");
+
+#ifdef PROFILER_SUPPORTED
+    /* ITIMER_PROF would signal any thread and count the CPU time of all of
+     * them. Lua is only run from the main thread, which calls this. */
+    struct sigevent sev = {
+        .sigev_notify = SIGEV_THREAD_ID,
+        .sigev_signo = SIGPROF,
+    };
+    sev.sigev_notify_thread_id = syscall(SYS_gettid);
+    if(timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &profiler.timer) != 0)
+        return luaL_error(L, "cannot create profiler timer: %s", strerror(errno));
+#else
+    return luaL_error(L, "profiler is not supported on this platform");
+#endif
+
+    if(!profiler.stacks)
+        profiler.stacks = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+
+    /* Each sample replaces the current hook for one instruction */
+    lua_State *main_L = globalconf_get_lua_State();
+    profiler.old_hook = lua_gethook(main_L);
+    profiler.old_hook_mask = lua_gethookmask(main_L);
+    profiler.old_hook_count = lua_gethookcount(main_L);
+
+    struct sigaction sa = { .sa_handler = luaA_profiler_signal, .sa_flags = SA_RESTART };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, &profiler.old_action);
+
+    long nsec = MAX(1e9 / hz, 1);
+    struct itimerspec timer;
+    timer.it_interval.tv_sec = nsec / 1000000000;
+    timer.it_interval.tv_nsec = nsec % 1000000000;
+    timer.it_value = timer.it_interval;
+
+    profiler.running = true;
+    lualib_context.len = 0;
+    lualib_context.enabled = true;
+#ifdef PROFILER_SUPPORTED
+    timer_settime(profiler.timer, 0, &timer, NULL);
+#endif
+
     return 0;
 }
 
+/** Stop the Lua sampling profiler.
+ *
+ * The result uses the folded stack format that flame graph tools read: one
+ * line per distinct stack, with the frames separated by `;`, followed by a
+ * space and the number of samples.
+ *
+ * @tparam[opt] string path A file to write the folded stacks to.
+ * @treturn string The folded stacks.
+ * @staticfct profiler.stop
+ */
+static int
+luaA_profiler_stop(lua_State *L)
+{
+    const char *path = luaL_optstring(L, 1, NULL);
+    GHashTableIter iter;
+    gpointer stack, count;
+    buffer_t buf;
+
+    if(!profiler.running)
+        return luaL_error(L, "profiler is not running");
+
+#ifdef PROFILER_SUPPORTED
+    timer_delete(profiler.timer);
+#endif
+    sigaction(SIGPROF, &profiler.old_action, NULL);
+    /* A sample might still be pending */
+    lua_State *main_L = globalconf_get_lua_State();
+    if(lua_gethook(main_L) == luaA_profiler_hook)
+        lua_sethook(main_L, profiler.old_hook, profiler.old_hook_mask, profiler.old_hook_count);
+    profiler.running = false;
+    lualib_context.enabled = false;
+
+    buffer_init(&buf);
+    g_hash_table_iter_init(&iter, profiler.stacks);
+    while(g_hash_table_iter_next(&iter, &stack, &count))
+        buffer_addf(&buf, "%s %u\n", (char *) stack, GPOINTER_TO_UINT(count));
+    g_hash_table_remove_all(profiler.stacks);
+
+    if(path)
+    {
+        FILE *file = fopen(path, "w");
+        if(!file || fwrite(buf.s, 1, buf.len, file) != (size_t) buf.len)
+        {
+            int err = errno;
+            if(file)
+                fclose(file);
+            buffer_wipe(&buf);
+            return luaL_error(L, "cannot write profile to %s: %s", path, strerror(err));
+        }
+        fclose(file);
+    }
+
+    lua_pushlstring(L, buf.s, buf.len);
+    buffer_wipe(&buf);
+    return 1;
+}
+
 /** Translate a GdkPixbuf to a cairo image surface..
  *
  * @param pixbuf The pixbuf as a light user datum.
@@ -561,8 +829,8 @@ luaA_get_key_name(lua_State *L)
  */
 static int luaA_get_modifiers(lua_State *L)
 {
-    xcb_get_modifier_mapping_reply_t *mods = xcb_get_modifier_mapping_reply(globalconf.connection,
-            xcb_get_modifier_mapping(globalconf.connection), NULL);
+    xcb_get_modifier_mapping_reply_t *mods = A_XCB_WAIT(xcb_get_modifier_mapping_reply(globalconf.connection,
+            xcb_get_modifier_mapping(globalconf.connection), NULL));
     if (!mods)
         return 0;
 
@@ -764,6 +1032,34 @@ luaA_awesome_index(lua_State *L)
         return 1;
     }
 
+    if(A_STREQ(buf, "_banning_stats"))
+    {
+        const banning_stats_t *stats = banning_get_stats();
+        lua_createtable(L, 0, 3);
+        lua_pushinteger(L, stats->checked);
+        lua_setfield(L, -2, "checked");
+        lua_pushinteger(L, stats->banned);
+        lua_setfield(L, -2, "banned");
+        lua_pushinteger(L, stats->unbanned);
+        lua_setfield(L, -2, "unbanned");
+        return 1;
+    }
+
+    if(A_STREQ(buf, "_dropped_events"))
+    {
+        const event_coalesce_stats_t *stats = event_get_coalesce_stats();
+        lua_createtable(L, 0, 4);
+        lua_pushinteger(L, stats->motion_notify);
+        lua_setfield(L, -2, "motion_notify");
+        lua_pushinteger(L, stats->property_notify);
+        lua_setfield(L, -2, "property_notify");
+        lua_pushinteger(L, stats->configure_request);
+        lua_setfield(L, -2, "configure_request");
+        lua_pushinteger(L, stats->expose);
+        lua_setfield(L, -2, "expose");
+        return 1;
+    }
+
     if(A_STREQ(buf, "startup_errors"))
     {
         if (globalconf.startup_errors.len == 0)
@@ -813,9 +1109,9 @@ luaA_awesome_index(lua_State *L)
 static int
 luaA_awesome_connect_signal(lua_State *L)
 {
-    const char *name = luaL_checkstring(L, 1);
+    unsigned long id = luaA_signal_id(L, 1);
     luaA_checkfunction(L, 2);
-    signal_connect(&global_signals, name, luaA_object_ref(L, 2));
+    signal_connect_id(&global_signals, id, lua_tostring(L, 1), luaA_object_ref(L, 2));
     return 0;
 }
 
@@ -828,10 +1124,10 @@ luaA_awesome_connect_signal(lua_State *L)
 static int
 luaA_awesome_disconnect_signal(lua_State *L)
 {
-    const char *name = luaL_checkstring(L, 1);
+    unsigned long id = luaA_signal_id(L, 1);
     luaA_checkfunction(L, 2);
     const void *func = lua_topointer(L, 2);
-    if (signal_disconnect(&global_signals, name, func))
+    if (signal_disconnect_id(&global_signals, id, func))
         luaA_object_unref(L, (void *) func);
     return 0;
 }
@@ -845,7 +1141,7 @@ luaA_awesome_disconnect_signal(lua_State *L)
 static int
 luaA_awesome_emit_signal(lua_State *L)
 {
-    signal_object_emit(L, &global_signals, luaL_checkstring(L, 1), lua_gettop(L) - 1);
+    signal_object_emit_id(L, &global_signals, luaA_signal_id(L, 1), lua_gettop(L) - 1);
     return 0;
 }
 
@@ -1080,6 +1376,16 @@ void
 luaA_init(xdgHandle* xdg, string_array_t *searchpath)
 {
     lua_State *L;
+    static const struct luaL_Reg awesome_profiler_lib[] =
+    {
+        { "start", luaA_profiler_start },
+        { "stop", luaA_profiler_stop },
+        { "signals", luaA_signal_profile_set_enabled },
+        { "reset_signals", luaA_signal_profile_reset },
+        { "signal_stats", luaA_signal_profile_stats },
+        { NULL, NULL }
+    };
+
     static const struct luaL_Reg awesome_lib[] =
     {
         { "quit", luaA_quit },
@@ -1104,6 +1410,8 @@ luaA_init(xdgHandle* xdg, string_array_t *searchpath)
         { "xrdb_get_value", luaA_xrdb_get_value},
         { "kill", luaA_kill},
         { "sync", luaA_sync},
+        { "stats", luaA_stats},
+        { "stats_count_requests", luaA_stats_count_requests },
         { "_get_key_name", luaA_get_key_name},
         { NULL, NULL }
     };
@@ -1126,6 +1434,20 @@ luaA_init(xdgHandle* xdg, string_array_t *searchpath)
     luaA_openlib(L, "awesome", awesome_lib, awesome_lib);
     setup_awesome_signals(L);
 
+    /* Export awesome.profiler, awesome's __newindex does not allow that */
+    lua_getglobal(L, "awesome");
+    lua_pushliteral(L, "profiler");
+    lua_newtable(L);
+    luaA_setfuncs(L, awesome_profiler_lib);
+    lua_rawset(L, -3);
+
+    /* Export the native layouts used by awful.layout.suit */
+    lua_pushliteral(L, "_layout");
+    lua_newtable(L);
+    luaA_setfuncs(L, awesome_layout_lib);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
     /* Export root lib */
     luaA_openlib(L, "root", awesome_root_methods, awesome_root_meta);
 
@@ -69,6 +69,7 @@
 #include "objects/client.h"
 #include "objects/drawin.h"
 #include "objects/screen.h"
+#include "stats.h"
 
 static int miss_index_handler    = LUA_REFNIL;
 static int miss_newindex_handler = LUA_REFNIL;
@@ -94,7 +95,7 @@ mouse_query_pointer(xcb_window_t window, int16_t *x, int16_t *y, xcb_window_t *c
     xcb_query_pointer_reply_t *query_ptr_r;
 
     query_ptr_c = xcb_query_pointer_unchecked(globalconf.connection, window);
-    query_ptr_r = xcb_query_pointer_reply(globalconf.connection, query_ptr_c, NULL);
+    query_ptr_r = A_XCB_WAIT(xcb_query_pointer_reply(globalconf.connection, query_ptr_c, NULL));
 
     if(!query_ptr_r || !query_ptr_r->same_screen)
     {
@@ -29,6 +29,7 @@
 #include "common/xcursor.h"
 #include "mouse.h"
 #include "globalconf.h"
+#include "stats.h"
 
 #include <unistd.h>
 #include <stdbool.h>
@@ -54,7 +55,7 @@ mousegrabber_grab(xcb_cursor_t cursor)
                                        XCB_GRAB_MODE_ASYNC,
                                        root, cursor, XCB_CURRENT_TIME);
 
-        if((grab_ptr_r = xcb_grab_pointer_reply(globalconf.connection, grab_ptr_c, NULL)))
+        if((grab_ptr_r = A_XCB_WAIT(xcb_grab_pointer_reply(globalconf.connection, grab_ptr_c, NULL))))
         {
             p_delete(&grab_ptr_r);
             return true;
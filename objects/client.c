@@ -100,9 +100,11 @@
 #include "property.h"
 #include "spawn.h"
 #include "systray.h"
+#include "thumbnail.h"
 #include "xwindow.h"
 
 #include "math.h"
+#include "stats.h"
 
 #include <xcb/xcb_atom.h>
 #include <xcb/shape.h>
@@ -150,6 +152,8 @@ lua_class_t client_class;
  * This is emitted before the `startup` signal and after the `scanning` signal.
  *
  * @signal scanned
+ * @tparam number scan_time The time in seconds it took to scan and manage the
+ *  existing windows.
  * @classsignal
  */
 
@@ -1379,6 +1383,7 @@ static area_t titlebar_get_area(client_t *c, client_titlebar_t bar);
 static drawable_t *titlebar_get_drawable(lua_State *L, client_t *c, int cl_idx, client_titlebar_t bar);
 static void client_resize_do(client_t *c, area_t geometry);
 static void client_set_maximized_common(lua_State *L, int cidx, bool s, const char* type, const int val);
+static void client_damage_refresh(void);
 
 /** Collect a client.
  * \param L The Lua VM state.
@@ -1388,8 +1393,12 @@ static void
 client_wipe(client_t *c)
 {
     key_array_wipe(&c->keys);
+    client_tag_array_wipe(&c->tags);
     xcb_icccm_get_wm_protocols_reply_wipe(&c->protocols);
-    cairo_surface_array_wipe(&c->icons);
+    draw_icon_array_wipe(&c->icons);
+    if(c->frame_damage)
+        cairo_region_destroy(c->frame_damage);
+    c->frame_damage = NULL;
     p_delete(&c->machine);
     p_delete(&c->class);
     p_delete(&c->instance);
@@ -1462,10 +1471,11 @@ DO_CLIENT_SET_STRING_PROPERTY(machine)
 #undef DO_CLIENT_SET_STRING_PROPERTY
 
 void
-client_emit_scanned(void)
+client_emit_scanned(double scan_time)
 {
     lua_State *L = globalconf_get_lua_State();
-    luaA_class_emit_signal(L, &client_class, "scanned", 0);
+    lua_pushnumber(L, scan_time);
+    luaA_class_emit_signal(L, &client_class, "scanned", 1);
 }
 
 void
@@ -1535,14 +1545,7 @@ client_set_class_instance(lua_State *L, int cidx, const char *class, const char
 bool
 client_on_selected_tags(client_t *c)
 {
-    if(c->sticky)
-        return true;
-
-    foreach(tag, globalconf.tags)
-        if(tag_get_selected(*tag) && is_client_tagged(c, *tag))
-            return true;
-
-    return false;
+    return c->sticky || c->selected_tags > 0;
 }
 
 /** Get a client by its window.
@@ -1552,21 +1555,17 @@ client_on_selected_tags(client_t *c)
 client_t *
 client_getbywin(xcb_window_t w)
 {
-    foreach(c, globalconf.clients)
-        if((*c)->window == w)
-            return *c;
-
-    return NULL;
+    return winmap_lookup(&globalconf.windows, w, WINMAP_CLIENT_WINDOW);
 }
 
+/** Get a client by its nofocus window.
+ * \param w The nofocus window to find.
+ * \return A client pointer if found, NULL otherwise.
+ */
 client_t *
 client_getbynofocuswin(xcb_window_t w)
 {
-    foreach(c, globalconf.clients)
-        if((*c)->nofocus_window == w)
-            return *c;
-
-    return NULL;
+    return winmap_lookup(&globalconf.windows, w, WINMAP_CLIENT_NOFOCUS);
 }
 
 /** Get a client by its frame window.
@@ -1576,11 +1575,7 @@ client_getbynofocuswin(xcb_window_t w)
 client_t *
 client_getbyframewin(xcb_window_t w)
 {
-    foreach(c, globalconf.clients)
-        if((*c)->frame_window == w)
-            return *c;
-
-    return NULL;
+    return winmap_lookup(&globalconf.windows, w, WINMAP_CLIENT_FRAME);
 }
 
 /** Unfocus a client (internal).
@@ -1642,6 +1637,9 @@ client_ban(client_t *c)
 {
     if(!c->isbanned)
     {
+        /* Its content can not be read while it is unmapped */
+        thumbnail_client_banned(c);
+
         client_ignore_enterleave_events();
         xcb_unmap_window(globalconf.connection, c->frame_window);
         client_restore_enterleave_events();
@@ -1748,6 +1746,7 @@ client_get_nofocus_window(client_t *c)
                           0, NULL);
         xcb_map_window(globalconf.connection, c->nofocus_window);
         xwindow_grabkeys(c->nofocus_window, &c->keys);
+        winmap_insert(&globalconf.windows, c->nofocus_window, WINMAP_CLIENT_NOFOCUS, c);
     }
     return c->nofocus_window;
 }
@@ -1877,6 +1876,7 @@ void
 client_refresh(void)
 {
     client_geometry_refresh();
+    client_damage_refresh();
     client_border_refresh();
     client_focus_refresh();
 }
@@ -1916,72 +1916,144 @@ border_width_callback(client_t *c, uint16_t old_width, uint16_t new_width)
 }
 
 static void
-client_update_properties(lua_State *L, int cidx, client_t *c)
+client_update_properties(lua_State *L, int cidx, client_t *c, client_manage_cookies_t *cookies)
 {
-    /* get all hints */
-    xcb_get_property_cookie_t wm_normal_hints   = property_get_wm_normal_hints(c);
-    xcb_get_property_cookie_t wm_hints          = property_get_wm_hints(c);
-    xcb_get_property_cookie_t wm_transient_for  = property_get_wm_transient_for(c);
-    xcb_get_property_cookie_t wm_client_leader  = property_get_wm_client_leader(c);
-    xcb_get_property_cookie_t wm_client_machine = property_get_wm_client_machine(c);
-    xcb_get_property_cookie_t wm_window_role    = property_get_wm_window_role(c);
-    xcb_get_property_cookie_t net_wm_pid        = property_get_net_wm_pid(c);
-    xcb_get_property_cookie_t net_wm_icon       = property_get_net_wm_icon(c);
-    xcb_get_property_cookie_t wm_name           = property_get_wm_name(c);
-    xcb_get_property_cookie_t net_wm_name       = property_get_net_wm_name(c);
-    xcb_get_property_cookie_t wm_icon_name      = property_get_wm_icon_name(c);
-    xcb_get_property_cookie_t net_wm_icon_name  = property_get_net_wm_icon_name(c);
-    xcb_get_property_cookie_t wm_class          = property_get_wm_class(c);
-    xcb_get_property_cookie_t wm_protocols      = property_get_wm_protocols(c);
-    xcb_get_property_cookie_t motif_wm_hints    = property_get_motif_wm_hints(c);
-    xcb_get_property_cookie_t opacity           = xwindow_get_opacity_unchecked(c->window);
-
     /* update strut */
-    ewmh_process_client_strut(c);
+    ewmh_process_client_strut(c, cookies->strut);
 
     /* Now process all replies */
-    property_update_wm_normal_hints(c, wm_normal_hints);
-    property_update_wm_hints(c, wm_hints);
-    property_update_wm_transient_for(c, wm_transient_for);
-    property_update_wm_client_leader(c, wm_client_leader);
-    property_update_wm_client_machine(c, wm_client_machine);
-    property_update_wm_window_role(c, wm_window_role);
-    property_update_net_wm_pid(c, net_wm_pid);
-    property_update_net_wm_icon(c, net_wm_icon);
-    property_update_wm_name(c, wm_name);
-    property_update_net_wm_name(c, net_wm_name);
-    property_update_wm_icon_name(c, wm_icon_name);
-    property_update_net_wm_icon_name(c, net_wm_icon_name);
-    property_update_wm_class(c, wm_class);
-    property_update_wm_protocols(c, wm_protocols);
-    property_update_motif_wm_hints(c, motif_wm_hints);
-    window_set_opacity(L, cidx, xwindow_get_opacity_from_cookie(opacity));
+    property_update_wm_normal_hints(c, cookies->wm_normal_hints);
+    property_update_wm_hints(c, cookies->wm_hints);
+    property_update_wm_transient_for(c, cookies->wm_transient_for);
+    property_update_wm_client_leader(c, cookies->wm_client_leader);
+    property_update_wm_client_machine(c, cookies->wm_client_machine);
+    property_update_wm_window_role(c, cookies->wm_window_role);
+    property_update_net_wm_pid(c, cookies->net_wm_pid);
+    property_update_net_wm_icon(c, cookies->net_wm_icon);
+    property_update_wm_name(c, cookies->wm_name);
+    property_update_net_wm_name(c, cookies->net_wm_name);
+    property_update_wm_icon_name(c, cookies->wm_icon_name);
+    property_update_net_wm_icon_name(c, cookies->net_wm_icon_name);
+    property_update_wm_class(c, cookies->wm_class);
+    property_update_wm_protocols(c, cookies->wm_protocols);
+    property_update_motif_wm_hints(c, cookies->motif_wm_hints);
+    window_set_opacity(L, cidx, xwindow_get_opacity_from_cookie(cookies->opacity));
+}
+
+/** Send all the requests whose replies client_manage() needs.
+ * This does not wait for anything, so it can be called for a batch of windows
+ * before managing any of them.
+ * \param w The window.
+ * \param cookies Where to store the cookies for client_manage().
+ */
+void
+client_manage_request(xcb_window_t w, client_manage_cookies_t *cookies)
+{
+    /* Make sure that property changes between now and the end of
+     * client_manage() are not lost. The full event mask is only selected
+     * after the window was reparented. */
+    xcb_change_window_attributes(globalconf.connection, w, XCB_CW_EVENT_MASK,
+                                 (const uint32_t []) { XCB_EVENT_MASK_PROPERTY_CHANGE });
+
+    cookies->kde_dockapp = systray_iskdedockapp_unchecked(w);
+
+    /* If this is a new client that just has been launched, then request its
+     * startup id. */
+    cookies->startup_id = xcb_get_property(globalconf.connection, false,
+                                           w, _NET_STARTUP_ID,
+                                           XCB_GET_PROPERTY_TYPE_ANY, 0, UINT_MAX);
+
+    /* get all hints */
+    cookies->wm_normal_hints   = property_get_wm_normal_hints(w);
+    cookies->wm_hints          = property_get_wm_hints(w);
+    cookies->wm_transient_for  = property_get_wm_transient_for(w);
+    cookies->wm_client_leader  = property_get_wm_client_leader(w);
+    cookies->wm_client_machine = property_get_wm_client_machine(w);
+    cookies->wm_window_role    = property_get_wm_window_role(w);
+    cookies->net_wm_pid        = property_get_net_wm_pid(w);
+    cookies->net_wm_icon       = property_get_net_wm_icon(w);
+    cookies->wm_name           = property_get_wm_name(w);
+    cookies->net_wm_name       = property_get_net_wm_name(w);
+    cookies->wm_icon_name      = property_get_wm_icon_name(w);
+    cookies->net_wm_icon_name  = property_get_net_wm_icon_name(w);
+    cookies->wm_class          = property_get_wm_class(w);
+    cookies->wm_protocols      = property_get_wm_protocols(w);
+    cookies->motif_wm_hints    = property_get_motif_wm_hints(w);
+    cookies->opacity           = xwindow_get_opacity_unchecked(w);
+    cookies->strut             = ewmh_client_strut_get_unchecked(w);
+    cookies->ewmh_hints        = ewmh_client_get_hints_unchecked(w);
+}
+
+/** Discard the replies of a client_manage_request() that will not be used.
+ * \param cookies The cookies from client_manage_request().
+ */
+static void
+client_manage_discard(client_manage_cookies_t *cookies)
+{
+    xcb_get_property_cookie_t *all[] =
+    {
+        &cookies->startup_id, &cookies->wm_normal_hints, &cookies->wm_hints,
+        &cookies->wm_transient_for, &cookies->wm_client_leader,
+        &cookies->wm_client_machine, &cookies->wm_window_role,
+        &cookies->net_wm_pid, &cookies->net_wm_icon, &cookies->wm_name,
+        &cookies->net_wm_name, &cookies->wm_icon_name,
+        &cookies->net_wm_icon_name, &cookies->wm_class,
+        &cookies->wm_protocols, &cookies->motif_wm_hints, &cookies->opacity,
+        &cookies->strut, &cookies->ewmh_hints.desktop,
+        &cookies->ewmh_hints.state, &cookies->ewmh_hints.window_type
+    };
+
+    for(int i = 0; i < countof(all); i++)
+        xcb_discard_reply(globalconf.connection, all[i]->sequence);
+}
+
+/** Check that reparenting a newly managed window worked, unmanaging it if
+ * not.
+ * \param w The window that was passed to client_manage().
+ * \param reparent_cookie The cookie returned by client_manage().
+ */
+void
+client_manage_check(xcb_window_t w, xcb_void_cookie_t reparent_cookie)
+{
+    xcb_generic_error_t *error = A_XCB_WAIT(xcb_request_check(globalconf.connection, reparent_cookie));
+    if (error == NULL)
+        return;
+
+    /* The client might already be gone again */
+    client_t *c = client_getbywin(w);
+    if (c != NULL)
+        warn("Failed to manage window with name '%s', class '%s', instance '%s', because reparenting failed.",
+                NONULL(c->name), NONULL(c->class), NONULL(c->instance));
+    event_handle((xcb_generic_event_t *) error);
+    p_delete(&error);
+    if (c != NULL)
+        client_unmanage(c, CLIENT_UNMANAGE_FAILED);
 }
 
 /** Manage a new client.
  * \param w The window.
  * \param wgeom Window geometry.
- * \param startup True if we are managing at startup time.
+ * \param wattr Window attributes.
+ * \param cookies The requests sent by client_manage_request() for this window.
+ * \param reparent_cookie If not NULL, checking that the window could be
+ * reparented is left to the caller, see client_manage_check(). The cookie is
+ * only set if a client was created.
  */
 void
-client_manage(xcb_window_t w, xcb_get_geometry_reply_t *wgeom, xcb_get_window_attributes_reply_t *wattr)
+client_manage(xcb_window_t w, xcb_get_geometry_reply_t *wgeom, xcb_get_window_attributes_reply_t *wattr,
+              client_manage_cookies_t *cookies, xcb_void_cookie_t *reparent_cookie)
 {
-    xcb_void_cookie_t reparent_cookie;
+    xcb_void_cookie_t reparent_q;
     lua_State *L = globalconf_get_lua_State();
     const uint32_t select_input_val[] = { CLIENT_SELECT_INPUT_EVENT_MASK };
 
-    if(systray_iskdedockapp(w))
+    if(systray_iskdedockapp(cookies->kde_dockapp))
     {
+        client_manage_discard(cookies);
         systray_request_handle(w);
         return;
     }
 
-    /* If this is a new client that just has been launched, then request its
-     * startup id. */
-    xcb_get_property_cookie_t startup_id_q = xcb_get_property(globalconf.connection, false,
-                                                              w, _NET_STARTUP_ID,
-                                                              XCB_GET_PROPERTY_TYPE_ANY, 0, UINT_MAX);
-
     /* Make sure the window is automatically mapped if awesome exits or dies. */
     xcb_change_save_set(globalconf.connection, XCB_SET_MODE_INSERT, w);
     if (globalconf.have_shape)
@@ -2024,7 +2096,7 @@ client_manage(xcb_window_t w, xcb_get_geometry_reply_t *wgeom, xcb_get_window_at
                                  globalconf.screen->root,
                                  XCB_CW_EVENT_MASK,
                                  no_event);
-    reparent_cookie = xcb_reparent_window_checked(globalconf.connection, w, c->frame_window, 0, 0);
+    reparent_q = xcb_reparent_window_checked(globalconf.connection, w, c->frame_window, 0, 0);
     xcb_map_window(globalconf.connection, w);
     xcb_change_window_attributes(globalconf.connection,
                                  globalconf.screen->root,
@@ -2052,6 +2124,9 @@ client_manage(xcb_window_t w, xcb_get_geometry_reply_t *wgeom, xcb_get_window_at
     /* Duplicate client and push it in client list */
     lua_pushvalue(L, -1);
     client_array_push(&globalconf.clients, luaA_object_ref(L, -1));
+    winmap_insert(&globalconf.windows, c->window, WINMAP_CLIENT_WINDOW, c);
+    winmap_insert(&globalconf.windows, c->frame_window, WINMAP_CLIENT_FRAME, c);
+    banning_client_need_update(c);
 
     /* Set the right screen */
     screen_client_moveto(c, screen_getbycoord(wgeom->x, wgeom->y), false);
@@ -2064,12 +2139,12 @@ client_manage(xcb_window_t w, xcb_get_geometry_reply_t *wgeom, xcb_get_window_at
     c->geometry.width = wgeom->width;
     c->geometry.height = wgeom->height;
 
-    luaA_object_emit_signal(L, -1, "property::x", 0);
-    luaA_object_emit_signal(L, -1, "property::y", 0);
-    luaA_object_emit_signal(L, -1, "property::width", 0);
-    luaA_object_emit_signal(L, -1, "property::height", 0);
+    luaA_object_emit_signal_id(L, -1, SIGNAL_ID("property::x"), 0);
+    luaA_object_emit_signal_id(L, -1, SIGNAL_ID("property::y"), 0);
+    luaA_object_emit_signal_id(L, -1, SIGNAL_ID("property::width"), 0);
+    luaA_object_emit_signal_id(L, -1, SIGNAL_ID("property::height"), 0);
     luaA_object_emit_signal(L, -1, "property::window", 0);
-    luaA_object_emit_signal(L, -1, "property::geometry", 0);
+    luaA_object_emit_signal_id(L, -1, SIGNAL_ID("property::geometry"), 0);
 
     /* Set border width */
     window_set_border_width(L, -1, wgeom->border_width);
@@ -2079,7 +2154,7 @@ client_manage(xcb_window_t w, xcb_get_geometry_reply_t *wgeom, xcb_get_window_at
     luaA_object_emit_signal(L, -1, "property::size_hints_honor", 0);
 
     /* update all properties */
-    client_update_properties(L, -1, c);
+    client_update_properties(L, -1, c, cookies);
 
     /* check if this is a TRANSIENT_FOR of another client */
     foreach(oc, globalconf.clients)
@@ -2090,24 +2165,25 @@ client_manage(xcb_window_t w, xcb_get_geometry_reply_t *wgeom, xcb_get_window_at
     xwindow_set_state(c->window, XCB_ICCCM_WM_STATE_NORMAL);
 
     /* Then check clients hints */
-    ewmh_client_check_hints(c);
+    ewmh_client_check_hints(c, cookies->ewmh_hints);
 
     /* Push client in stack */
     stack_client_push(c);
 
     /* Request our response */
     xcb_get_property_reply_t *reply =
-        xcb_get_property_reply(globalconf.connection, startup_id_q, NULL);
+        A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, cookies->startup_id, NULL));
     /* Say spawn that a client has been started, with startup id as argument */
     char *startup_id = xutil_get_text_property_from_reply(reply);
     p_delete(&reply);
 
     if (startup_id == NULL && c->leader_window != XCB_NONE) {
         /* GTK hides this property elsewhere. No idea why. */
-        startup_id_q = xcb_get_property(globalconf.connection, false,
-                                        c->leader_window, _NET_STARTUP_ID,
-                                        XCB_GET_PROPERTY_TYPE_ANY, 0, UINT_MAX);
-        reply = xcb_get_property_reply(globalconf.connection, startup_id_q, NULL);
+        xcb_get_property_cookie_t startup_id_q =
+            xcb_get_property(globalconf.connection, false,
+                             c->leader_window, _NET_STARTUP_ID,
+                             XCB_GET_PROPERTY_TYPE_ANY, 0, UINT_MAX);
+        reply = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, startup_id_q, NULL));
         startup_id = xutil_get_text_property_from_reply(reply);
         p_delete(&reply);
     }
@@ -2132,17 +2208,13 @@ client_manage(xcb_window_t w, xcb_get_geometry_reply_t *wgeom, xcb_get_window_at
     /*TODO v6: remove this*/
     luaA_object_emit_signal(L, -1, "manage", 0);
 
-    xcb_generic_error_t *error = xcb_request_check(globalconf.connection, reparent_cookie);
-    if (error != NULL) {
-        warn("Failed to manage window with name '%s', class '%s', instance '%s', because reparenting failed.",
-                NONULL(c->name), NONULL(c->class), NONULL(c->instance));
-        event_handle((xcb_generic_event_t *) error);
-        p_delete(&error);
-        client_unmanage(c, CLIENT_UNMANAGE_FAILED);
-    }
-
     /* pop client */
     lua_pop(L, 1);
+
+    if (reparent_cookie)
+        *reparent_cookie = reparent_q;
+    else
+        client_manage_check(w, reparent_q);
 }
 
 static void
@@ -2299,22 +2371,22 @@ client_resize_do(client_t *c, area_t geometry)
 
     luaA_object_push(L, c);
     if (!AREA_EQUAL(old_geometry, geometry))
-        luaA_object_emit_signal(L, -1, "property::geometry", 0);
+        luaA_object_emit_signal_id(L, -1, SIGNAL_ID("property::geometry"), 0);
     if (old_geometry.x != geometry.x || old_geometry.y != geometry.y)
     {
-        luaA_object_emit_signal(L, -1, "property::position", 0);
+        luaA_object_emit_signal_id(L, -1, SIGNAL_ID("property::position"), 0);
         if (old_geometry.x != geometry.x)
-            luaA_object_emit_signal(L, -1, "property::x", 0);
+            luaA_object_emit_signal_id(L, -1, SIGNAL_ID("property::x"), 0);
         else
-            luaA_object_emit_signal(L, -1, "property::y", 0);
+            luaA_object_emit_signal_id(L, -1, SIGNAL_ID("property::y"), 0);
     }
     if (old_geometry.width != geometry.width || old_geometry.height != geometry.height)
     {
-        luaA_object_emit_signal(L, -1, "property::size", 0);
+        luaA_object_emit_signal_id(L, -1, SIGNAL_ID("property::size"), 0);
         if (old_geometry.width != geometry.width)
-            luaA_object_emit_signal(L, -1, "property::width", 0);
+            luaA_object_emit_signal_id(L, -1, SIGNAL_ID("property::width"), 0);
         else
-            luaA_object_emit_signal(L, -1, "property::height", 0);
+            luaA_object_emit_signal_id(L, -1, SIGNAL_ID("property::height"), 0);
     }
     lua_pop(L, 1);
 
@@ -2395,7 +2467,7 @@ client_set_minimized(lua_State *L, int cidx, bool s)
     if(c->minimized != s)
     {
         c->minimized = s;
-        banning_need_update();
+        banning_client_need_update(c);
         if(s)
         {
             /* ICCCM: To transition from ICONIC to NORMAL state, the client
@@ -2459,7 +2531,7 @@ client_set_hidden(lua_State *L, int cidx, bool s)
     if(c->hidden != s)
     {
         c->hidden = s;
-        banning_need_update();
+        banning_client_need_update(c);
         if(strut_has_value(&c->strut))
             screen_update_workarea(c->screen);
         luaA_object_emit_signal(L, cidx, "property::hidden", 0);
@@ -2479,7 +2551,7 @@ client_set_sticky(lua_State *L, int cidx, bool s)
     if(c->sticky != s)
     {
         c->sticky = s;
-        banning_need_update();
+        banning_client_need_update(c);
         ewmh_client_update_desktop(c);
         if(strut_has_value(&c->strut))
             screen_update_workarea(c->screen);
@@ -2773,9 +2845,17 @@ client_unmanage(client_t *c, client_unmanage_t reason)
             client_array_remove(&globalconf.clients, elem);
             break;
         }
+    winmap_remove(&globalconf.windows, c->window);
+    winmap_remove(&globalconf.windows, c->frame_window);
+    winmap_remove(&globalconf.windows, c->nofocus_window);
     stack_client_remove(c);
-    for(int i = 0; i < globalconf.tags.len; i++)
-        untag_client(c, globalconf.tags.tab[i]);
+    tag_t **tags = p_alloca(tag_t *, c->tags.len);
+    int ntags = client_get_tags(c, tags);
+    for(int i = 0; i < ntags; i++)
+        untag_client(c, tags[i]);
+    /* Tags that are not activated must not keep a pointer to us either */
+    for(int i = c->tags.len; i > 0 && c->tags.len > 0; i--)
+        untag_client(c, c->tags.tab[0]);
 
     luaA_object_push(L, c);
 
@@ -2839,6 +2919,8 @@ client_unmanage(client_t *c, client_unmanage_t reason)
                                  XCB_CW_EVENT_MASK,
                                  (const uint32_t []) { 0 });
 
+    thumbnail_client_unmanage(c, reason != CLIENT_UNMANAGE_DESTROYED);
+
     if(reason != CLIENT_UNMANAGE_DESTROYED)
     {
         xcb_unmap_window(globalconf.connection, c->window);
@@ -2863,6 +2945,8 @@ client_unmanage(client_t *c, client_unmanage_t reason)
         xwindow_set_state(c->window, XCB_ICCCM_WM_STATE_WITHDRAWN);
     }
 
+    banning_client_remove(c);
+
     /* set client as invalid */
     c->window = XCB_NONE;
 
@@ -2944,6 +3028,52 @@ luaA_client_get(lua_State *L)
     return 1;
 }
 
+/** Get statistics about the icon cache.
+ *
+ * Icons from `_NET_WM_ICON` with identical pixels share one decoded surface,
+ * e.g. for many windows of the same application.
+ *
+ * @treturn table A table with the keys `icons` and `bytes` (distinct icons
+ *  alive and their size), `hits`, `misses` and `hit_rate`.
+ * @staticfct icon_cache
+ */
+static int
+luaA_client_icon_cache(lua_State *L)
+{
+    return draw_icon_cache_push_stats(L);
+}
+
+/** Get statistics about the thumbnail cache.
+ *
+ * @treturn table A table with the keys `thumbnails` and `bytes` (cached
+ *  images and their size), `budget`, `hits`, `misses`, `hit_rate` and
+ *  `evictions`.
+ * @staticfct thumbnail_cache
+ * @see thumbnail
+ * @see set_thumbnail_budget
+ */
+static int
+luaA_client_thumbnail_cache(lua_State *L)
+{
+    return thumbnail_push_stats(L);
+}
+
+/** Set how much memory cached thumbnails may use.
+ *
+ * The least recently used thumbnails are dropped when the cache grows larger.
+ * The default is 16 MiB.
+ *
+ * @tparam integer budget The size in bytes.
+ * @staticfct set_thumbnail_budget
+ * @see thumbnail
+ */
+static int
+luaA_client_set_thumbnail_budget(lua_State *L)
+{
+    thumbnail_set_budget(luaA_checkinteger_range(L, 1, 0, SIZE_MAX));
+    return 0;
+}
+
 /** Check if a client is visible on its screen.
  *
  * @treturn boolean A boolean value, true if the client is visible, false otherwise.
@@ -2962,9 +3092,9 @@ luaA_client_isvisible(lua_State *L)
  * \param array Array of icons to set.
  */
 void
-client_set_icons(client_t *c, cairo_surface_array_t array)
+client_set_icons(client_t *c, draw_icon_array_t array)
 {
-    cairo_surface_array_wipe(&c->icons);
+    draw_icon_array_wipe(&c->icons);
     c->icons = array;
 
     lua_State *L = globalconf_get_lua_State();
@@ -2982,10 +3112,17 @@ client_set_icons(client_t *c, cairo_surface_array_t array)
 static void
 client_set_icon(client_t *c, cairo_surface_t *s)
 {
-    cairo_surface_array_t array;
-    cairo_surface_array_init(&array);
+    draw_icon_array_t array;
+    draw_icon_array_init(&array);
     if (s && cairo_surface_status(s) == CAIRO_STATUS_SUCCESS)
-        cairo_surface_array_push(&array, draw_dup_image_surface(s));
+    {
+        cairo_surface_t *dup = draw_dup_image_surface(s);
+        draw_icon_array_append(&array, (draw_icon_t) {
+                .width = cairo_image_surface_get_width(dup),
+                .height = cairo_image_surface_get_height(dup),
+                .surface = dup,
+        });
+    }
     client_set_icons(c, array);
 }
 
@@ -3005,9 +3142,9 @@ client_set_icon_from_pixmaps(client_t *c, xcb_pixmap_t icon, xcb_pixmap_t mask)
     geom_icon_c = xcb_get_geometry_unchecked(globalconf.connection, icon);
     if (mask)
         geom_mask_c = xcb_get_geometry_unchecked(globalconf.connection, mask);
-    geom_icon_r = xcb_get_geometry_reply(globalconf.connection, geom_icon_c, NULL);
+    geom_icon_r = A_XCB_WAIT(xcb_get_geometry_reply(globalconf.connection, geom_icon_c, NULL));
     if (mask)
-        geom_mask_r = xcb_get_geometry_reply(globalconf.connection, geom_mask_c, NULL);
+        geom_mask_r = A_XCB_WAIT(xcb_get_geometry_reply(globalconf.connection, geom_mask_c, NULL));
 
     if (!geom_icon_r || (mask && !geom_mask_r))
         goto out;
@@ -3140,12 +3277,14 @@ static int
 luaA_client_tags(lua_State *L)
 {
     client_t *c = luaA_checkudata(L, 1, &client_class);
-    int j = 0;
 
     if(lua_gettop(L) == 2)
     {
         luaA_checktable(L, 2);
-        for(int i = 0; i < globalconf.tags.len; i++)
+        /* Work on a copy, untagging modifies c->tags */
+        tag_t **tags = p_alloca(tag_t *, c->tags.len);
+        int ntags = client_get_tags(c, tags);
+        for(int i = 0; i < ntags; i++)
         {
             /* Only untag if we aren't going to add this tag again */
             bool found = false;
@@ -3155,7 +3294,7 @@ luaA_client_tags(lua_State *L)
                 tag_t *t = lua_touserdata(L, -1);
                 /* Pop the value from lua_next */
                 lua_pop(L, 1);
-                if (t != globalconf.tags.tab[i])
+                if (t != tags[i])
                     continue;
 
                 /* Pop the key from lua_next */
@@ -3164,7 +3303,7 @@ luaA_client_tags(lua_State *L)
                 break;
             }
             if(!found)
-                untag_client(c, globalconf.tags.tab[i]);
+                untag_client(c, tags[i]);
         }
         lua_pushnil(L);
         while(lua_next(L, 2))
@@ -3175,13 +3314,14 @@ luaA_client_tags(lua_State *L)
         luaA_object_emit_signal(L, -1, "property::tags", 0);
     }
 
-    lua_newtable(L);
-    foreach(tag, globalconf.tags)
-        if(is_client_tagged(c, *tag))
-        {
-            luaA_object_push(L, *tag);
-            lua_rawseti(L, -2, ++j);
-        }
+    tag_t **tags = p_alloca(tag_t *, c->tags.len);
+    int ntags = client_get_tags(c, tags);
+    lua_createtable(L, ntags, 0);
+    for(int i = 0; i < ntags; i++)
+    {
+        luaA_object_push(L, tags[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
 
     return 1;
 }
@@ -3191,12 +3331,12 @@ luaA_client_tags(lua_State *L)
 static int
 luaA_client_get_first_tag(lua_State *L, client_t *c)
 {
-    foreach(tag, globalconf.tags)
-        if(is_client_tagged(c, *tag))
-        {
-            luaA_object_push(L, *tag);
-            return 1;
-        }
+    tag_t *tag = client_get_first_tag(c);
+    if(tag)
+    {
+        luaA_object_push(L, tag);
+        return 1;
+    }
 
     return 0;
 }
@@ -3337,47 +3477,105 @@ client_get_drawable(client_t *c, int x, int y)
     return client_get_drawable_offset(c, &x, &y);
 }
 
+/** Copy the damaged parts of a titlebar to the frame window.
+ * \param c The client.
+ * \param bar The titlebar.
+ * \param damage The damaged parts of the frame window.
+ */
 static void
-client_refresh_titlebar_partial(client_t *c, client_titlebar_t bar, int16_t x, int16_t y, uint16_t width, uint16_t height)
+client_refresh_titlebar_damage(client_t *c, client_titlebar_t bar, cairo_region_t *damage)
 {
     if(c->titlebar[bar].drawable == NULL
             || c->titlebar[bar].drawable->pixmap == XCB_NONE
             || !c->titlebar[bar].drawable->refreshed)
         return;
 
-    /* Is the titlebar part of the area that should get redrawn? */
+    /* Which part of the titlebar should get redrawn? */
     area_t area = titlebar_get_area(c, bar);
-    if (AREA_LEFT(area) >= x + width || AREA_RIGHT(area) <= x)
-        return;
-    if (AREA_TOP(area) >= y + height || AREA_BOTTOM(area) <= y)
-        return;
+    cairo_region_t *part = cairo_region_copy(damage);
+    cairo_region_intersect_rectangle(part, &(cairo_rectangle_int_t) {
+            area.x, area.y, area.width, area.height });
+
+    int n = cairo_region_num_rectangles(part);
+    if (n > 0)
+        /* Make cairo do all pending drawing */
+        cairo_surface_flush(c->titlebar[bar].drawable->surface);
+    for (int i = 0; i < n; i++)
+    {
+        cairo_rectangle_int_t rect;
+        cairo_region_get_rectangle(part, i, &rect);
+        xcb_copy_area(globalconf.connection, c->titlebar[bar].drawable->pixmap, c->frame_window,
+                globalconf.gc, rect.x - area.x, rect.y - area.y, rect.x, rect.y, rect.width, rect.height);
+    }
 
-    /* Redraw the affected parts */
-    cairo_surface_flush(c->titlebar[bar].drawable->surface);
-    xcb_copy_area(globalconf.connection, c->titlebar[bar].drawable->pixmap, c->frame_window,
-            globalconf.gc, x - area.x, y - area.y, x, y, width, height);
+    cairo_region_destroy(part);
+}
+
+/** Mark a part of a titlebar as needing to be copied to the frame window.
+ * \param c The client.
+ * \param bar The titlebar.
+ * \param region The changed part, in titlebar coordinates.
+ */
+static void
+client_refresh_titlebar(client_t *c, client_titlebar_t bar, const cairo_region_t *region)
+{
+    area_t area = titlebar_get_area(c, bar);
+    cairo_region_t *part = cairo_region_copy(region);
+    cairo_region_intersect_rectangle(part, &(cairo_rectangle_int_t) {
+            0, 0, area.width, area.height });
+    cairo_region_translate(part, area.x, area.y);
+
+    if (!c->frame_damage)
+        c->frame_damage = cairo_region_create();
+    cairo_region_union(c->frame_damage, part);
+    cairo_region_destroy(part);
 }
 
 #define HANDLE_TITLEBAR_REFRESH(name, index)                                                \
 static void                                                                                 \
-client_refresh_titlebar_ ## name(client_t *c)                                               \
+client_refresh_titlebar_ ## name(client_t *c, const cairo_region_t *region)                 \
 {                                                                                           \
-    area_t area = titlebar_get_area(c, index);                                              \
-    client_refresh_titlebar_partial(c, index, area.x, area.y, area.width, area.height);     \
+    client_refresh_titlebar(c, index, region);                                              \
 }
 HANDLE_TITLEBAR_REFRESH(top, CLIENT_TITLEBAR_TOP)
 HANDLE_TITLEBAR_REFRESH(right, CLIENT_TITLEBAR_RIGHT)
 HANDLE_TITLEBAR_REFRESH(bottom, CLIENT_TITLEBAR_BOTTOM)
 HANDLE_TITLEBAR_REFRESH(left, CLIENT_TITLEBAR_LEFT)
 
-/**
- * Refresh all titlebars that are in the specified rectangle
+/** Mark a part of the frame window as needing to be redrawn from the
+ * titlebars. This happens in the next client_refresh(), with one flush and as
+ * few copies as possible per titlebar for everything damaged until then.
+ * \param c The client.
+ * \param x The x coordinate of the damaged rectangle, relative to the frame.
+ * \param y The y coordinate of the damaged rectangle, relative to the frame.
+ * \param width The width of the damaged rectangle.
+ * \param height The height of the damaged rectangle.
  */
 void
-client_refresh_partial(client_t *c, int16_t x, int16_t y, uint16_t width, uint16_t height)
+client_damage(client_t *c, int16_t x, int16_t y, uint16_t width, uint16_t height)
 {
-    for (client_titlebar_t bar = CLIENT_TITLEBAR_TOP; bar < CLIENT_TITLEBAR_COUNT; bar++) {
-        client_refresh_titlebar_partial(c, bar, x, y, width, height);
+    if (!c->frame_damage)
+        c->frame_damage = cairo_region_create();
+    cairo_region_union_rectangle(c->frame_damage,
+                                 &(cairo_rectangle_int_t) { x, y, width, height });
+}
+
+/** Redraw the damaged parts of all frame windows.
+ */
+static void
+client_damage_refresh(void)
+{
+    foreach(_c, globalconf.clients)
+    {
+        client_t *c = *_c;
+        if (!c->frame_damage)
+            continue;
+
+        for (client_titlebar_t bar = CLIENT_TITLEBAR_TOP; bar < CLIENT_TITLEBAR_COUNT; bar++)
+            client_refresh_titlebar_damage(c, bar, c->frame_damage);
+
+        cairo_region_destroy(c->frame_damage);
+        c->frame_damage = NULL;
     }
 }
 
@@ -3487,6 +3685,32 @@ HANDLE_TITLEBAR(right, CLIENT_TITLEBAR_RIGHT)
 HANDLE_TITLEBAR(bottom, CLIENT_TITLEBAR_BOTTOM)
 HANDLE_TITLEBAR(left, CLIENT_TITLEBAR_LEFT)
 
+/** Resize a client to the geometry in a table, like c:geometry() does.
+ * \param L The Lua VM state.
+ * \param c The client.
+ * \param idx The index of the table with the new geometry.
+ */
+void
+luaA_client_set_geometry(lua_State *L, client_t *c, int idx)
+{
+    area_t geometry;
+
+    geometry.x = round(luaA_getopt_number_range(L, idx, "x", c->geometry.x, MIN_X11_COORDINATE, MAX_X11_COORDINATE));
+    geometry.y = round(luaA_getopt_number_range(L, idx, "y", c->geometry.y, MIN_X11_COORDINATE, MAX_X11_COORDINATE));
+    if(client_isfixed(c))
+    {
+        geometry.width = c->geometry.width;
+        geometry.height = c->geometry.height;
+    }
+    else
+    {
+        geometry.width = ceil(luaA_getopt_number_range(L, idx, "width", c->geometry.width, MIN_X11_SIZE, MAX_X11_SIZE));
+        geometry.height = ceil(luaA_getopt_number_range(L, idx, "height", c->geometry.height, MIN_X11_SIZE, MAX_X11_SIZE));
+    }
+
+    client_resize(c, geometry, c->size_hints_honor);
+}
+
 /** Return or set client geometry.
  *
  * @tparam table|nil geo A table with new coordinates, or nil.
@@ -3509,28 +3733,36 @@ luaA_client_geometry(lua_State *L)
 
     if(lua_gettop(L) == 2 && !lua_isnil(L, 2))
     {
-        area_t geometry;
-
         luaA_checktable(L, 2);
-        geometry.x = round(luaA_getopt_number_range(L, 2, "x", c->geometry.x, MIN_X11_COORDINATE, MAX_X11_COORDINATE));
-        geometry.y = round(luaA_getopt_number_range(L, 2, "y", c->geometry.y, MIN_X11_COORDINATE, MAX_X11_COORDINATE));
-        if(client_isfixed(c))
-        {
-            geometry.width = c->geometry.width;
-            geometry.height = c->geometry.height;
-        }
-        else
-        {
-            geometry.width = ceil(luaA_getopt_number_range(L, 2, "width", c->geometry.width, MIN_X11_SIZE, MAX_X11_SIZE));
-            geometry.height = ceil(luaA_getopt_number_range(L, 2, "height", c->geometry.height, MIN_X11_SIZE, MAX_X11_SIZE));
-        }
-
-        client_resize(c, geometry, c->size_hints_honor);
+        luaA_client_set_geometry(L, c, 2);
     }
 
     return luaA_pusharea(L, c->geometry);
 }
 
+/** Get the size that c:apply_size_hints() returns for a size.
+ * \param c The client.
+ * \param width The wanted width, ignored for fixed size clients.
+ * \param height The wanted height, ignored for fixed size clients.
+ * \return The client's geometry with the resulting size.
+ */
+area_t
+client_size_hinted(client_t *c, uint16_t width, uint16_t height)
+{
+    area_t geometry = c->geometry;
+
+    if(!client_isfixed(c))
+    {
+        geometry.width = width;
+        geometry.height = height;
+    }
+
+    if (c->size_hints_honor)
+        geometry = client_apply_size_hints(c, geometry);
+
+    return geometry;
+}
+
 /** Apply size hints to a size.
  *
  * This method applies the client size hints. The client
@@ -3558,8 +3790,7 @@ luaA_client_apply_size_hints(lua_State *L)
         geometry.height = ceil(luaA_checknumber_range(L, 3, MIN_X11_SIZE, MAX_X11_SIZE));
     }
 
-    if (c->size_hints_honor)
-        geometry = client_apply_size_hints(c, geometry);
+    geometry = client_size_hinted(c, geometry.width, geometry.height);
 
     lua_pushinteger(L, geometry.width);
     lua_pushinteger(L, geometry.height);
@@ -3850,16 +4081,16 @@ luaA_client_get_icon(lua_State *L, client_t *c)
         return 0;
 
     /* Pick the closest available size, only picking a smaller icon if no bigger
-     * one is available.
+     * one is available. Only the picked one gets decoded.
      */
-    cairo_surface_t *found = NULL;
+    draw_icon_t *found = NULL;
     int found_size = 0;
     int preferred_size = globalconf.preferred_icon_size;
 
-    foreach(surf, c->icons)
+    foreach(icon, c->icons)
     {
-        int width = cairo_image_surface_get_width(*surf);
-        int height = cairo_image_surface_get_height(*surf);
+        int width = icon->width;
+        int height = icon->height;
         int size = MAX(width, height);
 
         /* pick the icon if it's a better match than the one we already have */
@@ -3871,13 +4102,13 @@ luaA_client_get_icon(lua_State *L, client_t *c)
             size >= preferred_size && size < found_size;
         if (!icon_empty && (better_because_bigger || better_because_smaller || found_size == 0))
         {
-            found = *surf;
+            found = icon;
             found_size = size;
         }
     }
 
     /* lua gets its own reference which it will have to destroy */
-    lua_pushlightuserdata(L, cairo_surface_reference(found));
+    lua_pushlightuserdata(L, cairo_surface_reference(found ? draw_icon_get_surface(found) : NULL));
     return 1;
 }
 
@@ -4189,14 +4420,14 @@ luaA_client_get_icon_sizes(lua_State *L, client_t *c)
     int index = 1;
 
     lua_newtable(L);
-    foreach (s, c->icons) {
+    foreach (icon, c->icons) {
         /* Create a table { width, height } and append it to the table */
         lua_createtable(L, 2, 0);
 
-        lua_pushinteger(L, cairo_image_surface_get_width(*s));
+        lua_pushinteger(L, icon->width);
         lua_rawseti(L, -2, 1);
 
-        lua_pushinteger(L, cairo_image_surface_get_height(*s));
+        lua_pushinteger(L, icon->height);
         lua_rawseti(L, -2, 2);
 
         lua_rawseti(L, -2, index++);
@@ -4218,7 +4449,46 @@ luaA_client_get_some_icon(lua_State *L)
     int index = luaL_checkinteger(L, 2);
     luaL_argcheck(L, (index >= 1 && index <= c->icons.len), 2,
             "invalid icon index");
-    lua_pushlightuserdata(L, cairo_surface_reference(c->icons.tab[index-1]));
+    lua_pushlightuserdata(L, cairo_surface_reference(draw_icon_get_surface(&c->icons.tab[index-1])));
+    return 1;
+}
+
+/** Get a scaled-down copy of the client's content.
+ *
+ * The image fits into the given size, keeping the aspect ratio, and is never
+ * larger than the client. Thumbnails are cached per size and only made again
+ * after the client's content changed, so this is cheap enough to call every
+ * time a preview is shown. Covered clients work as well.
+ *
+ * Clients on other tags are unmapped and their content can not be read. If
+ * they had thumbnails before they were hidden, these are kept up to date until
+ * then and returned. Otherwise nothing is returned until the client is shown
+ * again. The window is redirected while it has cached thumbnails, which can
+ * make e.g. fullscreen games slower; it is unredirected once they are evicted.
+ *
+ * This needs the Composite and DAMAGE extensions. The surface is shared with
+ * the cache and must not be modified.
+ *
+ * @tparam integer width The maximum width.
+ * @tparam integer height The maximum height.
+ * @treturn[opt] surface A cairo image surface as light userdata, or nothing.
+ * @method thumbnail
+ * @see content
+ * @see thumbnail_cache
+ */
+static int
+luaA_client_thumbnail(lua_State *L)
+{
+    client_t *c = luaA_checkudata(L, 1, &client_class);
+    int width = luaA_checkinteger_range(L, 2, 1, MAX_X11_SIZE);
+    int height = luaA_checkinteger_range(L, 3, 1, MAX_X11_SIZE);
+    cairo_surface_t *surface = thumbnail_get(c, width, height);
+
+    if(!surface)
+        return 0;
+
+    /* lua has to make sure to free the ref or we have a leak */
+    lua_pushlightuserdata(L, cairo_surface_reference(surface));
     return 1;
 }
 
@@ -4284,6 +4554,9 @@ client_class_setup(lua_State *L)
     {
         LUA_CLASS_METHODS(client)
         { "get", luaA_client_get },
+        { "icon_cache", luaA_client_icon_cache },
+        { "thumbnail_cache", luaA_client_thumbnail_cache },
+        { "set_thumbnail_budget", luaA_client_set_thumbnail_budget },
         { "__index", luaA_client_module_index },
         { "__newindex", luaA_client_module_newindex },
         { NULL, NULL }
@@ -4308,6 +4581,7 @@ client_class_setup(lua_State *L)
         { "titlebar_bottom", luaA_client_titlebar_bottom },
         { "titlebar_left", luaA_client_titlebar_left },
         { "get_icon", luaA_client_get_some_icon },
+        { "thumbnail", luaA_client_thumbnail },
         { NULL, NULL }
     };
 
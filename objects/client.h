@@ -23,8 +23,11 @@
 #define AWESOME_OBJECTS_CLIENT_H
 
 #include "stack.h"
+#include "ewmh.h"
 #include "objects/window.h"
 
+#include <xcb/damage.h>
+
 #define CLIENT_SELECT_INPUT_EVENT_MASK (XCB_EVENT_MASK_STRUCTURE_NOTIFY \
                                         | XCB_EVENT_MASK_PROPERTY_CHANGE \
                                         | XCB_EVENT_MASK_FOCUS_CHANGE)
@@ -148,6 +151,12 @@ struct client_t
      * Note that the geometry remains unchanged and that the window is still mapped.
      */
     bool isbanned;
+    /** True if the client waits for the next banning_refresh() */
+    bool banning_pending;
+    /** Tags the client is tagged with, sorted by address */
+    client_tag_array_t tags;
+    /** Number of selected and activated tags the client is tagged with */
+    int selected_tags;
     /** true if the client must be skipped from task bar client list */
     bool skip_taskbar;
     /** True if the client cannot have focus */
@@ -167,9 +176,11 @@ struct client_t
     /** Key bindings */
     key_array_t keys;
     /** Icons */
-    cairo_surface_array_t icons;
+    draw_icon_array_t icons;
     /** True if we ever got an icon from _NET_WM_ICON */
     bool have_ewmh_icon;
+    /** Damage object watching the window for thumbnails, or XCB_NONE */
+    xcb_damage_damage_t damage;
     /** Size hints */
     xcb_size_hints_t size_hints;
     /** The visualtype that c->window uses */
@@ -193,10 +204,39 @@ struct client_t
         /** The drawable for this bar. */
         drawable_t *drawable;
     } titlebar[CLIENT_TITLEBAR_COUNT];
+    /** Parts of the frame window to copy from the titlebars in client_refresh() */
+    cairo_region_t *frame_damage;
     /** Motif WM hints, with an additional MWM_HINTS_AWESOME_SET bit */
     motif_wm_hints_t motif_wm_hints;
 };
 
+/** Replies needed by client_manage(), requested ahead of time so that many
+ * windows can be managed with a constant number of round trips.
+ */
+typedef struct
+{
+    xcb_get_property_cookie_t kde_dockapp;
+    xcb_get_property_cookie_t startup_id;
+    xcb_get_property_cookie_t wm_normal_hints;
+    xcb_get_property_cookie_t wm_hints;
+    xcb_get_property_cookie_t wm_transient_for;
+    xcb_get_property_cookie_t wm_client_leader;
+    xcb_get_property_cookie_t wm_client_machine;
+    xcb_get_property_cookie_t wm_window_role;
+    xcb_get_property_cookie_t net_wm_pid;
+    xcb_get_property_cookie_t net_wm_icon;
+    xcb_get_property_cookie_t wm_name;
+    xcb_get_property_cookie_t net_wm_name;
+    xcb_get_property_cookie_t wm_icon_name;
+    xcb_get_property_cookie_t net_wm_icon_name;
+    xcb_get_property_cookie_t wm_class;
+    xcb_get_property_cookie_t wm_protocols;
+    xcb_get_property_cookie_t motif_wm_hints;
+    xcb_get_property_cookie_t opacity;
+    xcb_get_property_cookie_t strut;
+    ewmh_client_hints_cookies_t ewmh_hints;
+} client_manage_cookies_t;
+
 ARRAY_FUNCS(client_t *, client, DO_NOTHING)
 
 /** Client class */
@@ -212,8 +252,13 @@ client_t * client_getbyframewin(xcb_window_t);
 void client_ban(client_t *);
 void client_ban_unfocus(client_t *);
 void client_unban(client_t *);
-void client_manage(xcb_window_t, xcb_get_geometry_reply_t *, xcb_get_window_attributes_reply_t *);
+void client_manage_request(xcb_window_t, client_manage_cookies_t *);
+void client_manage(xcb_window_t, xcb_get_geometry_reply_t *, xcb_get_window_attributes_reply_t *,
+                   client_manage_cookies_t *, xcb_void_cookie_t *);
+void client_manage_check(xcb_window_t, xcb_void_cookie_t);
 bool client_resize(client_t *, area_t, bool);
+area_t client_size_hinted(client_t *, uint16_t, uint16_t);
+void luaA_client_set_geometry(lua_State *, client_t *, int);
 void client_unmanage(client_t *, client_unmanage_t);
 void client_kill(client_t *);
 void client_set_sticky(lua_State *, int, bool);
@@ -239,7 +284,7 @@ void client_set_name(lua_State *L, int, char *);
 void client_set_startup_id(lua_State *L, int, char *);
 void client_set_alt_name(lua_State *L, int, char *);
 void client_set_group_window(lua_State *, int, xcb_window_t);
-void client_set_icons(client_t *, cairo_surface_array_t);
+void client_set_icons(client_t *, draw_icon_array_t);
 void client_set_icon_from_pixmaps(client_t *, xcb_pixmap_t, xcb_pixmap_t);
 void client_set_skip_taskbar(lua_State *, int, bool);
 void client_set_motif_wm_hints(lua_State *, int, motif_wm_hints_t);
@@ -248,11 +293,11 @@ bool client_focus_update(client_t *);
 bool client_hasproto(client_t *, xcb_atom_t);
 void client_ignore_enterleave_events(void);
 void client_restore_enterleave_events(void);
-void client_refresh_partial(client_t *, int16_t, int16_t, uint16_t, uint16_t);
+void client_damage(client_t *, int16_t, int16_t, uint16_t, uint16_t);
 void client_class_setup(lua_State *);
 void client_send_configure(client_t *);
 void client_find_transient_for(client_t *);
-void client_emit_scanned(void);
+void client_emit_scanned(double);
 void client_emit_scanning(void);
 drawable_t *client_get_drawable(client_t *, int, int);
 drawable_t *client_get_drawable_offset(client_t *, int *, int *);
@@ -33,12 +33,19 @@
 #include "drawable.h"
 #include "common/luaobject.h"
 #include "globalconf.h"
+#include "stats.h"
 
 #include <cairo-xcb.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 
 /** Drawable object.
  *
  * @field surface The drawable's cairo surface.
+ * @field shm Whether the drawable is rendered locally into MIT-SHM instead of
+ *  by the X server. This is off by default and can be enabled per drawable.
+ *  It stays false when MIT-SHM is unavailable, e.g. with a remote X server,
+ *  and while the drawable has no size.
  * @staticfct drawable
  */
 
@@ -86,6 +93,10 @@
  * @signal property::surface
  */
 
+/**
+ * @signal property::shm
+ */
+
 /** Get the number of instances.
  *
  * @return The number of drawable objects alive.
@@ -102,10 +113,178 @@
  * @staticfct set_newindex_miss_handler
  */
 
+/** Get statistics about the pool of unused pixmaps.
+ *
+ * Resized drawables give their pixmap back to a pool from which other
+ * drawables can take it. Pixmaps are allocated slightly larger than needed so
+ * that small changes in size can reuse them. Unused pixmaps are freed after
+ * some idle time.
+ *
+ * @treturn table A table with the keys `hits` and `misses` (pixmap allocations
+ *  served from the pool or not), `hit_rate`, `kept` (resizes that kept their
+ *  pixmap), `retained_pixmaps` and `retained_bytes`.
+ * @staticfct pixmap_pool
+ */
+
+/** Free all unused pixmaps in the pool now.
+ *
+ * @staticfct trim_pixmap_pool
+ */
+
 static lua_class_t drawable_class;
 
 LUA_OBJECT_FUNCS(drawable_class, drawable_t, drawable)
 
+/** Unused pixmaps are freed after this many seconds */
+#define PIXMAP_POOL_IDLE_SECONDS 10
+/** Never keep more than this many bytes of unused pixmaps */
+#define PIXMAP_POOL_MAX_BYTES (32 * 1024 * 1024)
+
+/** An unused pixmap */
+typedef struct
+{
+    xcb_pixmap_t pixmap;
+    uint8_t depth;
+    uint16_t width, height;
+    /** When the pixmap was put into the pool */
+    gint64 released;
+} pooled_pixmap_t;
+
+DO_ARRAY(pooled_pixmap_t, pooled_pixmap, DO_NOTHING)
+
+static struct
+{
+    /** Unused pixmaps, least recently released first */
+    pooled_pixmap_array_t pixmaps;
+    size_t retained_bytes;
+    uint64_t hits, misses, kept;
+    /** The idle trimming timeout, or 0 */
+    guint trim_source;
+} pixmap_pool;
+
+static size_t
+pixmap_pool_bytes(uint16_t width, uint16_t height)
+{
+    return (size_t) width * height * 4;
+}
+
+/** Round a pixmap dimension up to the size that is actually allocated. The
+ * granularity is an eighth of the next power of two, but at least 32 pixels.
+ * \param size The needed size.
+ * \return The size to allocate.
+ */
+static uint16_t
+pixmap_pool_bucket(uint16_t size)
+{
+    unsigned int step = 32;
+    while (step * 8 <= size)
+        step *= 2;
+    return MIN((size + step - 1) / step * step, UINT16_MAX);
+}
+
+/** Free pooled pixmaps.
+ * \param older_than Only free pixmaps released before this time.
+ */
+static void
+pixmap_pool_trim(gint64 older_than)
+{
+    while (pixmap_pool.pixmaps.len > 0 && pixmap_pool.pixmaps.tab[0].released <= older_than)
+    {
+        pooled_pixmap_t p = pooled_pixmap_array_take(&pixmap_pool.pixmaps, 0);
+        pixmap_pool.retained_bytes -= pixmap_pool_bytes(p.width, p.height);
+        xcb_free_pixmap(globalconf.connection, p.pixmap);
+    }
+}
+
+static gboolean
+pixmap_pool_trim_timeout(gpointer unused)
+{
+    pixmap_pool_trim(g_get_monotonic_time() - PIXMAP_POOL_IDLE_SECONDS * G_USEC_PER_SEC);
+    if (pixmap_pool.pixmaps.len > 0)
+        return G_SOURCE_CONTINUE;
+    pixmap_pool.trim_source = 0;
+    return G_SOURCE_REMOVE;
+}
+
+/** Get a pixmap of the default depth from the pool or create a new one.
+ * \param width The width, as returned by pixmap_pool_bucket().
+ * \param height The height, as returned by pixmap_pool_bucket().
+ * \return The pixmap.
+ */
+static xcb_pixmap_t
+pixmap_pool_acquire(uint16_t width, uint16_t height)
+{
+    for (int i = pixmap_pool.pixmaps.len - 1; i >= 0; i--)
+    {
+        pooled_pixmap_t *p = &pixmap_pool.pixmaps.tab[i];
+        if (p->depth == globalconf.default_depth && p->width == width && p->height == height)
+        {
+            pixmap_pool.hits++;
+            pixmap_pool.retained_bytes -= pixmap_pool_bytes(width, height);
+            return pooled_pixmap_array_take(&pixmap_pool.pixmaps, i).pixmap;
+        }
+    }
+
+    pixmap_pool.misses++;
+    xcb_pixmap_t pixmap = xcb_generate_id(globalconf.connection);
+    xcb_create_pixmap(globalconf.connection, globalconf.default_depth, pixmap,
+                      globalconf.screen->root, width, height);
+    return pixmap;
+}
+
+/** Put a no longer used pixmap into the pool.
+ * \param pixmap The pixmap, which must have the default depth.
+ * \param width The width of the pixmap.
+ * \param height The height of the pixmap.
+ */
+static void
+pixmap_pool_release(xcb_pixmap_t pixmap, uint16_t width, uint16_t height)
+{
+    pooled_pixmap_array_append(&pixmap_pool.pixmaps, (pooled_pixmap_t) {
+            .pixmap = pixmap,
+            .depth = globalconf.default_depth,
+            .width = width,
+            .height = height,
+            .released = g_get_monotonic_time(),
+    });
+    pixmap_pool.retained_bytes += pixmap_pool_bytes(width, height);
+
+    while (pixmap_pool.retained_bytes > PIXMAP_POOL_MAX_BYTES)
+        pixmap_pool_trim(pixmap_pool.pixmaps.tab[0].released);
+
+    if (pixmap_pool.trim_source == 0 && pixmap_pool.pixmaps.len > 0)
+        pixmap_pool.trim_source = g_timeout_add_seconds(PIXMAP_POOL_IDLE_SECONDS,
+                                                        pixmap_pool_trim_timeout, NULL);
+}
+
+static int
+luaA_drawable_pixmap_pool(lua_State *L)
+{
+    uint64_t total = pixmap_pool.hits + pixmap_pool.misses;
+
+    lua_createtable(L, 0, 6);
+    lua_pushnumber(L, pixmap_pool.hits);
+    lua_setfield(L, -2, "hits");
+    lua_pushnumber(L, pixmap_pool.misses);
+    lua_setfield(L, -2, "misses");
+    lua_pushnumber(L, total ? (double) pixmap_pool.hits / total : 0);
+    lua_setfield(L, -2, "hit_rate");
+    lua_pushnumber(L, pixmap_pool.kept);
+    lua_setfield(L, -2, "kept");
+    lua_pushinteger(L, pixmap_pool.pixmaps.len);
+    lua_setfield(L, -2, "retained_pixmaps");
+    lua_pushnumber(L, pixmap_pool.retained_bytes);
+    lua_setfield(L, -2, "retained_bytes");
+    return 1;
+}
+
+static int
+luaA_drawable_trim_pixmap_pool(lua_State *L)
+{
+    pixmap_pool_trim(G_MAXINT64);
+    return 0;
+}
+
 drawable_t *
 drawable_allocator(lua_State *L, drawable_refresh_callback *callback, void *data)
 {
@@ -115,25 +294,202 @@ drawable_allocator(lua_State *L, drawable_refresh_callback *callback, void *data
     d->refreshed = false;
     d->surface = NULL;
     d->pixmap = XCB_NONE;
+    d->shm_wanted = false;
+    d->shm_seg = XCB_NONE;
+    d->shm_data = NULL;
+    d->shm_busy = false;
     return d;
 }
 
+/** Get the cairo format matching the default visual's pixel layout.
+ * \return The format, or CAIRO_FORMAT_INVALID if the layout is unusual.
+ */
+static cairo_format_t
+drawable_shm_format(void)
+{
+    const xcb_setup_t *setup = xcb_get_setup(globalconf.connection);
+    uint8_t host_order = G_BYTE_ORDER == G_LITTLE_ENDIAN ?
+        XCB_IMAGE_ORDER_LSB_FIRST : XCB_IMAGE_ORDER_MSB_FIRST;
+
+    if (setup->image_byte_order != host_order
+            || globalconf.visual->red_mask != 0xff0000
+            || globalconf.visual->green_mask != 0xff00
+            || globalconf.visual->blue_mask != 0xff)
+        return CAIRO_FORMAT_INVALID;
+
+    for (xcb_format_iterator_t it = xcb_setup_pixmap_formats_iterator(setup);
+            it.rem; xcb_format_next(&it))
+        if (it.data->depth == globalconf.default_depth && it.data->bits_per_pixel != 32)
+            return CAIRO_FORMAT_INVALID;
+
+    switch (globalconf.default_depth)
+    {
+    case 24:
+        return CAIRO_FORMAT_RGB24;
+    case 32:
+        return CAIRO_FORMAT_ARGB32;
+    default:
+        return CAIRO_FORMAT_INVALID;
+    }
+}
+
+/** Create an image surface for a drawable in a new MIT-SHM segment.
+ * \param d The drawable, which must not have a surface.
+ * \return true on success, false if the X11 surface has to be used.
+ */
+static bool
+drawable_create_shm_surface(drawable_t *d)
+{
+    cairo_format_t format = drawable_shm_format();
+    if (!globalconf.have_shm || format == CAIRO_FORMAT_INVALID)
+        return false;
+
+    int stride = cairo_format_stride_for_width(format, d->geometry.width);
+    int id = shmget(IPC_PRIVATE, (size_t) stride * d->geometry.height, IPC_CREAT | 0600);
+    if (id < 0)
+        return false;
+    void *data = shmat(id, NULL, 0);
+    if (data == (void *) -1)
+    {
+        shmctl(id, IPC_RMID, NULL);
+        return false;
+    }
+
+    xcb_shm_seg_t seg = xcb_generate_id(globalconf.connection);
+    xcb_generic_error_t *error = A_XCB_WAIT(xcb_request_check(globalconf.connection,
+                xcb_shm_attach_checked(globalconf.connection, seg, id, true)));
+    /* The segment goes away once both sides detached */
+    shmctl(id, IPC_RMID, NULL);
+    if (error)
+    {
+        /* Most likely the X server is not on this machine, don't retry */
+        warn("Could not attach MIT-SHM segment, using server-side drawing");
+        globalconf.have_shm = false;
+        p_delete(&error);
+        shmdt(data);
+        return false;
+    }
+
+    d->shm_seg = seg;
+    d->shm_data = data;
+    d->surface = cairo_image_surface_create_for_data(data, format,
+                                                     d->geometry.width,
+                                                     d->geometry.height,
+                                                     stride);
+    return true;
+}
+
+/** Wait until the X server finished reading from a drawable's MIT-SHM segment
+ * so that it can be drawn to again.
+ * \param d The drawable.
+ */
+static void
+drawable_shm_wait(drawable_t *d)
+{
+    if (!d->shm_busy)
+        return;
+
+    d->shm_busy = false;
+    xcb_get_input_focus_reply_t *reply = A_XCB_WAIT(xcb_get_input_focus_reply(
+                globalconf.connection, d->shm_fence, NULL));
+    p_delete(&reply);
+}
+
+/** Upload a part of a drawable's MIT-SHM segment into its pixmap.
+ * \param d The drawable.
+ * \param region The part to upload.
+ */
+static void
+drawable_shm_upload(drawable_t *d, const cairo_region_t *region)
+{
+    cairo_surface_flush(d->surface);
+
+    int n = cairo_region_num_rectangles(region);
+    for (int i = 0; i < n; i++)
+    {
+        cairo_rectangle_int_t rect;
+        cairo_region_get_rectangle(region, i, &rect);
+        xcb_shm_put_image(globalconf.connection, d->pixmap, globalconf.gc,
+                          d->geometry.width, d->geometry.height,
+                          rect.x, rect.y, rect.width, rect.height, rect.x, rect.y,
+                          globalconf.default_depth, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                          false, d->shm_seg, 0);
+    }
+
+    /* Replies arrive in order, so the newest fence covers all uploads */
+    if (d->shm_busy)
+        xcb_discard_reply(globalconf.connection, d->shm_fence.sequence);
+    d->shm_fence = xcb_get_input_focus_unchecked(globalconf.connection);
+    d->shm_busy = true;
+}
+
+static void
+drawable_create_surface(drawable_t *d)
+{
+    if (!d->pixmap)
+    {
+        d->pixmap_width = pixmap_pool_bucket(d->geometry.width);
+        d->pixmap_height = pixmap_pool_bucket(d->geometry.height);
+        d->pixmap = pixmap_pool_acquire(d->pixmap_width, d->pixmap_height);
+    }
+    if (!d->shm_wanted || !drawable_create_shm_surface(d))
+    {
+        cairo_surface_t *surface = cairo_xcb_surface_create(globalconf.connection,
+                                                            d->pixmap, globalconf.visual,
+                                                            d->pixmap_width, d->pixmap_height);
+        d->surface = cairo_surface_create_for_rectangle(surface, 0, 0,
+                                                        d->geometry.width,
+                                                        d->geometry.height);
+        cairo_surface_destroy(surface);
+    }
+}
+
+/** Should a drawable keep its pixmap after a resize?
+ * \param d The drawable.
+ * \param geom The new geometry.
+ * \return true if the pixmap is large enough and does not waste too much.
+ */
+static bool
+drawable_pixmap_fits(drawable_t *d, area_t geom)
+{
+    return geom.width <= d->pixmap_width && geom.height <= d->pixmap_height
+        && pixmap_pool_bytes(d->pixmap_width, d->pixmap_height)
+            <= 2 * pixmap_pool_bytes(pixmap_pool_bucket(geom.width),
+                                     pixmap_pool_bucket(geom.height));
+}
+
+static void
+drawable_release_pixmap(drawable_t *d)
+{
+    if (d->pixmap)
+        pixmap_pool_release(d->pixmap, d->pixmap_width, d->pixmap_height);
+    d->pixmap = XCB_NONE;
+}
+
 static void
 drawable_unset_surface(drawable_t *d)
 {
     cairo_surface_finish(d->surface);
     cairo_surface_destroy(d->surface);
-    if (d->pixmap)
-        xcb_free_pixmap(globalconf.connection, d->pixmap);
+    if (d->shm_busy)
+        xcb_discard_reply(globalconf.connection, d->shm_fence.sequence);
+    if (d->shm_seg)
+    {
+        xcb_shm_detach(globalconf.connection, d->shm_seg);
+        shmdt(d->shm_data);
+    }
     d->refreshed = false;
     d->surface = NULL;
-    d->pixmap = XCB_NONE;
+    d->shm_seg = XCB_NONE;
+    d->shm_data = NULL;
+    d->shm_busy = false;
 }
 
 static void
 drawable_wipe(drawable_t *d)
 {
     drawable_unset_surface(d);
+    drawable_release_pixmap(d);
 }
 
 void
@@ -145,28 +501,29 @@ drawable_set_geometry(lua_State *L, int didx, area_t geom)
 
     bool size_changed = (old.width != geom.width) || (old.height != geom.height);
     if (size_changed)
+    {
         drawable_unset_surface(d);
+        if (d->pixmap && drawable_pixmap_fits(d, geom))
+            pixmap_pool.kept++;
+        else
+            drawable_release_pixmap(d);
+    }
     if (size_changed && geom.width > 0 && geom.height > 0)
     {
-        d->pixmap = xcb_generate_id(globalconf.connection);
-        xcb_create_pixmap(globalconf.connection, globalconf.default_depth, d->pixmap,
-                          globalconf.screen->root, geom.width, geom.height);
-        d->surface = cairo_xcb_surface_create(globalconf.connection,
-                                              d->pixmap, globalconf.visual,
-                                              geom.width, geom.height);
+        drawable_create_surface(d);
         luaA_object_emit_signal(L, didx, "property::surface", 0);
     }
 
     if (!AREA_EQUAL(old, geom))
-        luaA_object_emit_signal(L, didx, "property::geometry", 0);
+        luaA_object_emit_signal_id(L, didx, SIGNAL_ID("property::geometry"), 0);
     if (old.x != geom.x)
-        luaA_object_emit_signal(L, didx, "property::x", 0);
+        luaA_object_emit_signal_id(L, didx, SIGNAL_ID("property::x"), 0);
     if (old.y != geom.y)
-        luaA_object_emit_signal(L, didx, "property::y", 0);
+        luaA_object_emit_signal_id(L, didx, SIGNAL_ID("property::y"), 0);
     if (old.width != geom.width)
-        luaA_object_emit_signal(L, didx, "property::width", 0);
+        luaA_object_emit_signal_id(L, didx, SIGNAL_ID("property::width"), 0);
     if (old.height != geom.height)
-        luaA_object_emit_signal(L, didx, "property::height", 0);
+        luaA_object_emit_signal_id(L, didx, SIGNAL_ID("property::height"), 0);
 }
 
 /** Get a drawable's surface
@@ -178,24 +535,130 @@ static int
 luaA_drawable_get_surface(lua_State *L, drawable_t *drawable)
 {
     if (drawable->surface)
+    {
+        /* Whoever asks for the surface is about to draw to it */
+        drawable_shm_wait(drawable);
         /* Lua gets its own reference which it will have to destroy */
         lua_pushlightuserdata(L, cairo_surface_reference(drawable->surface));
+    }
     else
         lua_pushnil(L);
     return 1;
 }
 
+/** Get whether a drawable is rendered into MIT-SHM.
+ * \param L The Lua VM state.
+ * \param drawable The drawable object.
+ * \return The number of elements pushed on stack.
+ */
+static int
+luaA_drawable_get_shm(lua_State *L, drawable_t *drawable)
+{
+    lua_pushboolean(L, drawable->shm_seg != XCB_NONE);
+    return 1;
+}
+
+/** Set whether a drawable should be rendered into MIT-SHM.
+ * \param L The Lua VM state.
+ * \param drawable The drawable object.
+ * \return The number of elements pushed on stack.
+ */
+static int
+luaA_drawable_set_shm(lua_State *L, drawable_t *drawable)
+{
+    bool wanted = luaA_checkboolean(L, -1);
+    if (wanted == drawable->shm_wanted)
+        return 0;
+
+    drawable->shm_wanted = wanted;
+    if (drawable->surface)
+    {
+        bool had_shm = drawable->shm_seg != XCB_NONE;
+        drawable_unset_surface(drawable);
+        drawable_create_surface(drawable);
+        luaA_object_emit_signal(L, -3, "property::surface", 0);
+        if (had_shm != (drawable->shm_seg != XCB_NONE))
+            luaA_object_emit_signal(L, -3, "property::shm", 0);
+    }
+    return 0;
+}
+
+/** Add a rectangle from a table with x, y, width and height to a region.
+ * \param L The Lua VM state.
+ * \param idx The index of the table.
+ * \param region The region to add to.
+ */
+static void
+luaA_drawable_region_add(lua_State *L, int idx, cairo_region_t *region)
+{
+    luaA_checktable(L, idx);
+    cairo_rectangle_int_t rect = {
+        .x = luaA_getopt_integer(L, idx, "x", 0),
+        .y = luaA_getopt_integer(L, idx, "y", 0),
+        .width = luaA_getopt_integer(L, idx, "width", 0),
+        .height = luaA_getopt_integer(L, idx, "height", 0),
+    };
+    if (rect.width > 0 && rect.height > 0)
+        cairo_region_union_rectangle(region, &rect);
+}
+
 /** Refresh a drawable's content. This has to be called whenever some drawing to
  * the drawable's surface has been done and should become visible.
  *
+ * Without arguments, the whole drawable is refreshed. Otherwise only the given
+ * part is copied to the screen, which is either a single rectangle or a list
+ * of tables with the keys `x`, `y`, `width` and `height`.
+ *
+ * @tparam[opt] integer|table x The x coordinate of the refreshed rectangle, or
+ *  a list of rectangles.
+ * @tparam[opt] integer y The y coordinate of the refreshed rectangle.
+ * @tparam[opt] integer width The width of the refreshed rectangle.
+ * @tparam[opt] integer height The height of the refreshed rectangle.
  * @method refresh
  */
 static int
 luaA_drawable_refresh(lua_State *L)
 {
     drawable_t *drawable = luaA_checkudata(L, 1, &drawable_class);
+    cairo_region_t *region;
+
+    if (lua_isnoneornil(L, 2))
+        region = cairo_region_create_rectangle(&(cairo_rectangle_int_t) {
+                0, 0, drawable->geometry.width, drawable->geometry.height });
+    else if (lua_istable(L, 2))
+    {
+        region = cairo_region_create();
+        for (size_t i = 1, n = luaA_rawlen(L, 2); i <= n; i++)
+        {
+            lua_rawgeti(L, 2, i);
+            luaA_drawable_region_add(L, -1, region);
+            lua_pop(L, 1);
+        }
+    }
+    else
+    {
+        cairo_rectangle_int_t rect = {
+            .x = luaA_checkinteger(L, 2),
+            .y = luaA_checkinteger(L, 3),
+            .width = luaA_checkinteger(L, 4),
+            .height = luaA_checkinteger(L, 5),
+        };
+        region = cairo_region_create();
+        if (rect.width > 0 && rect.height > 0)
+            cairo_region_union_rectangle(region, &rect);
+    }
+
+    cairo_region_intersect_rectangle(region, &(cairo_rectangle_int_t) {
+            0, 0, drawable->geometry.width, drawable->geometry.height });
+
     drawable->refreshed = true;
-    (*drawable->refresh_callback)(drawable->refresh_data);
+    if (!cairo_region_is_empty(region))
+    {
+        if (drawable->shm_seg)
+            drawable_shm_upload(drawable, region);
+        (*drawable->refresh_callback)(drawable->refresh_data, region);
+    }
+    cairo_region_destroy(region);
 
     return 0;
 }
@@ -218,6 +681,8 @@ drawable_class_setup(lua_State *L)
     static const struct luaL_Reg drawable_methods[] =
     {
         LUA_CLASS_METHODS(drawable)
+        { "pixmap_pool", luaA_drawable_pixmap_pool },
+        { "trim_pixmap_pool", luaA_drawable_trim_pixmap_pool },
         { NULL, NULL }
     };
 
@@ -239,6 +704,10 @@ drawable_class_setup(lua_State *L)
                             NULL,
                             (lua_class_propfunc_t) luaA_drawable_get_surface,
                             NULL);
+    luaA_class_add_property(&drawable_class, "shm",
+                            (lua_class_propfunc_t) luaA_drawable_set_shm,
+                            (lua_class_propfunc_t) luaA_drawable_get_shm,
+                            (lua_class_propfunc_t) luaA_drawable_set_shm);
 }
 
 // vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
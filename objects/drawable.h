@@ -26,14 +26,21 @@
 #include "common/luaclass.h"
 #include "draw.h"
 
-typedef void drawable_refresh_callback(void *);
+#include <xcb/shm.h>
+
+/** Callback for refreshing the given part of a drawable.
+ * The region is in drawable coordinates and owned by the caller.
+ */
+typedef void drawable_refresh_callback(void *, const cairo_region_t *);
 
 /** drawable type */
 struct drawable_t
 {
     LUA_OBJECT_HEADER
-    /** The pixmap we are drawing to. */
+    /** The pixmap we are drawing to. It can be larger than the drawable. */
     xcb_pixmap_t pixmap;
+    /** The size of the pixmap. */
+    uint16_t pixmap_width, pixmap_height;
     /** Surface for drawing. */
     cairo_surface_t *surface;
     /** The geometry of the drawable (in root window coordinates). */
@@ -44,6 +51,16 @@ struct drawable_t
     drawable_refresh_callback *refresh_callback;
     /** Data for refresh callback. */
     void *refresh_data;
+    /** Should the surface be rendered locally into MIT-SHM if possible? */
+    bool shm_wanted;
+    /** The MIT-SHM segment backing the surface, or XCB_NONE. */
+    xcb_shm_seg_t shm_seg;
+    /** Our mapping of the MIT-SHM segment. */
+    void *shm_data;
+    /** Could the X server still be reading from the MIT-SHM segment? */
+    bool shm_busy;
+    /** Reply that arrives once the X server finished reading. */
+    xcb_get_input_focus_cookie_t shm_fence;
 };
 typedef struct drawable_t drawable_t;
 
@@ -183,11 +183,15 @@ drawin_wipe(drawin_t *w)
     {
         /* Make sure we don't accidentally kill the systray window */
         drawin_systray_kickout(w);
+        winmap_remove(&globalconf.windows, w->window);
         xcb_destroy_window(globalconf.connection, w->window);
         w->window = XCB_NONE;
     }
     /* No unref needed because we are being garbage collected */
     w->drawable = NULL;
+    if(w->damage)
+        cairo_region_destroy(w->damage);
+    w->damage = NULL;
 }
 
 static void
@@ -201,11 +205,14 @@ drawin_update_drawing(lua_State *L, int widx)
 
 /** Refresh the window content by copying its pixmap data to its window.
  * \param w The drawin to refresh.
+ * \param region The part of the drawin that changed.
  */
-static inline void
-drawin_refresh_pixmap(drawin_t *w)
+static void
+drawin_refresh_pixmap(drawin_t *w, const cairo_region_t *region)
 {
-    drawin_refresh_pixmap_partial(w, 0, 0, w->geometry.width, w->geometry.height);
+    if (!w->damage)
+        w->damage = cairo_region_create();
+    cairo_region_union(w->damage, region);
 }
 
 static void
@@ -229,6 +236,37 @@ drawin_apply_moveresize(drawin_t *w)
     client_restore_enterleave_events();
 }
 
+/** Copy the damaged parts of a drawin from its pixmap to its window.
+ * \param drawin The drawin.
+ */
+static void
+drawin_refresh_damage(drawin_t *drawin)
+{
+    cairo_region_t *damage = drawin->damage;
+    drawin->damage = NULL;
+
+    if (drawin->drawable && drawin->drawable->pixmap && drawin->drawable->refreshed)
+    {
+        cairo_region_intersect_rectangle(damage, &(cairo_rectangle_int_t) {
+                0, 0, drawin->geometry.width, drawin->geometry.height });
+
+        int n = cairo_region_num_rectangles(damage);
+        if (n > 0)
+            /* Make cairo do all pending drawing */
+            cairo_surface_flush(drawin->drawable->surface);
+        for (int i = 0; i < n; i++)
+        {
+            cairo_rectangle_int_t rect;
+            cairo_region_get_rectangle(damage, i, &rect);
+            xcb_copy_area(globalconf.connection, drawin->drawable->pixmap,
+                          drawin->window, globalconf.gc, rect.x, rect.y, rect.x, rect.y,
+                          rect.width, rect.height);
+        }
+    }
+
+    cairo_region_destroy(damage);
+}
+
 void
 drawin_refresh(void)
 {
@@ -236,6 +274,8 @@ drawin_refresh(void)
     {
         drawin_apply_moveresize(*item);
         window_border_refresh((window_t *) *item);
+        if((*item)->damage)
+            drawin_refresh_damage(*item);
     }
 }
 
@@ -279,15 +319,15 @@ drawin_moveresize(lua_State *L, int udx, area_t geometry)
     drawin_update_drawing(L, udx);
 
     if (!AREA_EQUAL(old_geometry, w->geometry))
-        luaA_object_emit_signal(L, udx, "property::geometry", 0);
+        luaA_object_emit_signal_id(L, udx, SIGNAL_ID("property::geometry"), 0);
     if (old_geometry.x != w->geometry.x)
-        luaA_object_emit_signal(L, udx, "property::x", 0);
+        luaA_object_emit_signal_id(L, udx, SIGNAL_ID("property::x"), 0);
     if (old_geometry.y != w->geometry.y)
-        luaA_object_emit_signal(L, udx, "property::y", 0);
+        luaA_object_emit_signal_id(L, udx, SIGNAL_ID("property::y"), 0);
     if (old_geometry.width != w->geometry.width)
-        luaA_object_emit_signal(L, udx, "property::width", 0);
+        luaA_object_emit_signal_id(L, udx, SIGNAL_ID("property::width"), 0);
     if (old_geometry.height != w->geometry.height)
-        luaA_object_emit_signal(L, udx, "property::height", 0);
+        luaA_object_emit_signal_id(L, udx, SIGNAL_ID("property::height"), 0);
 
     screen_t *old_screen = screen_getbycoord(old_geometry.x, old_geometry.y);
     screen_t *new_screen = screen_getbycoord(w->geometry.x, w->geometry.y);
@@ -298,7 +338,9 @@ drawin_moveresize(lua_State *L, int udx, area_t geometry)
     }
 }
 
-/** Refresh the window content by copying its pixmap data to its window.
+/** Mark a part of a drawin as needing to be copied from its pixmap to its
+ * window. This happens in the next drawin_refresh(), with one flush and as
+ * few copies as possible for everything damaged until then.
  * \param drawin The drawin to refresh.
  * \param x The copy starting point x component.
  * \param y The copy starting point y component.
@@ -306,21 +348,14 @@ drawin_moveresize(lua_State *L, int udx, area_t geometry)
  * \param h The copy height from the y component.
  */
 void
-drawin_refresh_pixmap_partial(drawin_t *drawin,
-                              int16_t x, int16_t y,
-                              uint16_t w, uint16_t h)
+drawin_damage(drawin_t *drawin,
+              int16_t x, int16_t y,
+              uint16_t w, uint16_t h)
 {
-    if (!drawin->drawable || !drawin->drawable->pixmap || !drawin->drawable->refreshed)
-        return;
-
-    /* Make sure it really has the size it should have */
-    drawin_apply_moveresize(drawin);
-
-    /* Make cairo do all pending drawing */
-    cairo_surface_flush(drawin->drawable->surface);
-    xcb_copy_area(globalconf.connection, drawin->drawable->pixmap,
-                  drawin->window, globalconf.gc, x, y, x, y,
-                  w, h);
+    if (!drawin->damage)
+        drawin->damage = cairo_region_create();
+    cairo_region_union_rectangle(drawin->damage,
+                                 &(cairo_rectangle_int_t) { x, y, w, h });
 }
 
 static void
@@ -339,6 +374,7 @@ drawin_map(lua_State *L, int widx)
     stack_windows();
     /* Add it to the list of visible drawins */
     drawin_array_append(&globalconf.drawins, drawin);
+    winmap_insert(&globalconf.windows, drawin->window, WINMAP_DRAWIN, drawin);
     /* Make sure it has a surface */
     if(drawin->drawable->surface == NULL)
         drawin_update_drawing(L, widx);
@@ -348,6 +384,7 @@ static void
 drawin_unmap(drawin_t *drawin)
 {
     xcb_unmap_window(globalconf.connection, drawin->window);
+    winmap_remove(&globalconf.windows, drawin->window);
     foreach(item, globalconf.drawins)
         if(*item == drawin)
         {
@@ -363,10 +400,7 @@ drawin_unmap(drawin_t *drawin)
 drawin_t *
 drawin_getbywin(xcb_window_t win)
 {
-    foreach(w, globalconf.drawins)
-        if((*w)->window == win)
-            return *w;
-    return NULL;
+    return winmap_lookup(&globalconf.windows, win, WINMAP_DRAWIN);
 }
 
 /** Set a drawin visible or not.
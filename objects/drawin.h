@@ -42,12 +42,14 @@ struct drawin_t
     area_t geometry;
     /** Do we have a pending geometry change that still needs to be applied? */
     bool geometry_dirty;
+    /** Parts of the window to copy from the pixmap in drawin_refresh() */
+    cairo_region_t *damage;
 };
 
 ARRAY_FUNCS(drawin_t *, drawin, DO_NOTHING)
 
 drawin_t * drawin_getbywin(xcb_window_t);
-void drawin_refresh_pixmap_partial(drawin_t *, int16_t, int16_t, uint16_t, uint16_t);
+void drawin_damage(drawin_t *, int16_t, int16_t, uint16_t, uint16_t);
 void luaA_drawin_systray_kickout(lua_State *);
 
 void drawin_class_setup(lua_State *);
@@ -52,6 +52,7 @@
 #include "objects/client.h"
 #include "objects/drawin.h"
 #include "event.h"
+#include "stats.h"
 
 #include <stdio.h>
 
@@ -622,7 +623,7 @@ screen_get_randr_output(lua_State *L, xcb_randr_monitor_info_iterator_t *it)
     output.mm_height = it->data->height_in_millimeters;
 
     name_c = xcb_get_atom_name_unchecked(globalconf.connection, it->data->name);
-    name_r = xcb_get_atom_name_reply(globalconf.connection, name_c, NULL);
+    name_r = A_XCB_WAIT(xcb_get_atom_name_reply(globalconf.connection, name_c, NULL));
 
     if (name_r) {
         const char *name = xcb_get_atom_name_name(name_r);
@@ -650,7 +651,7 @@ static void
 screen_scan_randr_monitors(lua_State *L, screen_array_t *screens)
 {
     xcb_randr_get_monitors_cookie_t monitors_c = xcb_randr_get_monitors(globalconf.connection, globalconf.screen->root, 1);
-    xcb_randr_get_monitors_reply_t *monitors_r = xcb_randr_get_monitors_reply(globalconf.connection, monitors_c, NULL);
+    xcb_randr_get_monitors_reply_t *monitors_r = A_XCB_WAIT(xcb_randr_get_monitors_reply(globalconf.connection, monitors_c, NULL));
     xcb_randr_monitor_info_iterator_t monitor_iter;
 
     if (monitors_r == NULL) {
@@ -708,7 +709,7 @@ screen_get_randr_crtcs_outputs(lua_State *L, xcb_randr_get_crtc_info_reply_t *cr
     for(int j = 0; j < xcb_randr_get_crtc_info_outputs_length(crtc_info_r); j++)
     {
         xcb_randr_get_output_info_cookie_t output_info_c = xcb_randr_get_output_info(globalconf.connection, randr_outputs[j], XCB_CURRENT_TIME);
-        xcb_randr_get_output_info_reply_t *output_info_r = xcb_randr_get_output_info_reply(globalconf.connection, output_info_c, NULL);
+        xcb_randr_get_output_info_reply_t *output_info_r = A_XCB_WAIT(xcb_randr_get_output_info_reply(globalconf.connection, output_info_c, NULL));
         screen_output_t output;
 
         if (!output_info_r) {
@@ -740,7 +741,7 @@ screen_scan_randr_crtcs(lua_State *L, screen_array_t *screens)
      * You have CRTC that manages a part of a SCREEN.
      * Each CRTC can draw stuff on one or more OUTPUT. */
     xcb_randr_get_screen_resources_cookie_t screen_res_c = xcb_randr_get_screen_resources(globalconf.connection, globalconf.screen->root);
-    xcb_randr_get_screen_resources_reply_t *screen_res_r = xcb_randr_get_screen_resources_reply(globalconf.connection, screen_res_c, NULL);
+    xcb_randr_get_screen_resources_reply_t *screen_res_r = A_XCB_WAIT(xcb_randr_get_screen_resources_reply(globalconf.connection, screen_res_c, NULL));
 
     if (screen_res_r == NULL) {
         warn("RANDR GetScreenResources failed; this should not be possible");
@@ -754,7 +755,7 @@ screen_scan_randr_crtcs(lua_State *L, screen_array_t *screens)
     {
         /* Get info on the output crtc */
         xcb_randr_get_crtc_info_cookie_t crtc_info_c = xcb_randr_get_crtc_info(globalconf.connection, randr_crtcs[i], XCB_CURRENT_TIME);
-        xcb_randr_get_crtc_info_reply_t *crtc_info_r = xcb_randr_get_crtc_info_reply(globalconf.connection, crtc_info_c, NULL);
+        xcb_randr_get_crtc_info_reply_t *crtc_info_r = A_XCB_WAIT(xcb_randr_get_crtc_info_reply(globalconf.connection, crtc_info_c, NULL));
 
         if(!crtc_info_r) {
             warn("RANDR GetCRTCInfo failed; this should not be possible");
@@ -832,8 +833,8 @@ screen_scan_randr(lua_State *L, screen_array_t *screens)
         return;
 
     version_reply =
-        xcb_randr_query_version_reply(globalconf.connection,
-                                      xcb_randr_query_version(globalconf.connection, 1, 5), 0);
+        A_XCB_WAIT(xcb_randr_query_version_reply(globalconf.connection,
+                                      xcb_randr_query_version(globalconf.connection, 1, 5), 0));
     if(!version_reply)
         return;
 
@@ -889,15 +890,15 @@ screen_scan_xinerama(lua_State *L, screen_array_t *screens)
     if(!extension_reply || !extension_reply->present)
         return;
 
-    xia = xcb_xinerama_is_active_reply(globalconf.connection, xcb_xinerama_is_active(globalconf.connection), NULL);
+    xia = A_XCB_WAIT(xcb_xinerama_is_active_reply(globalconf.connection, xcb_xinerama_is_active(globalconf.connection), NULL));
     xinerama_is_active = xia && xia->state;
     p_delete(&xia);
     if(!xinerama_is_active)
         return;
 
-    xsq = xcb_xinerama_query_screens_reply(globalconf.connection,
+    xsq = A_XCB_WAIT(xcb_xinerama_query_screens_reply(globalconf.connection,
                                            xcb_xinerama_query_screens_unchecked(globalconf.connection),
-                                           NULL);
+                                           NULL));
 
     if(!xsq) {
         warn("Xinerama QueryScreens failed; this should not be possible");
@@ -1063,8 +1064,11 @@ screen_modified(screen_t *existing_screen, screen_t *other_screen)
         area_t old_geometry = existing_screen->geometry;
         existing_screen->geometry = other_screen->geometry;
         luaA_object_push(L, existing_screen);
-        luaA_pusharea(L, old_geometry);
-        luaA_object_emit_signal(L, -2, "property::geometry", 1);
+        if(luaA_object_has_signal_listeners(L, -1, SIGNAL_ID("property::geometry")))
+        {
+            luaA_pusharea(L, old_geometry);
+            luaA_object_emit_signal_id(L, -2, SIGNAL_ID("property::geometry"), 1);
+        }
         lua_pop(L, 1);
         screen_update_workarea(existing_screen);
     }
@@ -1457,9 +1461,9 @@ screen_update_primary(void)
 
     screen_t *primary_screen = NULL;
     xcb_randr_get_output_primary_reply_t *primary =
-        xcb_randr_get_output_primary_reply(globalconf.connection,
+        A_XCB_WAIT(xcb_randr_get_output_primary_reply(globalconf.connection,
                 xcb_randr_get_output_primary(globalconf.connection, globalconf.screen->root),
-                NULL);
+                NULL));
 
     if (!primary)
         return;
@@ -23,6 +23,7 @@
 #include "objects/selection_transfer.h"
 #include "common/luaobject.h"
 #include "globalconf.h"
+#include "stats.h"
 
 #define REGISTRY_ACQUIRE_TABLE_INDEX "awesome_selection_acquires"
 
@@ -145,9 +146,9 @@ luaA_selection_acquire_new(lua_State *L)
     name = luaL_checklstring(L, -1, &name_length);
 
     /* Get the atom identifying the selection */
-    reply = xcb_intern_atom_reply(globalconf.connection,
+    reply = A_XCB_WAIT(xcb_intern_atom_reply(globalconf.connection,
             xcb_intern_atom_unchecked(globalconf.connection, false, name_length, name),
-            NULL);
+            NULL));
     name_atom = reply ? reply->atom : XCB_NONE;
     p_delete(&reply);
 
@@ -162,9 +163,9 @@ luaA_selection_acquire_new(lua_State *L)
 
     /* Try to acquire the selection */
     xcb_set_selection_owner(globalconf.connection, selection->window, name_atom, selection->timestamp);
-    selection_reply = xcb_get_selection_owner_reply(globalconf.connection,
+    selection_reply = A_XCB_WAIT(xcb_get_selection_owner_reply(globalconf.connection,
             xcb_get_selection_owner(globalconf.connection, name_atom),
-            NULL);
+            NULL));
     if (selection_reply == NULL || selection_reply->owner != selection->window) {
         /* Acquiring the selection failed, return nothing */
         p_delete(&selection_reply);
@@ -23,6 +23,7 @@
 #include "common/luaobject.h"
 #include "common/atoms.h"
 #include "globalconf.h"
+#include "stats.h"
 
 #define REGISTRY_GETTER_TABLE_INDEX "awesome_selection_getters"
 
@@ -81,11 +82,11 @@ luaA_selection_getter_new(lua_State *L)
     cookies[0] = xcb_intern_atom_unchecked(globalconf.connection, false, name_length, name);
     cookies[1] = xcb_intern_atom_unchecked(globalconf.connection, false, target_length, target);
 
-    reply = xcb_intern_atom_reply(globalconf.connection, cookies[0], NULL);
+    reply = A_XCB_WAIT(xcb_intern_atom_reply(globalconf.connection, cookies[0], NULL));
     name_atom = reply ? reply->atom : XCB_NONE;
     p_delete(&reply);
 
-    reply = xcb_intern_atom_reply(globalconf.connection, cookies[1], NULL);
+    reply = A_XCB_WAIT(xcb_intern_atom_reply(globalconf.connection, cookies[1], NULL));
     target_atom = reply ? reply->atom : XCB_NONE;
     p_delete(&reply);
 
@@ -124,8 +125,8 @@ selection_push_data(lua_State *L, xcb_get_property_reply_t *property)
 
         lua_newtable(L);
         for (size_t i = 0; i < num_atoms; i++) {
-            xcb_get_atom_name_reply_t *reply = xcb_get_atom_name_reply(
-                    globalconf.connection, cookies[i], NULL);
+            xcb_get_atom_name_reply_t *reply = A_XCB_WAIT(xcb_get_atom_name_reply(
+                    globalconf.connection, cookies[i], NULL));
             if (reply)
             {
                 lua_pushlstring(L, xcb_get_atom_name_name(reply), xcb_get_atom_name_name_length(reply));
@@ -151,9 +152,9 @@ selection_handle_selectionnotify(lua_State *L, int ud, xcb_atom_t property)
         xcb_change_window_attributes(globalconf.connection, selection->window,
             XCB_CW_EVENT_MASK, (uint32_t[]) { XCB_EVENT_MASK_PROPERTY_CHANGE });
 
-        xcb_get_property_reply_t *property_r = xcb_get_property_reply(globalconf.connection,
+        xcb_get_property_reply_t *property_r = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection,
                 xcb_get_property(globalconf.connection, true, selection->window, AWESOME_SELECTION_ATOM,
-                    XCB_GET_PROPERTY_TYPE_ANY, 0, 0xffffffff), NULL);
+                    XCB_GET_PROPERTY_TYPE_ANY, 0, 0xffffffff), NULL));
 
         if (property_r)
         {
@@ -215,9 +216,9 @@ property_handle_awesome_selection_atom(uint8_t state, xcb_window_t window)
 
     selection_getter_t *selection = lua_touserdata(L, -1);
 
-    xcb_get_property_reply_t *property_r = xcb_get_property_reply(globalconf.connection,
+    xcb_get_property_reply_t *property_r = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection,
             xcb_get_property(globalconf.connection, true, selection->window, AWESOME_SELECTION_ATOM,
-                XCB_GET_PROPERTY_TYPE_ANY, 0, 0xffffffff), NULL);
+                XCB_GET_PROPERTY_TYPE_ANY, 0, 0xffffffff), NULL));
 
     if (property_r)
     {
@@ -23,6 +23,7 @@
 #include "common/luaobject.h"
 #include "common/atoms.h"
 #include "globalconf.h"
+#include "stats.h"
 
 #define REGISTRY_TRANSFER_TABLE_INDEX "awesome_selection_transfers"
 #define TRANSFER_DATA_INDEX "data_for_next_chunk"
@@ -171,8 +172,8 @@ selection_transfer_begin(lua_State *L, int ud, xcb_window_t requestor,
     lua_pop(L, 1);
 
     /* Get the atom name */
-    xcb_get_atom_name_reply_t *reply = xcb_get_atom_name_reply(globalconf.connection,
-            xcb_get_atom_name_unchecked(globalconf.connection, target), NULL);
+    xcb_get_atom_name_reply_t *reply = A_XCB_WAIT(xcb_get_atom_name_reply(globalconf.connection,
+            xcb_get_atom_name_unchecked(globalconf.connection, target), NULL));
     if (reply) {
         lua_pushlstring(L, xcb_get_atom_name_name(reply),
                 xcb_get_atom_name_name_length(reply));
@@ -266,8 +267,8 @@ luaA_selection_transfer_send(lua_State *L)
                     atom_lengths[i], atom_strings[i]);
         }
         for (size_t i = 0; i < len; i++) {
-            xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(globalconf.connection,
-                    cookies[i], NULL);
+            xcb_intern_atom_reply_t *reply = A_XCB_WAIT(xcb_intern_atom_reply(globalconf.connection,
+                    cookies[i], NULL));
             atoms[i] = reply ? reply->atom : XCB_NONE;
             p_delete(&reply);
         }
@@ -22,6 +22,7 @@
 #include "objects/selection_watcher.h"
 #include "common/luaobject.h"
 #include "globalconf.h"
+#include "stats.h"
 
 #include <xcb/xfixes.h>
 
@@ -85,9 +86,9 @@ luaA_selection_watcher_new(lua_State *L)
     selection->window = XCB_NONE;
 
     /* Get the atom identifying the selection to watch */
-    reply = xcb_intern_atom_reply(globalconf.connection,
+    reply = A_XCB_WAIT(xcb_intern_atom_reply(globalconf.connection,
             xcb_intern_atom_unchecked(globalconf.connection, false, name_length, name),
-            NULL);
+            NULL));
     if (reply) {
         selection->selection = reply->atom;
         p_delete(&reply);
@@ -321,6 +321,39 @@ tag_wipe(tag_t *tag)
 OBJECT_EXPORT_PROPERTY(tag, tag_t, selected)
 OBJECT_EXPORT_PROPERTY(tag, tag_t, name)
 
+/** Check if a tag makes its clients visible.
+ * \param tag The tag.
+ * \return True if the tag is both activated and selected.
+ */
+static inline bool
+tag_shows_clients(tag_t *tag)
+{
+    return tag->activated && tag->selected;
+}
+
+/** Update the selected tag count of the clients of a tag after its selected
+ * or activated state changed, and schedule a banning update for the clients
+ * whose visibility flipped.
+ * \param tag The tag.
+ * \param was_shown The value of tag_shows_clients() before the change.
+ */
+static void
+tag_update_clients_visibility(tag_t *tag, bool was_shown)
+{
+    bool shown = tag_shows_clients(tag);
+    if(shown == was_shown)
+        return;
+
+    foreach(_c, tag->clients)
+    {
+        client_t *c = *_c;
+        bool before = c->selected_tags > 0;
+        c->selected_tags += shown ? 1 : -1;
+        if(before != (c->selected_tags > 0))
+            banning_client_need_update(c);
+    }
+}
+
 /** View or unview a tag.
  * \param L The Lua VM state.
  * \param udx The index of the tag on the stack.
@@ -332,8 +365,9 @@ tag_view(lua_State *L, int udx, bool view)
     tag_t *tag = luaA_checkudata(L, udx, &tag_class);
     if(tag->selected != view)
     {
+        bool was_shown = tag_shows_clients(tag);
         tag->selected = view;
-        banning_need_update();
+        tag_update_clients_visibility(tag, was_shown);
         foreach(screen, globalconf.screens)
             screen_update_workarea(*screen);
 
@@ -375,8 +409,10 @@ tag_client(lua_State *L, client_t *c)
     }
 
     client_array_append(&t->clients, c);
+    client_tag_array_insert(&c->tags, t);
+    if(tag_shows_clients(t) && c->selected_tags++ == 0)
+        banning_client_need_update(c);
     ewmh_client_update_desktop(c);
-    banning_need_update();
     screen_update_workarea(c->screen);
 
     tag_client_emit_signal(t, c, "tagged");
@@ -389,12 +425,18 @@ tag_client(lua_State *L, client_t *c)
 void
 untag_client(client_t *c, tag_t *t)
 {
+    tag_t **ct = client_tag_array_lookup(&c->tags, &t);
+    if(!ct)
+        return;
+    client_tag_array_remove(&c->tags, ct);
+
     for(int i = 0; i < t->clients.len; i++)
         if(t->clients.tab[i] == c)
         {
             lua_State *L = globalconf_get_lua_State();
             client_array_take(&t->clients, i);
-            banning_need_update();
+            if(tag_shows_clients(t) && --c->selected_tags == 0)
+                banning_client_need_update(c);
             ewmh_client_update_desktop(c);
             screen_update_workarea(c->screen);
             tag_client_emit_signal(t, c, "untagged");
@@ -411,11 +453,47 @@ untag_client(client_t *c, tag_t *t)
 bool
 is_client_tagged(client_t *c, tag_t *t)
 {
-    for(int i = 0; i < t->clients.len; i++)
-        if(t->clients.tab[i] == c)
-            return true;
+    return client_tag_array_lookup(&c->tags, &t) != NULL;
+}
+
+/** Get the activated tags of a client in the order of globalconf.tags.
+ * \param c The client.
+ * \param tags An array with room for c->tags.len tags to fill.
+ * \return The number of tags stored in the array.
+ */
+int
+client_get_tags(client_t *c, tag_t **tags)
+{
+    int n = 0;
+
+    /* Tags are only ever appended to globalconf.tags, so its order is the
+     * activation order. Clients have few tags, an insertion sort will do. */
+    foreach(tag, c->tags)
+        if((*tag)->activated)
+        {
+            int i = n++;
+            for(; i > 0 && tags[i - 1]->activation_serial > (*tag)->activation_serial; i--)
+                tags[i] = tags[i - 1];
+            tags[i] = *tag;
+        }
+
+    return n;
+}
+
+/** Get the first activated tag of a client in the order of globalconf.tags.
+ * \param c The client.
+ * \return The tag or NULL if the client has no activated tag.
+ */
+tag_t *
+client_get_first_tag(client_t *c)
+{
+    tag_t *first = NULL;
+
+    foreach(tag, c->tags)
+        if((*tag)->activated && (!first || (*tag)->activation_serial < first->activation_serial))
+            first = *tag;
 
-    return false;
+    return first;
 }
 
 /** Get the index of the tag with focused client or first selected
@@ -563,9 +641,13 @@ luaA_tag_set_activated(lua_State *L, tag_t *tag)
     if(activated == tag->activated)
         return 0;
 
+    bool was_shown = tag_shows_clients(tag);
     tag->activated = activated;
+    tag_update_clients_visibility(tag, was_shown);
     if(activated)
     {
+        static unsigned long activation_serial = 0;
+        tag->activation_serial = ++activation_serial;
         lua_pushvalue(L, -3);
         tag_array_append(&globalconf.tags, luaA_object_ref_class(L, -1, &tag_class));
     }
@@ -582,7 +664,6 @@ luaA_tag_set_activated(lua_State *L, tag_t *tag)
         {
             tag->selected = false;
             luaA_object_emit_signal(L, -3, "property::selected", 0);
-            banning_need_update();
         }
         luaA_object_unref(L, tag);
     }
@@ -28,10 +28,21 @@ int tags_get_current_or_first_selected_index(void);
 void tag_client(lua_State *, client_t *);
 void untag_client(client_t *, tag_t *);
 bool is_client_tagged(client_t *, tag_t *);
+int client_get_tags(client_t *, tag_t **);
+tag_t *client_get_first_tag(client_t *);
 void tag_unref_simplified(tag_t **);
 
 ARRAY_FUNCS(tag_t *, tag, tag_unref_simplified)
 
+static inline int
+client_tag_cmp(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t) *(tag_t * const *) a, y = (uintptr_t) *(tag_t * const *) b;
+    return x > y ? 1 : (x < y ? -1 : 0);
+}
+
+BARRAY_FUNCS(tag_t *, client_tag, DO_NOTHING, client_tag_cmp)
+
 /** Tag type */
 struct tag
 {
@@ -42,6 +53,8 @@ struct tag
     bool activated;
     /** true if selected */
     bool selected;
+    /** Increasing with each activation, orders tags like globalconf.tags */
+    unsigned long activation_serial;
     /** clients in this tag */
     client_array_t clients;
 };
@@ -58,6 +58,7 @@
 #include "objects/screen.h"
 #include "property.h"
 #include "xwindow.h"
+#include "stats.h"
 
 lua_class_t window_class;
 LUA_CLASS_FUNCS(window, window_class)
@@ -401,9 +402,9 @@ window_get_xproperty(lua_State *L, xcb_window_t window, int prop_idx)
 
     type = prop->type == PROP_STRING ? UTF8_STRING : XCB_ATOM_CARDINAL;
     length = prop->type == PROP_STRING ? UINT32_MAX : 1;
-    reply = xcb_get_property_reply(globalconf.connection,
+    reply = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection,
             xcb_get_property_unchecked(globalconf.connection, false, window,
-                prop->atom, type, 0, length), NULL);
+                prop->atom, type, 0, length), NULL));
     if(!reply)
         return 0;
 
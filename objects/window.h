@@ -72,7 +72,11 @@ typedef enum
     /** The window type */ \
     window_type_t type; \
     /** The border width callback */ \
-    void (*border_width_callback)(void *, uint16_t old, uint16_t new);
+    void (*border_width_callback)(void *, uint16_t old, uint16_t new); \
+    /** Position in the stacking order last sent to X, see stack_refresh() */ \
+    int stack_index; \
+    /** The stack_refresh() generation that stack_index belongs to */ \
+    unsigned int stack_generation;
 
 /** Window structure */
 typedef struct
@@ -28,16 +28,17 @@
 #include "objects/selection_getter.h"
 #include "objects/selection_transfer.h"
 #include "xwindow.h"
+#include "stats.h"
 
 #include <xcb/xcb_atom.h>
 
 #define HANDLE_TEXT_PROPERTY(funcname, atom, setfunc) \
     xcb_get_property_cookie_t \
-    property_get_##funcname(client_t *c) \
+    property_get_##funcname(xcb_window_t window) \
     { \
         return xcb_get_property(globalconf.connection, \
                                 false, \
-                                c->window, \
+                                window, \
                                 atom, \
                                 XCB_GET_PROPERTY_TYPE_ANY, \
                                 0, \
@@ -48,7 +49,7 @@
     { \
         lua_State *L = globalconf_get_lua_State(); \
         xcb_get_property_reply_t * reply = \
-                    xcb_get_property_reply(globalconf.connection, cookie, NULL); \
+                    A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, cookie, NULL)); \
         luaA_object_push(L, c); \
         setfunc(L, -1, xutil_get_text_property_from_reply(reply)); \
         lua_pop(L, 1); \
@@ -60,7 +61,7 @@
     { \
         client_t *c = client_getbywin(window); \
         if(c) \
-            property_update_##funcname(c, property_get_##funcname(c));\
+            property_update_##funcname(c, property_get_##funcname(c->window));\
     }
 
 
@@ -80,7 +81,7 @@ HANDLE_TEXT_PROPERTY(wm_window_role, WM_WINDOW_ROLE, client_set_role)
     { \
         client_t *c = client_getbywin(window); \
         if(c) \
-            property_update_##name(c, property_get_##name(c));\
+            property_update_##name(c, property_get_##name(c->window));\
     }
 
 HANDLE_PROPERTY(wm_protocols)
@@ -96,9 +97,9 @@ HANDLE_PROPERTY(motif_wm_hints)
 #undef HANDLE_PROPERTY
 
 xcb_get_property_cookie_t
-property_get_wm_transient_for(client_t *c)
+property_get_wm_transient_for(xcb_window_t window)
 {
-    return xcb_icccm_get_wm_transient_for_unchecked(globalconf.connection, c->window);
+    return xcb_icccm_get_wm_transient_for_unchecked(globalconf.connection, window);
 }
 
 void
@@ -107,9 +108,9 @@ property_update_wm_transient_for(client_t *c, xcb_get_property_cookie_t cookie)
     lua_State *L = globalconf_get_lua_State();
     xcb_window_t trans;
 
-    if(!xcb_icccm_get_wm_transient_for_reply(globalconf.connection,
+    if(!A_XCB_WAIT(xcb_icccm_get_wm_transient_for_reply(globalconf.connection,
                                              cookie,
-                                             &trans, NULL))
+                                             &trans, NULL)))
     {
         c->transient_for_window = XCB_NONE;
         client_find_transient_for(c);
@@ -128,9 +129,9 @@ property_update_wm_transient_for(client_t *c, xcb_get_property_cookie_t cookie)
 }
 
 xcb_get_property_cookie_t
-property_get_wm_client_leader(client_t *c)
+property_get_wm_client_leader(xcb_window_t window)
 {
-    return xcb_get_property_unchecked(globalconf.connection, false, c->window,
+    return xcb_get_property_unchecked(globalconf.connection, false, window,
                                       WM_CLIENT_LEADER, XCB_ATOM_WINDOW, 0, 32);
 }
 
@@ -144,7 +145,7 @@ property_update_wm_client_leader(client_t *c, xcb_get_property_cookie_t cookie)
     xcb_get_property_reply_t *reply;
     void *data;
 
-    reply = xcb_get_property_reply(globalconf.connection, cookie, NULL);
+    reply = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, cookie, NULL));
 
     if(reply && reply->value_len && (data = xcb_get_property_value(reply)))
         c->leader_window = *(xcb_window_t *) data;
@@ -153,9 +154,9 @@ property_update_wm_client_leader(client_t *c, xcb_get_property_cookie_t cookie)
 }
 
 xcb_get_property_cookie_t
-property_get_wm_normal_hints(client_t *c)
+property_get_wm_normal_hints(xcb_window_t window)
 {
-    return xcb_icccm_get_wm_normal_hints_unchecked(globalconf.connection, c->window);
+    return xcb_icccm_get_wm_normal_hints_unchecked(globalconf.connection, window);
 }
 
 /** Update the size hints of a client.
@@ -167,9 +168,9 @@ property_update_wm_normal_hints(client_t *c, xcb_get_property_cookie_t cookie)
 {
     lua_State *L = globalconf_get_lua_State();
 
-    xcb_icccm_get_wm_normal_hints_reply(globalconf.connection,
+    A_XCB_WAIT(xcb_icccm_get_wm_normal_hints_reply(globalconf.connection,
 					cookie,
-					&c->size_hints, NULL);
+					&c->size_hints, NULL));
 
     luaA_object_push(L, c);
     luaA_object_emit_signal(L, -1, "property::size_hints", 0);
@@ -177,9 +178,9 @@ property_update_wm_normal_hints(client_t *c, xcb_get_property_cookie_t cookie)
 }
 
 xcb_get_property_cookie_t
-property_get_wm_hints(client_t *c)
+property_get_wm_hints(xcb_window_t window)
 {
-    return xcb_icccm_get_wm_hints_unchecked(globalconf.connection, c->window);
+    return xcb_icccm_get_wm_hints_unchecked(globalconf.connection, window);
 }
 
 /** Update the WM hints of a client.
@@ -192,9 +193,9 @@ property_update_wm_hints(client_t *c, xcb_get_property_cookie_t cookie)
     lua_State *L = globalconf_get_lua_State();
     xcb_icccm_wm_hints_t wmh;
 
-    if(!xcb_icccm_get_wm_hints_reply(globalconf.connection,
+    if(!A_XCB_WAIT(xcb_icccm_get_wm_hints_reply(globalconf.connection,
 				     cookie,
-				     &wmh, NULL))
+				     &wmh, NULL)))
         return;
 
     luaA_object_push(L, c);
@@ -224,9 +225,9 @@ property_update_wm_hints(client_t *c, xcb_get_property_cookie_t cookie)
 }
 
 xcb_get_property_cookie_t
-property_get_wm_class(client_t *c)
+property_get_wm_class(xcb_window_t window)
 {
-    return xcb_icccm_get_wm_class_unchecked(globalconf.connection, c->window);
+    return xcb_icccm_get_wm_class_unchecked(globalconf.connection, window);
 }
 
 /** Update WM_CLASS of a client.
@@ -239,9 +240,9 @@ property_update_wm_class(client_t *c, xcb_get_property_cookie_t cookie)
     lua_State *L = globalconf_get_lua_State();
     xcb_icccm_get_wm_class_reply_t hint;
 
-    if(!xcb_icccm_get_wm_class_reply(globalconf.connection,
+    if(!A_XCB_WAIT(xcb_icccm_get_wm_class_reply(globalconf.connection,
 				     cookie,
-				     &hint, NULL))
+				     &hint, NULL)))
         return;
 
     luaA_object_push(L, c);
@@ -258,22 +259,22 @@ property_handle_net_wm_strut_partial(uint8_t state,
     client_t *c = client_getbywin(window);
 
     if(c)
-        ewmh_process_client_strut(c);
+        ewmh_process_client_strut(c, ewmh_client_strut_get_unchecked(c->window));
 }
 
 xcb_get_property_cookie_t
-property_get_net_wm_icon(client_t *c)
+property_get_net_wm_icon(xcb_window_t window)
 {
-    return ewmh_window_icon_get_unchecked(c->window);
+    return ewmh_window_icon_get_unchecked(window);
 }
 
 void
 property_update_net_wm_icon(client_t *c, xcb_get_property_cookie_t cookie)
 {
-    cairo_surface_array_t array = ewmh_window_icon_get_reply(cookie);
+    draw_icon_array_t array = ewmh_window_icon_get_reply(cookie);
     if (array.len == 0)
     {
-        cairo_surface_array_wipe(&array);
+        draw_icon_array_wipe(&array);
         return;
     }
     c->have_ewmh_icon = true;
@@ -281,9 +282,9 @@ property_update_net_wm_icon(client_t *c, xcb_get_property_cookie_t cookie)
 }
 
 xcb_get_property_cookie_t
-property_get_net_wm_pid(client_t *c)
+property_get_net_wm_pid(xcb_window_t window)
 {
-    return xcb_get_property_unchecked(globalconf.connection, false, c->window, _NET_WM_PID, XCB_ATOM_CARDINAL, 0L, 1L);
+    return xcb_get_property_unchecked(globalconf.connection, false, window, _NET_WM_PID, XCB_ATOM_CARDINAL, 0L, 1L);
 }
 
 void
@@ -291,7 +292,7 @@ property_update_net_wm_pid(client_t *c, xcb_get_property_cookie_t cookie)
 {
     xcb_get_property_reply_t *reply;
 
-    reply = xcb_get_property_reply(globalconf.connection, cookie, NULL);
+    reply = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, cookie, NULL));
 
     if(reply && reply->value_len)
     {
@@ -309,9 +310,9 @@ property_update_net_wm_pid(client_t *c, xcb_get_property_cookie_t cookie)
 }
 
 xcb_get_property_cookie_t
-property_get_motif_wm_hints(client_t *c)
+property_get_motif_wm_hints(xcb_window_t window)
 {
-    return xcb_get_property_unchecked(globalconf.connection, false, c->window, _MOTIF_WM_HINTS, _MOTIF_WM_HINTS, 0L, 5L);
+    return xcb_get_property_unchecked(globalconf.connection, false, window, _MOTIF_WM_HINTS, _MOTIF_WM_HINTS, 0L, 5L);
 }
 
 void
@@ -324,7 +325,7 @@ property_update_motif_wm_hints(client_t *c, xcb_get_property_cookie_t cookie)
     /* Clear the hints */
     p_clear(&hints, 1);
 
-    reply = xcb_get_property_reply(globalconf.connection, cookie, NULL);
+    reply = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, cookie, NULL));
 
     if(reply && reply->value_len == 5)
     {
@@ -344,10 +345,10 @@ property_update_motif_wm_hints(client_t *c, xcb_get_property_cookie_t cookie)
 }
 
 xcb_get_property_cookie_t
-property_get_wm_protocols(client_t *c)
+property_get_wm_protocols(xcb_window_t window)
 {
     return xcb_icccm_get_wm_protocols_unchecked(globalconf.connection,
-						c->window, WM_PROTOCOLS);
+						window, WM_PROTOCOLS);
 }
 
 /** Update the list of supported protocols for a client.
@@ -360,9 +361,9 @@ property_update_wm_protocols(client_t *c, xcb_get_property_cookie_t cookie)
     xcb_icccm_get_wm_protocols_reply_t protocols;
 
     /* If this fails for any reason, we still got the old value */
-    if(!xcb_icccm_get_wm_protocols_reply(globalconf.connection,
+    if(!A_XCB_WAIT(xcb_icccm_get_wm_protocols_reply(globalconf.connection,
 					 cookie,
-					 &protocols, NULL))
+					 &protocols, NULL)))
         return;
 
     xcb_icccm_get_wm_protocols_reply_wipe(&c->protocols);
@@ -385,7 +386,7 @@ property_handle_xembed_info(uint8_t state,
             xcb_get_property(globalconf.connection, 0, window, _XEMBED_INFO,
                              XCB_GET_PROPERTY_TYPE_ANY, 0, 3);
         xcb_get_property_reply_t *propr =
-            xcb_get_property_reply(globalconf.connection, cookie, 0);
+            A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, cookie, 0));
         xembed_property_update(globalconf.connection, emwin,
                                globalconf.timestamp, propr);
         p_delete(&propr);
@@ -435,7 +436,6 @@ property_handle_propertynotify_xproperty(xcb_property_notify_event_t *ev)
     lua_State *L = globalconf_get_lua_State();
     xproperty_t *prop;
     xproperty_t lookup = { .atom = ev->atom };
-    buffer_t buf;
     void *obj;
 
     prop = xproperty_array_lookup(&globalconf.xproperties, &lookup);
@@ -453,19 +453,86 @@ property_handle_propertynotify_xproperty(xcb_property_notify_event_t *ev)
     } else
         obj = NULL;
 
-    /* Get us the name of the property */
-    buffer_inita(&buf, a_strlen(prop->name) + a_strlen("xproperty::") + 1);
-    buffer_addf(&buf, "xproperty::%s", prop->name);
-
     /* And emit the right signal */
     if (obj)
     {
         luaA_object_push(L, obj);
-        luaA_object_emit_signal(L, -1, buf.s, 0);
+        luaA_object_emit_signal_id(L, -1, prop->signal_id, 0);
         lua_pop(L, 1);
     } else
-        signal_object_emit(L, &global_signals, buf.s, 0);
-    buffer_wipe(&buf);
+        signal_object_emit_id(L, &global_signals, prop->signal_id, 0);
+}
+
+typedef void (*property_handler_t)(uint8_t state, xcb_window_t window);
+
+/** The atoms we watch and their handlers */
+#define PROPERTY_HANDLERS(HANDLE) \
+    /* Xembed stuff */ \
+    HANDLE(_XEMBED_INFO, property_handle_xembed_info) \
+ \
+    /* ICCCM stuff */ \
+    HANDLE(XCB_ATOM_WM_TRANSIENT_FOR, property_handle_wm_transient_for) \
+    HANDLE(WM_CLIENT_LEADER, property_handle_wm_client_leader) \
+    HANDLE(XCB_ATOM_WM_NORMAL_HINTS, property_handle_wm_normal_hints) \
+    HANDLE(XCB_ATOM_WM_HINTS, property_handle_wm_hints) \
+    HANDLE(XCB_ATOM_WM_NAME, property_handle_wm_name) \
+    HANDLE(XCB_ATOM_WM_ICON_NAME, property_handle_wm_icon_name) \
+    HANDLE(XCB_ATOM_WM_CLASS, property_handle_wm_class) \
+    HANDLE(WM_PROTOCOLS, property_handle_wm_protocols) \
+    HANDLE(XCB_ATOM_WM_CLIENT_MACHINE, property_handle_wm_client_machine) \
+    HANDLE(WM_WINDOW_ROLE, property_handle_wm_window_role) \
+ \
+    /* EWMH stuff */ \
+    HANDLE(_NET_WM_NAME, property_handle_net_wm_name) \
+    HANDLE(_NET_WM_ICON_NAME, property_handle_net_wm_icon_name) \
+    HANDLE(_NET_WM_STRUT_PARTIAL, property_handle_net_wm_strut_partial) \
+    HANDLE(_NET_WM_ICON, property_handle_net_wm_icon) \
+    HANDLE(_NET_WM_PID, property_handle_net_wm_pid) \
+    HANDLE(_NET_WM_WINDOW_OPACITY, property_handle_net_wm_opacity) \
+ \
+    /* MOTIF hints */ \
+    HANDLE(_MOTIF_WM_HINTS, property_handle_motif_wm_hints) \
+ \
+    /* background change */ \
+    HANDLE(_XROOTPMAP_ID, property_handle_xrootpmap_id) \
+ \
+    /* selection transfers */ \
+    HANDLE(AWESOME_SELECTION_ATOM, property_handle_awesome_selection_atom)
+
+/** The handlers for the atoms we watch, sorted by atom once the atoms are
+ * known */
+static struct
+{
+    xcb_atom_t atom;
+    property_handler_t handler;
+} property_handlers[] =
+{
+#define HANDLE(atom_, cb) { XCB_NONE, cb },
+    PROPERTY_HANDLERS(HANDLE)
+#undef HANDLE
+};
+
+static int
+property_handler_cmp(const void *a, const void *b)
+{
+    const xcb_atom_t *x = a, *y = b;
+    return *x > *y ? 1 : (*x < *y ? -1 : 0);
+}
+
+/** Build the atom to handler table. Must be called after atoms_init().
+ */
+void
+property_handlers_init(void)
+{
+    int n = 0;
+
+    /* Same order as the initializer above */
+#define HANDLE(atom_, cb) property_handlers[n++].atom = atom_;
+    PROPERTY_HANDLERS(HANDLE)
+#undef HANDLE
+
+    qsort(property_handlers, countof(property_handlers), sizeof(*property_handlers),
+          property_handler_cmp);
 }
 
 /** The property notify event handler.
@@ -474,61 +541,18 @@ property_handle_propertynotify_xproperty(xcb_property_notify_event_t *ev)
 void
 property_handle_propertynotify(xcb_property_notify_event_t *ev)
 {
-    void (*handler)(uint8_t state,
-                   xcb_window_t window) = NULL;
-
     globalconf.timestamp = ev->time;
 
     property_handle_propertynotify_xproperty(ev);
     selection_transfer_handle_propertynotify(ev);
 
     /* Find the correct event handler */
-#define HANDLE(atom_, cb) \
-    if (ev->atom == atom_) \
-    { \
-        handler = cb; \
-    } else
-#define END return
-
-    /* Xembed stuff */
-    HANDLE(_XEMBED_INFO, property_handle_xembed_info)
-
-    /* ICCCM stuff */
-    HANDLE(XCB_ATOM_WM_TRANSIENT_FOR, property_handle_wm_transient_for)
-    HANDLE(WM_CLIENT_LEADER, property_handle_wm_client_leader)
-    HANDLE(XCB_ATOM_WM_NORMAL_HINTS, property_handle_wm_normal_hints)
-    HANDLE(XCB_ATOM_WM_HINTS, property_handle_wm_hints)
-    HANDLE(XCB_ATOM_WM_NAME, property_handle_wm_name)
-    HANDLE(XCB_ATOM_WM_ICON_NAME, property_handle_wm_icon_name)
-    HANDLE(XCB_ATOM_WM_CLASS, property_handle_wm_class)
-    HANDLE(WM_PROTOCOLS, property_handle_wm_protocols)
-    HANDLE(XCB_ATOM_WM_CLIENT_MACHINE, property_handle_wm_client_machine)
-    HANDLE(WM_WINDOW_ROLE, property_handle_wm_window_role)
-
-    /* EWMH stuff */
-    HANDLE(_NET_WM_NAME, property_handle_net_wm_name)
-    HANDLE(_NET_WM_ICON_NAME, property_handle_net_wm_icon_name)
-    HANDLE(_NET_WM_STRUT_PARTIAL, property_handle_net_wm_strut_partial)
-    HANDLE(_NET_WM_ICON, property_handle_net_wm_icon)
-    HANDLE(_NET_WM_PID, property_handle_net_wm_pid)
-    HANDLE(_NET_WM_WINDOW_OPACITY, property_handle_net_wm_opacity)
-
-    /* MOTIF hints */
-    HANDLE(_MOTIF_WM_HINTS, property_handle_motif_wm_hints)
-
-    /* background change */
-    HANDLE(_XROOTPMAP_ID, property_handle_xrootpmap_id)
-
-    /* selection transfers */
-    HANDLE(AWESOME_SELECTION_ATOM, property_handle_awesome_selection_atom)
-
-    /* If nothing was found, return */
-    END;
-
-#undef HANDLE
-#undef END
+    typeof(*property_handlers) *found =
+        bsearch(&ev->atom, property_handlers, countof(property_handlers),
+                sizeof(*property_handlers), property_handler_cmp);
 
-    (*handler)(ev->state, ev->window);
+    if(found)
+        found->handler(ev->state, ev->window);
 }
 
 /** Register a new xproperty.
@@ -557,10 +581,10 @@ luaA_register_xproperty(lua_State *L)
     else
         property.type = PROP_BOOLEAN;
 
-    atom_r = xcb_intern_atom_reply(globalconf.connection,
+    atom_r = A_XCB_WAIT(xcb_intern_atom_reply(globalconf.connection,
                                    xcb_intern_atom_unchecked(globalconf.connection, false,
                                                              a_strlen(name), name),
-                                   NULL);
+                                   NULL));
     if(!atom_r)
         return 0;
 
@@ -577,6 +601,10 @@ luaA_register_xproperty(lua_State *L)
     else
     {
         property.name = a_strdup(name);
+        /* Hash the signal name once instead of on every PropertyNotify */
+        lua_pushfstring(L, "xproperty::%s", name);
+        property.signal_id = signal_id(lua_tostring(L, -1));
+        lua_pop(L, 1);
         xproperty_array_insert(&globalconf.xproperties, property);
     }
 
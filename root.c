@@ -35,6 +35,7 @@
 #include "xwindow.h"
 
 #include "math.h"
+#include "stats.h"
 
 #include <xcb/xtest.h>
 #include <xcb/xcb_aux.h>
@@ -68,7 +69,7 @@ root_set_wallpaper_pixmap(xcb_connection_t *c, xcb_pixmap_t p)
     xcb_change_property(c, XCB_PROP_MODE_REPLACE, screen->root, ESETROOT_PMAP_ID, XCB_ATOM_PIXMAP, 32, 1, &p);
 
     /* Now make sure that the old wallpaper is freed (but only do this for ESETROOT_PMAP_ID) */
-    prop_r = xcb_get_property_reply(c, prop_c, NULL);
+    prop_r = A_XCB_WAIT(xcb_get_property_reply(c, prop_c, NULL));
     if (prop_r && prop_r->value_len)
     {
         xcb_pixmap_t *rootpix = xcb_get_property_value(prop_r);
@@ -78,47 +79,170 @@ root_set_wallpaper_pixmap(xcb_connection_t *c, xcb_pixmap_t p)
     p_delete(&prop_r);
 }
 
+/** A wallpaper update for one area of the root window. */
+typedef struct
+{
+    /** What to paint, or NULL if image already has the right content */
+    cairo_pattern_t *pattern;
+    /** Image surface of the area's size that pattern is rendered to, or NULL
+     * if pattern is painted straight into the root pixmap */
+    cairo_surface_t *image;
+    /** Where on the root window the image goes */
+    area_t area;
+} wallpaper_job_t;
+
+/** The wallpaper pipeline. Jobs are rendered in order by a single worker
+ * thread and handed back to the main loop for uploading.
+ */
+static struct
+{
+    /** The worker */
+    GThreadPool *pool;
+    /** Rendered jobs waiting for the main loop */
+    GAsyncQueue *done;
+    /** Jobs that were queued, but not uploaded yet */
+    unsigned int queued;
+    /** The root pixmap that we created and still own, or XCB_NONE */
+    xcb_pixmap_t pixmap;
+    uint16_t width, height;
+} wallpaper_pipeline;
+
+static void
+root_wallpaper_job_delete(wallpaper_job_t *job)
+{
+    if (job->pattern)
+        cairo_pattern_destroy(job->pattern);
+    cairo_surface_destroy(job->image);
+    p_delete(&job);
+}
+
+static void
+root_wallpaper_render(wallpaper_job_t *job)
+{
+    if (!job->pattern || !job->image)
+        return;
+
+    cairo_t *cr = cairo_create(job->image);
+    cairo_set_source(cr, job->pattern);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    cairo_surface_flush(job->image);
+
+    /* Let go of the sources while still on the worker */
+    cairo_pattern_destroy(job->pattern);
+    job->pattern = NULL;
+}
+
+/** Can the pattern be painted from another thread? Only image and recording
+ * surfaces are, X11 surfaces share the main connection with everything else.
+ */
 static bool
-root_set_wallpaper(cairo_pattern_t *pattern)
+root_wallpaper_can_render_async(cairo_pattern_t *pattern)
+{
+    cairo_surface_t *surface;
+
+    /* Solid colours and gradients */
+    if (cairo_pattern_get_surface(pattern, &surface) != CAIRO_STATUS_SUCCESS)
+        return true;
+
+    switch (cairo_surface_get_type(surface))
+    {
+      case CAIRO_SURFACE_TYPE_IMAGE:
+      case CAIRO_SURFACE_TYPE_RECORDING:
+        return true;
+      default:
+        return false;
+    }
+}
+
+/** Can the pattern be painted without any image data? The X server can fill
+ * with solid colours and gradients itself, which is much cheaper than
+ * uploading a root-sized image.
+ */
+static bool
+root_wallpaper_is_server_side(cairo_pattern_t *pattern)
+{
+    switch (cairo_pattern_get_type(pattern))
+    {
+      case CAIRO_PATTERN_TYPE_SOLID:
+      case CAIRO_PATTERN_TYPE_LINEAR:
+      case CAIRO_PATTERN_TYPE_RADIAL:
+        return true;
+      default:
+        return false;
+    }
+}
+
+/** Is the pattern just the given image, painted as it is? */
+static bool
+root_wallpaper_is_image(cairo_pattern_t *pattern, cairo_surface_t *image)
+{
+    cairo_surface_t *surface;
+    cairo_matrix_t m;
+
+    if (cairo_pattern_get_surface(pattern, &surface) != CAIRO_STATUS_SUCCESS
+        || surface != image)
+        return false;
+
+    cairo_pattern_get_matrix(pattern, &m);
+    return m.xx == 1 && m.yx == 0 && m.xy == 0 && m.yy == 1 && m.x0 == 0 && m.y0 == 0;
+}
+
+/** Make sure the root window has a pixmap of its size that we own, so that
+ * updates can be drawn straight into it. This needs round trips, but only
+ * happens once and after the root window was resized or someone else set
+ * the wallpaper.
+ * \return true if globalconf.wallpaper can be drawn to.
+ */
+static bool
+root_wallpaper_ensure_pixmap(void)
 {
-    lua_State *L = globalconf_get_lua_State();
-    xcb_connection_t *c = xcb_connect(NULL, NULL);
-    xcb_pixmap_t p = xcb_generate_id(c);
-    /* globalconf.connection should be connected to the same X11 server, so we
-     * can just use the info from that other connection.
-     */
     const xcb_screen_t *screen = globalconf.screen;
     uint16_t width = screen->width_in_pixels;
     uint16_t height = screen->height_in_pixels;
-    bool result = false;
+
+    if (wallpaper_pipeline.pixmap != XCB_NONE && globalconf.wallpaper
+        && wallpaper_pipeline.width == width && wallpaper_pipeline.height == height)
+        return true;
+
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_pixmap_t p = xcb_generate_id(c);
     cairo_surface_t *surface;
     cairo_t *cr;
 
     if (xcb_connection_has_error(c))
-        goto disconnect;
+    {
+        xcb_disconnect(c);
+        return false;
+    }
 
     /* Create a pixmap and make sure it is already created, because we are going
      * to use it from the other X11 connection (Juggling with X11 connections
      * is a really, really bad idea).
      */
     xcb_create_pixmap(c, screen->root_depth, p, screen->root, width, height);
-    xcb_aux_sync(c);
+    A_XCB_SYNC(c);
 
-    /* Now paint to the picture from the main connection so that cairo sees that
-     * it can tell the X server to copy between the (possible) old pixmap and
-     * the new one directly and doesn't need GetImage and PutImage.
+    /* Start from the old wallpaper, so that areas that are not updated keep
+     * their content. Painting from the main connection lets cairo copy
+     * between the pixmaps on the server.
      */
     surface = cairo_xcb_surface_create(globalconf.connection, p, draw_default_visual(screen), width, height);
     cr = cairo_create(surface);
-    /* Paint the pattern to the surface */
-    cairo_set_source(cr, pattern);
     cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    if (globalconf.wallpaper)
+        cairo_set_source_surface(cr, globalconf.wallpaper, 0, 0);
+    else
+        cairo_set_source_rgb(cr, 0, 0, 0);
     cairo_paint(cr);
     cairo_destroy(cr);
     cairo_surface_flush(surface);
-    xcb_aux_sync(globalconf.connection);
 
-    /* Change the wallpaper, without sending us a PropertyNotify event */
+    /* Change the wallpaper, without sending us a PropertyNotify event. The
+     * requests above are on the same connection, so the old pixmap is copied
+     * before it gets killed.
+     */
     xcb_grab_server(globalconf.connection);
     xcb_change_window_attributes(globalconf.connection,
                                  globalconf.screen->root,
@@ -133,17 +257,170 @@ root_set_wallpaper(cairo_pattern_t *pattern)
 
     /* Make sure our pixmap is not destroyed when we disconnect. */
     xcb_set_close_down_mode(c, XCB_CLOSE_DOWN_RETAIN_PERMANENT);
+    A_XCB_SYNC(c);
+    xcb_disconnect(c);
 
-    /* Tell Lua that the wallpaper changed */
     cairo_surface_destroy(globalconf.wallpaper);
     globalconf.wallpaper = surface;
+    wallpaper_pipeline.pixmap = p;
+    wallpaper_pipeline.width = width;
+    wallpaper_pipeline.height = height;
+
+    return true;
+}
+
+/** Copy a rendered job into the root pixmap.
+ * \return true if the wallpaper changed.
+ */
+static bool
+root_wallpaper_upload(wallpaper_job_t *job)
+{
+    if (job->image && cairo_surface_status(job->image) != CAIRO_STATUS_SUCCESS)
+        return false;
+
+    if (!root_wallpaper_ensure_pixmap())
+        return false;
+
+    cairo_t *cr = cairo_create(globalconf.wallpaper);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_translate(cr, job->area.x, job->area.y);
+    if (job->image)
+        cairo_set_source_surface(cr, job->image, 0, 0);
+    else
+        cairo_set_source(cr, job->pattern);
+    cairo_rectangle(cr, 0, 0, job->area.width, job->area.height);
+    cairo_fill(cr);
+    cairo_destroy(cr);
+    cairo_surface_flush(globalconf.wallpaper);
+
+    xcb_clear_area(globalconf.connection, 0, globalconf.screen->root,
+                   job->area.x, job->area.y, job->area.width, job->area.height);
+    return true;
+}
+
+/** Upload everything that the worker has finished. */
+static gboolean
+root_wallpaper_upload_pending(gpointer unused)
+{
+    lua_State *L = globalconf_get_lua_State();
+    wallpaper_job_t *job;
+    bool changed = false;
+
+    while ((job = g_async_queue_try_pop(wallpaper_pipeline.done)))
+    {
+        wallpaper_pipeline.queued--;
+        changed = root_wallpaper_upload(job) || changed;
+        root_wallpaper_job_delete(job);
+    }
+
+    if (!changed)
+        return G_SOURCE_REMOVE;
+
+    /* The pixmap stays the same, but pseudo-transparent clients only look at
+     * it again when the property is set. Again, we do not want to hear about
+     * that ourselves.
+     */
+    xcb_grab_server(globalconf.connection);
+    xcb_change_window_attributes(globalconf.connection,
+                                 globalconf.screen->root,
+                                 XCB_CW_EVENT_MASK,
+                                 (uint32_t[]) { 0 });
+    xcb_change_property(globalconf.connection, XCB_PROP_MODE_REPLACE,
+                        globalconf.screen->root, _XROOTPMAP_ID, XCB_ATOM_PIXMAP,
+                        32, 1, &wallpaper_pipeline.pixmap);
+    xcb_change_window_attributes(globalconf.connection,
+                                 globalconf.screen->root,
+                                 XCB_CW_EVENT_MASK,
+                                 ROOT_WINDOW_EVENT_MASK);
+    xutil_ungrab_server(globalconf.connection);
+
+    /* Tell Lua that the wallpaper changed */
     signal_object_emit(L, &global_signals, "wallpaper_changed", 0);
 
-    result = true;
-disconnect:
-    xcb_aux_sync(c);
-    xcb_disconnect(c);
-    return result;
+    return G_SOURCE_REMOVE;
+}
+
+static void
+root_wallpaper_worker(gpointer data, gpointer unused)
+{
+    root_wallpaper_render(data);
+    g_async_queue_push(wallpaper_pipeline.done, data);
+    g_idle_add(root_wallpaper_upload_pending, NULL);
+}
+
+/** Queue a wallpaper update. The pattern is rendered on a worker thread when
+ * possible and the result is uploaded from the main loop later, after which
+ * "wallpaper_changed" is emitted.
+ * \param pattern The pattern to paint, relative to the area.
+ * \param area The part of the root window to update.
+ * \param image An image surface of the area's size to render to, or NULL.
+ * \return true if the update was queued.
+ */
+static bool
+root_set_wallpaper(cairo_pattern_t *pattern, area_t area, cairo_surface_t *image)
+{
+    wallpaper_job_t *job;
+
+    if (area.width == 0 || area.height == 0)
+        return false;
+
+    if (!wallpaper_pipeline.pool)
+    {
+        /* One thread, so that jobs finish in the order they were queued */
+        if (!wallpaper_pipeline.done)
+            wallpaper_pipeline.done = g_async_queue_new();
+        wallpaper_pipeline.pool = g_thread_pool_new(root_wallpaper_worker, NULL,
+                                                    1, false, NULL);
+        if (!wallpaper_pipeline.pool)
+            return false;
+    }
+
+    if (image && (cairo_surface_get_type(image) != CAIRO_SURFACE_TYPE_IMAGE
+                  || cairo_image_surface_get_width(image) != area.width
+                  || cairo_image_surface_get_height(image) != area.height))
+        image = NULL;
+
+    job = p_new(wallpaper_job_t, 1);
+    job->area = area;
+    if (root_wallpaper_is_server_side(pattern))
+    {
+        /* Painted when uploading, no image needed */
+        job->pattern = cairo_pattern_reference(pattern);
+        wallpaper_pipeline.queued++;
+        g_thread_pool_push(wallpaper_pipeline.pool, job, NULL);
+        return true;
+    }
+
+    if (image)
+        job->image = cairo_surface_reference(image);
+    else
+        job->image = cairo_image_surface_create(CAIRO_FORMAT_RGB24, area.width, area.height);
+    if (!root_wallpaper_is_image(pattern, job->image))
+        job->pattern = cairo_pattern_reference(pattern);
+
+    /* Everything still goes through the worker to keep the order */
+    if (job->pattern && !root_wallpaper_can_render_async(pattern))
+        root_wallpaper_render(job);
+
+    wallpaper_pipeline.queued++;
+    g_thread_pool_push(wallpaper_pipeline.pool, job, NULL);
+    return true;
+}
+
+/** Wait for queued wallpaper updates and upload them. This blocks and stops
+ * the worker, so it is only meant to be called on exit.
+ */
+void
+root_wallpaper_flush(void)
+{
+    if (!wallpaper_pipeline.pool)
+        return;
+
+    /* Idle sources that the worker added may still be around, so the queue
+     * has to stay. */
+    g_thread_pool_free(wallpaper_pipeline.pool, false, true);
+    wallpaper_pipeline.pool = NULL;
+    root_wallpaper_upload_pending(NULL);
 }
 
 void
@@ -160,7 +437,7 @@ root_update_wallpaper(void)
 
     prop_c = xcb_get_property_unchecked(globalconf.connection, false,
             globalconf.screen->root, _XROOTPMAP_ID, XCB_ATOM_PIXMAP, 0, 1);
-    prop_r = xcb_get_property_reply(globalconf.connection, prop_c, NULL);
+    prop_r = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, prop_c, NULL));
 
     if (!prop_r || !prop_r->value_len)
     {
@@ -175,8 +452,12 @@ root_update_wallpaper(void)
         return;
     }
 
+    /* Someone else set a wallpaper, the next update needs a new pixmap */
+    if (*rootpix != wallpaper_pipeline.pixmap)
+        wallpaper_pipeline.pixmap = XCB_NONE;
+
     geom_c = xcb_get_geometry_unchecked(globalconf.connection, *rootpix);
-    geom_r = xcb_get_geometry_reply(globalconf.connection, geom_c, NULL);
+    geom_r = A_XCB_WAIT(xcb_get_geometry_reply(globalconf.connection, geom_c, NULL));
     if (!geom_r)
     {
         p_delete(&prop_r);
@@ -471,18 +752,49 @@ luaA_root_drawins(lua_State *L)
 }
 
 /** Get the wallpaper as a cairo surface or set it as a cairo pattern.
+ *
+ * Setting the wallpaper does not block. The pattern is rendered on a worker
+ * thread if it only uses image or recording surfaces, then uploaded from the
+ * main loop. Solid colours and gradients are painted by the X server instead.
+ * `wallpaper_changed` is emitted once that happened. The pattern and its
+ * surfaces must not be modified until then. Getting the wallpaper does not
+ * wait, so the result does not include updates that are still queued.
  *
  * @param pattern A cairo pattern as light userdata
- * @return A cairo surface or nothing.
+ * @tparam[opt] table geometry The part of the root window to update, with the
+ *   `x`, `y`, `width` and `height` keys. The pattern is painted relative to it.
+ *   The default is the whole root window.
+ * @param[opt] image A RGB24 cairo image surface of the geometry's size as light
+ *   userdata to render to. If the pattern is just this surface, it is
+ *   uploaded without rendering.
+ * @return A cairo surface or nothing when getting the wallpaper, whether the
+ *   update was queued when setting it.
  * @staticfct wallpaper
  */
 static int
 luaA_root_wallpaper(lua_State *L)
 {
-    if(lua_gettop(L) == 1)
+    if(lua_gettop(L) >= 1)
     {
-        cairo_pattern_t *pattern = (cairo_pattern_t *)lua_touserdata(L, -1);
-        lua_pushboolean(L, root_set_wallpaper(pattern));
+        cairo_pattern_t *pattern = (cairo_pattern_t *)lua_touserdata(L, 1);
+        cairo_surface_t *image = (cairo_surface_t *)lua_touserdata(L, 3);
+        area_t area = {
+            .x = 0,
+            .y = 0,
+            .width = globalconf.screen->width_in_pixels,
+            .height = globalconf.screen->height_in_pixels
+        };
+
+        if(!lua_isnoneornil(L, 2))
+        {
+            luaA_checktable(L, 2);
+            area.x = luaA_getopt_integer_range(L, 2, "x", area.x, MIN_X11_COORDINATE, MAX_X11_COORDINATE);
+            area.y = luaA_getopt_integer_range(L, 2, "y", area.y, MIN_X11_COORDINATE, MAX_X11_COORDINATE);
+            area.width = luaA_getopt_integer_range(L, 2, "width", area.width, 0, MAX_X11_SIZE);
+            area.height = luaA_getopt_integer_range(L, 2, "height", area.height, 0, MAX_X11_SIZE);
+        }
+
+        lua_pushboolean(L, pattern && root_set_wallpaper(pattern, area, image));
         /* Don't return the wallpaper, it's too easy to get memleaks */
         return 1;
     }
@@ -495,6 +807,20 @@ luaA_root_wallpaper(lua_State *L)
     return 1;
 }
 
+/** Get the number of wallpaper updates that were queued, but not uploaded
+ * yet. Updates are uploaded in the order they were queued, so this tells
+ * which images the worker may still be painting.
+ *
+ * @treturn integer The number of queued updates.
+ * @staticfct _wallpaper_queued
+ */
+static int
+luaA_root_wallpaper_queued(lua_State *L)
+{
+    lua_pushinteger(L, wallpaper_pipeline.queued);
+    return 1;
+}
+
 /** Get the size of the root window.
  *
  * @return Width of the root window.
@@ -603,6 +929,7 @@ const struct luaL_Reg awesome_root_methods[] =
     { "fake_input", luaA_root_fake_input },
     { "drawins", luaA_root_drawins },
     { "wallpaper", luaA_root_wallpaper },
+    { "_wallpaper_queued", luaA_root_wallpaper_queued },
     { "size", luaA_root_size },
     { "size_mm", luaA_root_size_mm },
     { "tags", luaA_root_tags },
@@ -31,6 +31,7 @@
 #include "common/atoms.h"
 #include "event.h"
 #include "xwindow.h"
+#include "stats.h"
 
 #include <xcb/xcb_atom.h>
 #include <xcb/xcb_event.h>
@@ -109,8 +110,8 @@ luaA_selection_get(lua_State *L)
 					    event_notify->requestor,
 					    event_notify->property);
 
-            if(xcb_icccm_get_text_property_reply(globalconf.connection,
-						 cookie, &prop, NULL))
+            if(A_XCB_WAIT(xcb_icccm_get_text_property_reply(globalconf.connection,
+						 cookie, &prop, NULL)))
 	      {
                 lua_pushlstring(L, prop.name, prop.name_len);
 
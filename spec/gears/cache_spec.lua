@@ -4,6 +4,7 @@
 ---------------------------------------------------------------------------
 
 local cache = require("gears.cache")
+local unpack = unpack or table.unpack -- luacheck: globals unpack (compatibility with Lua 5.1)
 
 describe("gears.cache", function()
     -- Make sure no cache is cleared during the tests
@@ -56,6 +57,79 @@ describe("gears.cache", function()
             assert.is.equal(num_calls, 2)
         end)
     end)
+
+    describe("Bounded", function()
+        local num_calls, c
+        before_each(function()
+            num_calls = 0
+            c = cache(function(...)
+                num_calls = num_calls + 1
+                return select("#", ...), ...
+            end, 2)
+        end)
+
+        it("Removes the least recently used entry", function()
+            c:get(1)
+            c:get(2)
+            c:get(1)
+            c:get(3)
+            assert.is.equal(num_calls, 3)
+            c:get(1)
+            c:get(3)
+            assert.is.equal(num_calls, 3)
+            c:get(2)
+            assert.is.equal(num_calls, 4)
+        end)
+
+        it("Keeps entries during garbage collection", function()
+            c:get(1, 2)
+            collectgarbage("collect")
+            c:get(1, 2)
+            assert.is.equal(num_calls, 1)
+        end)
+
+        it("Distinguishes its arguments", function()
+            local t1, t2 = {}, {}
+            c = cache(function(...)
+                num_calls = num_calls + 1
+                return select("#", ...), ...
+            end, 20)
+            local keys = {
+                { n = 1, 1 }, { n = 1, "1" }, { n = 2, 1, nil }, { n = 2, nil, 1 },
+                { n = 1, "a|b" }, { n = 2, "a", "b" }, { n = 1, t1 }, { n = 1, t2 },
+                { n = 2, t1, 1 }, { n = 1, true }, { n = 1, false }, { n = 0 },
+            }
+            for _, key in ipairs(keys) do
+                local res = { c:get(unpack(key, 1, key.n)) }
+                assert.is.equal(key.n, res[1])
+                for i = 1, key.n do
+                    assert.is.equal(key[i], res[i + 1])
+                end
+            end
+            assert.is.equal(num_calls, #keys)
+            for _, key in ipairs(keys) do
+                c:get(unpack(key, 1, key.n))
+            end
+            assert.is.equal(num_calls, #keys)
+        end)
+
+        it("Counts hits, misses and evictions", function()
+            c:get(1)
+            c:get(1)
+            c:get(2)
+            c:get(3)
+            assert.is.same({ hits = 1, misses = 3, evictions = 1, entries = 2, max_entries = 2 },
+                c:stats())
+        end)
+
+        it("Can be cleared", function()
+            c:get(1)
+            c:clear()
+            c:get(1)
+            assert.is.equal(num_calls, 2)
+            assert.is.equal(c:stats().entries, 1)
+        end)
+    end)
 end)
 
 -- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
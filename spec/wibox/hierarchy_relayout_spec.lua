@@ -0,0 +1,140 @@
+---------------------------------------------------------------------------
+-- Test that only the changed part of a wibar-like hierarchy is laid out again
+-- and that the result is the same as a full relayout.
+--
+-- @author Awesome Team
+-- @copyright 2026 Awesome Team
+---------------------------------------------------------------------------
+
+require("wibox.test_utils")
+local hierarchy = require("wibox.hierarchy")
+local base = require("wibox.widget.base")
+local fixed = require("wibox.layout.fixed")
+local align = require("wibox.layout.align")
+local margin = require("wibox.container.margin")
+local matrix = require("gears.matrix")
+
+local widgets_per_side = 40
+-- Wide enough for all widgets
+local bar_width, bar_height = 5000, 20
+
+-- Something like a textbox, with a width that depends on its text
+local function text_widget(text)
+    local w = base.make_widget()
+    w._private.text = text
+    function w:fit()
+        return 6 * #self._private.text, 16
+    end
+    function w:set_text(new)
+        self._private.text = new
+        self:emit_signal("widget::layout_changed")
+    end
+    return w
+end
+
+-- Returns the bar and the text widgets
+local function make_bar()
+    local texts = {}
+    local left, right = fixed.horizontal(), fixed.horizontal()
+    local bar = align.horizontal(left, nil, right)
+    for i = 1, widgets_per_side do
+        local l, r = text_widget("left " .. i), text_widget("right " .. i)
+        local lm, rm = margin(l, 2, 2), margin(r, 2, 2)
+        left:add(lm)
+        right:add(rm)
+        table.insert(texts, l)
+        table.insert(texts, r)
+    end
+    return bar, texts
+end
+
+local function total_widgets(h)
+    local count = 1
+    for _, child in ipairs(h:get_children()) do
+        count = count + total_widgets(child)
+    end
+    return count
+end
+
+describe("wibox.hierarchy relayout", function()
+    local context, bar, texts, instance
+    before_each(function()
+        local function nop() end
+        context = {}
+        bar, texts = make_bar()
+        instance = hierarchy.new(context, bar, bar_width, bar_height, nop, nop)
+    end)
+
+    it("lays out everything initially", function()
+        assert.is.equal(total_widgets(instance), instance:get_relayout_count())
+    end)
+
+    it("only lays out a widget whose size stays the same", function()
+        -- "left 11"
+        local text = texts[21]
+        text:set_text("left 99")
+        instance:update(context, bar, bar_width, bar_height)
+        assert.is.equal(1, instance:get_relayout_count())
+    end)
+
+    it("stops at the first parent whose size stays the same", function()
+        -- The last widget on the left grows: it, its margin, the left fixed
+        -- layout and the bar need a new layout. Nothing else moves.
+        local text = texts[#texts - 1]
+        text:set_text("a longer text")
+        instance:update(context, bar, bar_width, bar_height)
+        assert.is.equal(4, instance:get_relayout_count())
+    end)
+
+    it("gives the same result as a full relayout", function()
+        texts[5]:set_text("something else")
+        texts[6]:set_text("x")
+        instance:update(context, bar, bar_width, bar_height)
+
+        local function nop() end
+        local full = hierarchy.new(context, bar, bar_width, bar_height, nop, nop)
+        local function compare(a, b)
+            assert.is.equal(a:get_widget(), b:get_widget())
+            assert.is.same({ a:get_size() }, { b:get_size() })
+            assert.is.same({ a:get_draw_extents() }, { b:get_draw_extents() })
+            assert.is_true(matrix.equals(a:get_matrix_to_device(), b:get_matrix_to_device()))
+            assert.is.equal(#a:get_children(), #b:get_children())
+            for i, child in ipairs(a:get_children()) do
+                compare(child, b:get_children()[i])
+            end
+        end
+        compare(instance, full)
+    end)
+
+    it("lays out every hierarchy that shows a changed widget", function()
+        -- Like a text clock that is on every screen's wibar
+        local function nop() end
+        local clock = text_widget("clock")
+        local bars = {}
+        for i = 1, 2 do
+            local layout = fixed.horizontal(clock, text_widget("after"))
+            local ctx = {}
+            bars[i] = {
+                context = ctx,
+                layout = layout,
+                hierarchy = hierarchy.new(ctx, layout, bar_width, bar_height, nop, nop),
+            }
+        end
+
+        clock:set_text("a longer clock")
+        for _, b in ipairs(bars) do
+            b.hierarchy:update(b.context, b.layout, bar_width, bar_height)
+        end
+
+        local width = 6 * #"a longer clock"
+        for _, b in ipairs(bars) do
+            -- The clock, its layout and the widget that moved
+            assert.is.equal(3, b.hierarchy:get_relayout_count())
+            local children = b.hierarchy:get_children()
+            assert.is.same({ width, bar_height }, { children[1]:get_size() })
+            assert.is.equal(width, children[2]:get_matrix_to_parent().x0)
+        end
+    end)
+end)
+
+-- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
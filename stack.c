@@ -69,6 +69,56 @@ stack_windows(void)
     need_stack_refresh = true;
 }
 
+/** Stacking layout layers */
+typedef enum
+{
+    /** This one is a special layer */
+    WINDOW_LAYER_IGNORE,
+    WINDOW_LAYER_DESKTOP,
+    WINDOW_LAYER_BELOW,
+    WINDOW_LAYER_NORMAL,
+    WINDOW_LAYER_ABOVE,
+    WINDOW_LAYER_FULLSCREEN,
+    WINDOW_LAYER_ONTOP,
+    /** This one only used for counting and is not a real layer */
+    WINDOW_LAYER_COUNT
+} window_layer_t;
+
+/** A window in the stacking order computed by stack_refresh() */
+typedef struct
+{
+    /** The client or drawin */
+    window_t *object;
+    /** The window that gets stacked */
+    xcb_window_t window;
+    /** Position in the last committed order, -1 if it was not part of it */
+    int old_index;
+    /** True if the window is already at the right place relative to the
+     * other windows that stay */
+    bool in_place;
+} stack_entry_t;
+
+DO_ARRAY(stack_entry_t, stack_entry, DO_NOTHING)
+
+/** A transient relation, sorted by parent and then stack position */
+typedef struct
+{
+    client_t *parent;
+    int position;
+    client_t *child;
+} stack_transient_t;
+
+DO_ARRAY(stack_transient_t, stack_transient, DO_NOTHING)
+
+/** The order being computed, reused between refreshes */
+static stack_entry_array_t stack_order;
+/** Index of transient children, rebuilt on every refresh */
+static stack_transient_array_t stack_transients;
+/** Clients of globalconf.stack, bucketed by layer */
+static client_array_t stack_layers[WINDOW_LAYER_COUNT];
+/** Generation of the last committed order, 0 means none yet */
+static unsigned int stack_generation;
+
 /** Stack a window above another window, without causing errors.
  * \param w The window.
  * \param previous The window which should be below this window.
@@ -87,40 +137,83 @@ stack_window_above(xcb_window_t w, xcb_window_t previous)
                          (uint32_t[]) { previous, XCB_STACK_MODE_ABOVE });
 }
 
-/** Stack a client above.
- * \param c The client.
- * \param previous The previous client on the stack.
- * \return The next-previous!
+/** Stack a window below another window, without causing errors.
+ * \param w The window.
+ * \param next The window which should be above this window.
  */
-static xcb_window_t
-stack_client_above(client_t *c, xcb_window_t previous)
+static void
+stack_window_below(xcb_window_t w, xcb_window_t next)
 {
-    stack_window_above(c->frame_window, previous);
+    if (next == XCB_NONE)
+        return;
 
-    previous = c->frame_window;
+    xcb_configure_window(globalconf.connection, w,
+                         XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE,
+                         (uint32_t[]) { next, XCB_STACK_MODE_BELOW });
+}
 
-    /* stack transient window on top of their parents */
-    foreach(node, globalconf.stack)
-        if((*node)->transient_for == c)
-            previous = stack_client_above(*node, previous);
+/** Append a window to the order being computed.
+ * \param object The client or drawin.
+ * \param w The window that gets stacked.
+ */
+static void
+stack_order_append(window_t *object, xcb_window_t w)
+{
+    stack_entry_t entry =
+    {
+        .object = object,
+        .window = w,
+        .old_index = -1
+    };
+
+    if(stack_generation != 0 && object->stack_generation == stack_generation)
+        entry.old_index = object->stack_index;
 
-    return previous;
+    stack_entry_array_append(&stack_order, entry);
 }
 
-/** Stacking layout layers */
-typedef enum
+static int
+stack_transient_cmp(const void *a, const void *b)
 {
-    /** This one is a special layer */
-    WINDOW_LAYER_IGNORE,
-    WINDOW_LAYER_DESKTOP,
-    WINDOW_LAYER_BELOW,
-    WINDOW_LAYER_NORMAL,
-    WINDOW_LAYER_ABOVE,
-    WINDOW_LAYER_FULLSCREEN,
-    WINDOW_LAYER_ONTOP,
-    /** This one only used for counting and is not a real layer */
-    WINDOW_LAYER_COUNT
-} window_layer_t;
+    const stack_transient_t *x = a, *y = b;
+    if(x->parent != y->parent)
+        return (uintptr_t) x->parent < (uintptr_t) y->parent ? -1 : 1;
+    return x->position - y->position;
+}
+
+/** Find the first transient child of a client.
+ * \param c The client.
+ * \return The index of the first entry for c in stack_transients.
+ */
+static int
+stack_transient_first(client_t *c)
+{
+    int l = 0, r = stack_transients.len;
+    while(l < r)
+    {
+        int i = (l + r) / 2;
+        if((uintptr_t) stack_transients.tab[i].parent < (uintptr_t) c)
+            l = i + 1;
+        else
+            r = i;
+    }
+    return l;
+}
+
+/** Stack a client above.
+ * \param c The client.
+ */
+static void
+stack_client_above(client_t *c)
+{
+    stack_order_append((window_t *) c, c->frame_window);
+
+    /* stack transient window on top of their parents */
+    for(int i = stack_transient_first(c);
+        i < stack_transients.len && stack_transients.tab[i].parent == c;
+        i++)
+        stack_client_above(stack_transients.tab[i].child);
+}
 
 /** Get the real layer of a client according to its attribute (fullscreen, …)
  * \param c The client.
@@ -155,45 +248,149 @@ client_layer_translator(client_t *c)
     return WINDOW_LAYER_NORMAL;
 }
 
-/** Restack clients.
- * \todo It might be worth stopping to restack everyone and only stack `c'
- * relatively to the first matching in the list.
+/** Compute the desired stacking order of all clients and drawins, bottom
+ * first, into stack_order.
+ * A window that is stacked several times (transients with a layer of their
+ * own) only keeps its last position, just like repeated ConfigureWindow
+ * requests would.
  */
-void
-stack_refresh()
+static void
+stack_compute_order(void)
 {
-    if(!need_stack_refresh)
-        return;
+    stack_order.len = 0;
+    stack_transients.len = 0;
+    for(window_layer_t layer = WINDOW_LAYER_IGNORE; layer < WINDOW_LAYER_COUNT; layer++)
+        stack_layers[layer].len = 0;
 
-    xcb_window_t next = XCB_NONE;
+    foreach(node, globalconf.stack)
+    {
+        client_t *c = *node;
+        if(c->transient_for)
+            stack_transient_array_append(&stack_transients, (stack_transient_t)
+                    {
+                        .parent = c->transient_for,
+                        .position = stack_transients.len,
+                        .child = c
+                    });
+        client_array_append(&stack_layers[client_layer_translator(c)], c);
+    }
+    qsort(stack_transients.tab, stack_transients.len, sizeof(stack_transient_t), stack_transient_cmp);
 
     /* stack desktop windows */
-    for(window_layer_t layer = WINDOW_LAYER_DESKTOP; layer < WINDOW_LAYER_BELOW; layer++)
-        foreach(node, globalconf.stack)
-            if(client_layer_translator(*node) == layer)
-                next = stack_client_above(*node, next);
+    foreach(node, stack_layers[WINDOW_LAYER_DESKTOP])
+        stack_client_above(*node);
 
     /* first stack not ontop drawin window */
     foreach(drawin, globalconf.drawins)
         if(!(*drawin)->ontop)
-        {
-            stack_window_above((*drawin)->window, next);
-            next = (*drawin)->window;
-        }
+            stack_order_append((window_t *) *drawin, (*drawin)->window);
 
     /* then stack clients */
     for(window_layer_t layer = WINDOW_LAYER_BELOW; layer < WINDOW_LAYER_COUNT; layer++)
-        foreach(node, globalconf.stack)
-            if(client_layer_translator(*node) == layer)
-                next = stack_client_above(*node, next);
+        foreach(node, stack_layers[layer])
+            stack_client_above(*node);
 
     /* then stack ontop drawin window */
     foreach(drawin, globalconf.drawins)
         if((*drawin)->ontop)
+            stack_order_append((window_t *) *drawin, (*drawin)->window);
+
+    /* Drop all but the last occurrence of each window */
+    unsigned int generation = stack_generation + 1;
+    if(generation == 0)
+        generation = 1;
+    int len = 0;
+    for(int i = stack_order.len - 1; i >= 0; i--)
+    {
+        window_t *object = stack_order.tab[i].object;
+        if(object->stack_generation == generation)
+            stack_order.tab[i].object = NULL;
+        else
+            object->stack_generation = generation;
+    }
+    foreach(entry, stack_order)
+        if(entry->object)
+            stack_order.tab[len++] = *entry;
+    stack_order.len = len;
+    stack_generation = generation;
+}
+
+/** Find the windows that can stay where they are.
+ * The windows that were already committed keep their old relative order in X.
+ * The longest run of them whose old order agrees with the new order can stay,
+ * every other window has to be moved.
+ */
+static void
+stack_mark_in_place(void)
+{
+    int len = stack_order.len, lis_len = 0;
+    int *tails = p_new(int, len + 1);
+    int *prev = p_new(int, len + 1);
+
+    for(int i = 0; i < len; i++)
+    {
+        int old = stack_order.tab[i].old_index;
+        stack_order.tab[i].in_place = false;
+        if(old < 0)
+            continue;
+
+        int l = 0, r = lis_len;
+        while(l < r)
         {
-            stack_window_above((*drawin)->window, next);
-            next = (*drawin)->window;
+            int m = (l + r) / 2;
+            if(stack_order.tab[tails[m]].old_index < old)
+                l = m + 1;
+            else
+                r = m;
         }
+        prev[i] = l > 0 ? tails[l - 1] : -1;
+        tails[l] = i;
+        if(l == lis_len)
+            lis_len++;
+    }
+
+    for(int i = lis_len > 0 ? tails[lis_len - 1] : -1; i >= 0; i = prev[i])
+        stack_order.tab[i].in_place = true;
+
+    p_delete(&tails);
+    p_delete(&prev);
+}
+
+/** Restack clients.
+ * Only the windows whose position relative to the previously committed order
+ * changed are sent a ConfigureWindow request.
+ */
+void
+stack_refresh()
+{
+    if(!need_stack_refresh)
+        return;
+
+    stack_compute_order();
+    stack_mark_in_place();
+
+    /* The lowest of the windows that stay, the bottom of our part of the stack */
+    xcb_window_t lowest = XCB_NONE;
+    int lowest_index = -1;
+    foreach(entry, stack_order)
+        if(entry->old_index >= 0 && (lowest_index < 0 || entry->old_index < lowest_index))
+        {
+            lowest = entry->window;
+            lowest_index = entry->old_index;
+        }
+
+    for(int i = 0; i < stack_order.len; i++)
+    {
+        stack_entry_t *entry = &stack_order.tab[i];
+        if(!entry->in_place)
+        {
+            if(i > 0)
+                stack_window_above(entry->window, stack_order.tab[i - 1].window);
+            else
+                stack_window_below(entry->window, lowest);
+        }
+        entry->object->stack_index = i;
+    }
 
     need_stack_refresh = false;
 }
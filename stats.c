@@ -0,0 +1,360 @@
+/*
+ * stats.c - main loop statistics
+ *
+ * Copyright © 2026 Awesome Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "stats.h"
+#include "globalconf.h"
+#include "luaa.h"
+#include "common/util.h"
+
+#include <stdlib.h>
+#include <xcb/xcb_event.h>
+
+/** Number of samples kept for each timing */
+#define STATS_RING_SIZE 512
+
+/** The most recent samples of some measurement */
+typedef struct
+{
+    float samples[STATS_RING_SIZE];
+    /** Number of valid entries in samples */
+    int len;
+    /** Index where the next sample will be written */
+    int next;
+} stats_ring_t;
+
+static const char * const stats_phase_names[STATS_PHASE_COUNT] =
+{
+    [STATS_PHASE_REFRESH_SIGNAL] = "refresh_signal",
+    [STATS_PHASE_DRAWIN_REFRESH] = "drawin_refresh",
+    [STATS_PHASE_CLIENT_REFRESH] = "client_refresh",
+    [STATS_PHASE_BANNING_REFRESH] = "banning_refresh",
+    [STATS_PHASE_STACK_REFRESH] = "stack_refresh",
+    [STATS_PHASE_DESTROY_LATER] = "destroy_later",
+    [STATS_PHASE_EVENT_HANDLING] = "event_handling",
+    [STATS_PHASE_ITERATION] = "iteration",
+};
+
+static struct
+{
+    /** Durations of the phases, in seconds */
+    stats_ring_t phases[STATS_PHASE_COUNT];
+    /** Whether X11 requests are counted, see luaA_stats_count_requests() */
+    bool count_requests;
+    /** Number of X11 requests sent per iteration */
+    stats_ring_t requests;
+    /** Sequence number of the last request of the previous iteration, or 0 */
+    unsigned int last_sequence;
+    /** X11 requests sent since startup, as far as they were counted */
+    uint64_t requests_total;
+    /** Sites waiting for the X server, see A_XCB_WAIT() */
+    stats_wait_site_t *wait_sites;
+    /** Waits for the X server since startup and in this iteration */
+    uint64_t waits, iteration_waits;
+    /** Time spent waiting for the X server, in seconds */
+    double wait_time, iteration_wait_time;
+    stats_ring_t waits_per_iteration;
+    stats_ring_t wait_time_per_iteration;
+    /** Handled events, indexed by response type */
+    uint64_t events[128];
+    uint64_t iterations;
+    uint64_t wakeups;
+    /** Time of the last wakeup */
+    gint64 last_wakeup;
+    /** Start of the current wakeups per second measurement */
+    gint64 rate_start;
+    uint64_t rate_wakeups;
+    double wakeups_per_second;
+} stats;
+
+static void
+stats_ring_add(stats_ring_t *ring, float value)
+{
+    ring->samples[ring->next] = value;
+    ring->next = (ring->next + 1) % STATS_RING_SIZE;
+    if(ring->len < STATS_RING_SIZE)
+        ring->len++;
+}
+
+static int
+stats_float_cmp(const void *a, const void *b)
+{
+    float x = *(const float *) a, y = *(const float *) b;
+    return (x > y) - (x < y);
+}
+
+/** Push a table with min, avg, p99, max and the number of samples of a ring.
+ * \param L The Lua VM state.
+ * \param ring The ring to summarize.
+ */
+static void
+stats_ring_push(lua_State *L, const stats_ring_t *ring)
+{
+    float sorted[STATS_RING_SIZE];
+    double sum = 0;
+
+    lua_createtable(L, 0, 5);
+    lua_pushinteger(L, ring->len);
+    lua_setfield(L, -2, "samples");
+    if(ring->len == 0)
+        return;
+
+    memcpy(sorted, ring->samples, ring->len * sizeof(*sorted));
+    qsort(sorted, ring->len, sizeof(*sorted), stats_float_cmp);
+    for(int i = 0; i < ring->len; i++)
+        sum += sorted[i];
+
+    lua_pushnumber(L, sorted[0]);
+    lua_setfield(L, -2, "min");
+    lua_pushnumber(L, sum / ring->len);
+    lua_setfield(L, -2, "avg");
+    lua_pushnumber(L, sorted[(ring->len * 99 + 99) / 100 - 1]);
+    lua_setfield(L, -2, "p99");
+    lua_pushnumber(L, sorted[ring->len - 1]);
+    lua_setfield(L, -2, "max");
+}
+
+/** Record the duration of a phase of the main loop.
+ * \param phase The phase that just finished.
+ * \param since When the phase started, as returned by stats_now().
+ * \return The current time, so that the next phase can start there.
+ */
+gint64
+stats_record(stats_phase_t phase, gint64 since)
+{
+    gint64 now = stats_now();
+    stats_ring_add(&stats.phases[phase], (now - since) / 1e6);
+    return now;
+}
+
+/** Add a call site of A_XCB_WAIT() to the statistics.
+ * \param site The site, its statistics must be zero.
+ * \param func The function containing the site.
+ * \param file The source file containing the site.
+ * \param line The line of the site.
+ */
+void
+stats_wait_site_register(stats_wait_site_t *site, const char *func, const char *file, int line)
+{
+    site->func = func;
+    site->file = file;
+    site->line = line;
+    site->next = stats.wait_sites;
+    stats.wait_sites = site;
+}
+
+/** Account a wait for the X server to its call site.
+ * \param site The call site.
+ * \param start When the wait started, as returned by stats_now().
+ */
+void
+stats_wait_end(stats_wait_site_t *site, gint64 start)
+{
+    double time = (stats_now() - start) / 1e6;
+
+    site->waits++;
+    site->time += time;
+    if(site->iteration != stats.iterations)
+    {
+        site->iteration = stats.iterations;
+        site->iteration_waits = 0;
+    }
+    site->iteration_waits++;
+    site->max_iteration_waits = MAX(site->max_iteration_waits, site->iteration_waits);
+
+    stats.waits++;
+    stats.wait_time += time;
+    stats.iteration_waits++;
+    stats.iteration_wait_time += time;
+}
+
+static int
+stats_wait_site_cmp(const void *a, const void *b)
+{
+    const stats_wait_site_t *x = *(stats_wait_site_t * const *) a;
+    const stats_wait_site_t *y = *(stats_wait_site_t * const *) b;
+    return (x->time < y->time) - (x->time > y->time);
+}
+
+/** Push the statistics about the X11 connection.
+ * \param L The Lua VM state.
+ */
+static void
+stats_push_x11(lua_State *L)
+{
+    int len = 0;
+
+    lua_createtable(L, 0, 7);
+    lua_pushnumber(L, stats.requests_total);
+    lua_setfield(L, -2, "requests");
+    lua_pushnumber(L, stats.waits);
+    lua_setfield(L, -2, "waits");
+    lua_pushnumber(L, stats.wait_time);
+    lua_setfield(L, -2, "wait_time");
+    stats_ring_push(L, &stats.waits_per_iteration);
+    lua_setfield(L, -2, "waits_per_iteration");
+    stats_ring_push(L, &stats.wait_time_per_iteration);
+    lua_setfield(L, -2, "wait_time_per_iteration");
+
+    for(stats_wait_site_t *site = stats.wait_sites; site; site = site->next)
+        len++;
+    stats_wait_site_t **sites = p_alloca(stats_wait_site_t *, len);
+    len = 0;
+    for(stats_wait_site_t *site = stats.wait_sites; site; site = site->next)
+        sites[len++] = site;
+    qsort(sites, len, sizeof(*sites), stats_wait_site_cmp);
+
+    lua_createtable(L, len, 0);
+    for(int i = 0; i < len; i++)
+    {
+        lua_createtable(L, 0, 6);
+        lua_pushstring(L, sites[i]->func);
+        lua_setfield(L, -2, "func");
+        lua_pushstring(L, sites[i]->file);
+        lua_setfield(L, -2, "file");
+        lua_pushinteger(L, sites[i]->line);
+        lua_setfield(L, -2, "line");
+        lua_pushnumber(L, sites[i]->waits);
+        lua_setfield(L, -2, "waits");
+        lua_pushnumber(L, sites[i]->time);
+        lua_setfield(L, -2, "time");
+        lua_pushnumber(L, sites[i]->max_iteration_waits);
+        lua_setfield(L, -2, "max_waits_per_iteration");
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "sites");
+}
+
+/** Count an event that is being handled.
+ * \param response_type The response type of the event.
+ */
+void
+stats_count_event(uint8_t response_type)
+{
+    stats.events[XCB_EVENT_RESPONSE_TYPE_MASK & response_type]++;
+}
+
+/** Record that the main loop woke up. */
+void
+stats_wakeup(void)
+{
+    gint64 now = stats_now();
+
+    stats.wakeups++;
+    stats.rate_wakeups++;
+    stats.last_wakeup = now;
+
+    if(stats.rate_start == 0)
+        stats.rate_start = now;
+    else if(now - stats.rate_start >= G_USEC_PER_SEC)
+    {
+        stats.wakeups_per_second = stats.rate_wakeups * 1e6 / (now - stats.rate_start);
+        stats.rate_start = now;
+        stats.rate_wakeups = 0;
+    }
+}
+
+/** Record the end of a main loop iteration, before it goes back to sleep. */
+void
+stats_iteration_end(void)
+{
+    if(stats.last_wakeup != 0)
+        stats_record(STATS_PHASE_ITERATION, stats.last_wakeup);
+
+    if(stats.count_requests)
+    {
+        /* There is no other way to get the current sequence number. The
+         * NoOperation request is flushed together with the next batch. */
+        unsigned int sequence = xcb_no_operation(globalconf.connection).sequence;
+
+        if(stats.last_sequence != 0)
+        {
+            stats_ring_add(&stats.requests, sequence - stats.last_sequence - 1);
+            stats.requests_total += sequence - stats.last_sequence - 1;
+        }
+        stats.last_sequence = sequence;
+    }
+
+    stats_ring_add(&stats.waits_per_iteration, stats.iteration_waits);
+    stats_ring_add(&stats.wait_time_per_iteration, stats.iteration_wait_time);
+    stats.iteration_waits = 0;
+    stats.iteration_wait_time = 0;
+
+    stats.iterations++;
+}
+
+/** Enable or disable counting X11 requests, awesome.stats_count_requests().
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ */
+int
+luaA_stats_count_requests(lua_State *L)
+{
+    stats.count_requests = luaA_checkboolean(L, 1);
+    /* Don't count what was sent while disabled */
+    stats.last_sequence = 0;
+    return 0;
+}
+
+int
+luaA_stats(lua_State *L)
+{
+    lua_createtable(L, 0, 7);
+
+    lua_pushnumber(L, stats.iterations);
+    lua_setfield(L, -2, "iterations");
+    lua_pushnumber(L, stats.wakeups);
+    lua_setfield(L, -2, "wakeups");
+    lua_pushnumber(L, stats.wakeups_per_second);
+    lua_setfield(L, -2, "wakeups_per_second");
+
+    lua_createtable(L, 0, STATS_PHASE_COUNT);
+    for(int i = 0; i < STATS_PHASE_COUNT; i++)
+    {
+        stats_ring_push(L, &stats.phases[i]);
+        lua_setfield(L, -2, stats_phase_names[i]);
+    }
+    lua_setfield(L, -2, "phases");
+
+    stats_ring_push(L, &stats.requests);
+    lua_setfield(L, -2, "requests");
+
+    stats_push_x11(L);
+    lua_setfield(L, -2, "x11");
+
+    lua_newtable(L);
+    for(int i = 0; i < countof(stats.events); i++)
+    {
+        if(stats.events[i] == 0)
+            continue;
+        const char *label = xcb_event_get_label(i);
+        if(label)
+            lua_pushstring(L, label);
+        else
+            lua_pushfstring(L, "event_%d", i);
+        lua_pushnumber(L, stats.events[i]);
+        lua_rawset(L, -3);
+    }
+    lua_setfield(L, -2, "events");
+
+    return 1;
+}
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
@@ -0,0 +1,104 @@
+/*
+ * stats.h - main loop statistics header
+ *
+ * Copyright © 2026 Awesome Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef AWESOME_STATS_H
+#define AWESOME_STATS_H
+
+#include <glib.h>
+#include <lua.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <xcb/xcb_aux.h>
+
+/** The parts of a main loop iteration that are timed */
+typedef enum
+{
+    STATS_PHASE_REFRESH_SIGNAL,
+    STATS_PHASE_DRAWIN_REFRESH,
+    STATS_PHASE_CLIENT_REFRESH,
+    STATS_PHASE_BANNING_REFRESH,
+    STATS_PHASE_STACK_REFRESH,
+    STATS_PHASE_DESTROY_LATER,
+    STATS_PHASE_EVENT_HANDLING,
+    /** Everything between a wakeup and going back to sleep */
+    STATS_PHASE_ITERATION,
+    STATS_PHASE_COUNT
+} stats_phase_t;
+
+/** Get a timestamp to pass to stats_record().
+ * \return The current monotonic time in microseconds.
+ */
+static inline gint64
+stats_now(void)
+{
+    return g_get_monotonic_time();
+}
+
+/** A place in the code that waits for the X server, see A_XCB_WAIT() */
+typedef struct stats_wait_site_t stats_wait_site_t;
+struct stats_wait_site_t
+{
+    const char *func;
+    const char *file;
+    int line;
+    /** Number of waits since startup */
+    uint64_t waits;
+    /** Time spent waiting since startup, in seconds */
+    double time;
+    /** The main loop iteration iteration_waits refers to */
+    uint64_t iteration;
+    uint64_t iteration_waits;
+    uint64_t max_iteration_waits;
+    /** The next site that was used */
+    stats_wait_site_t *next;
+};
+
+void stats_wait_site_register(stats_wait_site_t *, const char *, const char *, int);
+void stats_wait_end(stats_wait_site_t *, gint64);
+
+/** Evaluate an expression that waits for the X server, for example a call to
+ * an xcb_*_reply() function, and account the time to this call site.
+ * \param expr The expression.
+ * \return The value of expr.
+ */
+#define A_XCB_WAIT(expr) \
+    ({ \
+        static stats_wait_site_t stats_site_; \
+        if(!stats_site_.file) \
+            stats_wait_site_register(&stats_site_, __func__, __FILE__, __LINE__); \
+        gint64 stats_start_ = stats_now(); \
+        __typeof__(expr) stats_result_ = (expr); \
+        stats_wait_end(&stats_site_, stats_start_); \
+        stats_result_; \
+    })
+
+/** xcb_aux_sync(), accounted like A_XCB_WAIT() */
+#define A_XCB_SYNC(connection) A_XCB_WAIT((xcb_aux_sync(connection), true))
+
+gint64 stats_record(stats_phase_t, gint64);
+void stats_count_event(uint8_t);
+void stats_wakeup(void);
+void stats_iteration_end(void);
+int luaA_stats(lua_State *);
+int luaA_stats_count_requests(lua_State *);
+
+#endif
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
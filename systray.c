@@ -25,6 +25,7 @@
 #include "objects/drawin.h"
 #include "xwindow.h"
 #include "globalconf.h"
+#include "stats.h"
 
 #include <xcb/xcb.h>
 #include <xcb/xcb_icccm.h>
@@ -63,7 +64,7 @@ systray_init(void)
 
     p_delete(&atom_name);
 
-    atom_systray_r = xcb_intern_atom_reply(globalconf.connection, atom_systray_q, NULL);
+    atom_systray_r = A_XCB_WAIT(xcb_intern_atom_reply(globalconf.connection, atom_systray_q, NULL));
     if(!atom_systray_r)
         fatal("error getting systray atom");
 
@@ -159,7 +160,7 @@ systray_request_handle(xcb_window_t embed_win)
 
     em.win = embed_win;
 
-    if (!xembed_info_get_reply(globalconf.connection, em_cookie, &em.info)) {
+    if (!A_XCB_WAIT(xembed_info_get_reply(globalconf.connection, em_cookie, &em.info))) {
         /* Set some sane defaults */
         em.info.version = XEMBED_VERSION;
         em.info.flags = XEMBED_MAPPED;
@@ -191,7 +192,7 @@ systray_process_client_message(xcb_client_message_event_t *ev)
       case SYSTEM_TRAY_REQUEST_DOCK:
         geom_c = xcb_get_geometry_unchecked(globalconf.connection, ev->window);
 
-        if(!(geom_r = xcb_get_geometry_reply(globalconf.connection, geom_c, NULL)))
+        if(!(geom_r = A_XCB_WAIT(xcb_get_geometry_reply(globalconf.connection, geom_c, NULL))))
             return -1;
 
         if(globalconf.screen->root == geom_r->root)
@@ -204,24 +205,31 @@ systray_process_client_message(xcb_client_message_event_t *ev)
     return ret;
 }
 
-/** Check if a window is a KDE tray.
+/** Send the request checking if a window is a KDE tray.
  * \param w The window to check.
+ * \return The cookie to pass to systray_iskdedockapp().
+ */
+xcb_get_property_cookie_t
+systray_iskdedockapp_unchecked(xcb_window_t w)
+{
+    /* Check if that is a KDE tray because it does not respect fdo standards,
+     * thanks KDE. */
+    return xcb_get_property_unchecked(globalconf.connection, false, w,
+                                      _KDE_NET_WM_SYSTEM_TRAY_WINDOW_FOR,
+                                      XCB_ATOM_WINDOW, 0, 1);
+}
+
+/** Check if a window is a KDE tray.
+ * \param kde_check_q Cookie returned by systray_iskdedockapp_unchecked().
  * \return True if it is, false otherwise.
  */
 bool
-systray_iskdedockapp(xcb_window_t w)
+systray_iskdedockapp(xcb_get_property_cookie_t kde_check_q)
 {
-    xcb_get_property_cookie_t kde_check_q;
     xcb_get_property_reply_t *kde_check;
     bool ret;
 
-    /* Check if that is a KDE tray because it does not respect fdo standards,
-     * thanks KDE. */
-    kde_check_q = xcb_get_property_unchecked(globalconf.connection, false, w,
-                                             _KDE_NET_WM_SYSTEM_TRAY_WINDOW_FOR,
-                                             XCB_ATOM_WINDOW, 0, 1);
-
-    kde_check = xcb_get_property_reply(globalconf.connection, kde_check_q, NULL);
+    kde_check = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, kde_check_q, NULL));
 
     /* it's a KDE systray ?*/
     ret = (kde_check && kde_check->value_len);
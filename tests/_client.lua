@@ -12,12 +12,15 @@ local test_client_source = [[
 pcall(require, 'luarocks.loader')
 local lgi = require 'lgi'
 local Gdk = lgi.require('Gdk')
+local GdkPixbuf = lgi.require('GdkPixbuf')
 local Gtk = lgi.require('Gtk')
 local Gio = lgi.require('Gio')
 Gtk.init()
 
 local function open_window(class, title, options)
     local window = Gtk.Window {
+        type           = options.override_redirect and Gtk.WindowType.POPUP
+                         or Gtk.WindowType.TOPLEVEL,
         default_width  = options.default_width  or 100,
         default_height = options.default_height or 100,
         title          = title
@@ -41,6 +44,15 @@ local function open_window(class, title, options)
     if options.maximize_before then
         window:maximize()
     end
+    if options.icon_sizes then
+        local icons = {}
+        for size in string.gmatch(options.icon_sizes, "%d+") do
+            local icon = GdkPixbuf.Pixbuf.new(GdkPixbuf.Colorspace.RGB, true, 8, size, size)
+            icon:fill(0xff000080)
+            table.insert(icons, icon)
+        end
+        window:set_icon_list(icons)
+    end
     window:set_wmclass(class, class)
     window:show_all()
     if options.maximize_after then
@@ -170,6 +182,12 @@ return function(class, title, sn_rules, callback, resize_increment, args)
             args.resize.height, ","
         }
     end
+    if args.override_redirect then
+        options = options .. "override_redirect,"
+    end
+    if args.icon_sizes then
+        options = options .. "icon_sizes=" .. table.concat(args.icon_sizes, ":") .. ","
+    end
     if args.gravity then
         assert(type(args.gravity)=="number","Use `lgi.Gdk.Gravity.NORTH_WEST`")
         options = options .. "gravity=" .. args.gravity .. ","
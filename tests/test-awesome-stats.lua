@@ -0,0 +1,56 @@
+-- Test that awesome.stats() reports the main loop statistics
+
+local runner = require("_runner")
+
+local iterations
+
+local steps = {
+    function()
+        iterations = awesome.stats().iterations
+        awesome.stats_count_requests(true)
+        awesome.sync()
+        return true
+    end,
+
+    function()
+        local stats = awesome.stats()
+        if stats.iterations <= iterations then
+            return
+        end
+
+        assert(stats.wakeups > 0)
+        assert(stats.events.PropertyNotify or stats.events.MapNotify)
+
+        for _, name in ipairs { "refresh_signal", "drawin_refresh", "client_refresh",
+                                "banning_refresh", "stack_refresh", "iteration" } do
+            local phase = stats.phases[name]
+            assert(phase.samples > 0, name)
+            assert(phase.min <= phase.avg and phase.avg <= phase.max, name)
+            assert(phase.p99 <= phase.max, name)
+        end
+
+        assert(stats.requests.samples > 0)
+        assert(stats.requests.min >= 0)
+
+        -- awesome.sync() waits for the X server
+        local x11 = stats.x11
+        assert(x11.requests > 0 and x11.waits > 0 and x11.wait_time > 0)
+        assert(x11.waits_per_iteration.samples > 0)
+        local sync_site
+        for _, site in ipairs(x11.sites) do
+            assert(site.waits > 0 and site.max_waits_per_iteration > 0)
+            if site.func == "luaA_sync" then
+                sync_site = site
+            end
+        end
+        assert(sync_site and sync_site.file:match("luaa.c$"), "no luaA_sync site")
+
+        awesome.stats_count_requests(false)
+
+        return true
+    end,
+}
+
+runner.run_steps(steps)
+
+-- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
@@ -0,0 +1,169 @@
+-- Test that the C implementations of the layouts give the same geometries as
+-- the Lua ones.
+
+local runner = require("_runner")
+local test_client = require("_client")
+local awful = require("awful")
+local gtable = require("gears.table")
+
+local suit = awful.layout.suit
+local class = "layout_native_test"
+local client_count = 10
+
+local layouts = {
+    { suit.tile, suit.tile.right },
+    { suit.tile, suit.tile.left },
+    { suit.tile, suit.tile.top },
+    { suit.tile, suit.tile.bottom },
+    { suit.fair, suit.fair },
+    { suit.fair, suit.fair.horizontal },
+    { suit.max, suit.max },
+    { suit.max, suit.max.fullscreen },
+    { suit.spiral, suit.spiral },
+    { suit.spiral, suit.spiral.dwindle },
+}
+
+local function get_clients()
+    local ret = {}
+    for _, c in ipairs(client.get()) do
+        if c.class == class then
+            table.insert(ret, c)
+        end
+    end
+    return ret
+end
+
+local function random_area()
+    return {
+        x = math.random(0, 200),
+        y = math.random(0, 200),
+        width = math.random(1, 2000),
+        height = math.random(1, 2000),
+    }
+end
+
+local function random_windowfact()
+    local data = {}
+    for i = 0, math.random(0, 3) do
+        if math.random() < 0.8 then
+            data[i] = {}
+            for j = 1, math.random(0, client_count) do
+                if math.random() < 0.7 then
+                    data[i][j] = math.random() * 2
+                end
+            end
+        end
+    end
+    return data
+end
+
+-- Run a layout with a copy of the parameters
+local function arrange(module, layout, native, p, windowfact, t)
+    local copy = gtable.clone(p, true)
+    copy.tag = t
+    copy.geometries = {}
+    awful.tag.getdata(t).windowfact = gtable.clone(windowfact, true)
+
+    local old = module.native
+    module.native = native
+    layout.arrange(copy)
+    module.native = old
+
+    return copy.geometries, awful.tag.getdata(t).windowfact
+end
+
+local function compare(what, lua_result, c_result)
+    for k, v in pairs(lua_result) do
+        assert(c_result[k] ~= nil, what .. ": missing " .. tostring(k))
+        if type(v) == "table" then
+            compare(what .. "." .. tostring(k), v, c_result[k])
+        else
+            assert(v == c_result[k], string.format("%s.%s: %s (Lua) ~= %s (C)",
+                what, tostring(k), tostring(v), tostring(c_result[k])))
+        end
+    end
+    for k in pairs(c_result) do
+        assert(lua_result[k] ~= nil, what .. ": unexpected " .. tostring(k))
+    end
+end
+
+runner.run_steps({
+    function(count)
+        if count == 1 then
+            for i = 1, client_count do
+                -- Some clients with size hints
+                test_client(class, class .. i, nil, nil, i % 3 == 0)
+            end
+        end
+        return #get_clients() == client_count or nil
+    end,
+
+    function()
+        local clients = get_clients()
+        local t = awful.screen.focused().selected_tag
+        assert(t)
+
+        math.randomseed(42)
+        for run = 1, 200 do
+            for _, c in ipairs(clients) do
+                c.border_width = math.random(0, 5)
+                c.size_hints_honor = math.random() < 0.5
+            end
+            t.master_count = math.random(0, 4)
+            t.column_count = math.random(1, 4)
+            t.master_width_factor = math.random(1, 99) / 100
+            t.master_fill_policy = math.random() < 0.5 and "expand" or "master_width_factor"
+
+            local p = {
+                workarea = random_area(),
+                geometry = random_area(),
+                useless_gap = math.random(0, 10),
+                screen = t.screen.index,
+                clients = {},
+            }
+            for _, c in ipairs(clients) do
+                if math.random() < 0.7 then
+                    table.insert(p.clients, c)
+                end
+            end
+            local windowfact = random_windowfact()
+
+            for _, l in ipairs(layouts) do
+                local what = string.format("run %d, %s", run, l[2].name)
+                local lua_geometries, lua_facts = arrange(l[1], l[2], false, p, windowfact, t)
+                local c_geometries, c_facts = arrange(l[1], l[2], true, p, windowfact, t)
+                compare(what, lua_geometries, c_geometries)
+                compare(what .. ", windowfact", lua_facts, c_facts)
+            end
+        end
+
+        return true
+    end,
+
+    -- The batched apply gives the clients the computed geometries
+    function()
+        local clients = get_clients()
+        local t = awful.screen.focused().selected_tag
+        t.layout = suit.fair
+        t.gap = 3
+        for _, c in ipairs(clients) do
+            c.border_width = 2
+            c.size_hints_honor = false
+        end
+
+        local p = awful.layout.parameters(t)
+        p.geometries = {}
+        suit.fair.arrange(p)
+        awesome._layout.apply(p.geometries, p.useless_gap)
+
+        for c, g in pairs(p.geometries) do
+            local geo = c:geometry()
+            assert(geo.x == g.x and geo.y == g.y, c.name)
+            assert(geo.width == g.width and geo.height == g.height, c.name)
+        end
+
+        return true
+    end,
+})
+
+-- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
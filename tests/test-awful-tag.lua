@@ -393,6 +393,71 @@ table.insert(steps, function()
     return true
 end)
 
+-- Check that a tag switch only touches the clients whose visibility changed.
+table.insert(steps, function()
+    local t1, t2 = screen[1].tags[1], screen[1].tags[2]
+
+    for _, c in ipairs(client.get()) do
+        c:tags { t2 }
+    end
+
+    t1:view_only()
+
+    return true
+end)
+
+table.insert(steps, function()
+    screen[1].tags[2]:view_only()
+
+    return true
+end)
+
+table.insert(steps, function()
+    local stats = awesome._banning_stats
+    local count = #screen[1].tags[2]:clients()
+
+    assert(count > 0)
+    assert(stats.checked == count, stats.checked)
+    assert(stats.unbanned == count, stats.unbanned)
+    assert(stats.banned == 0, stats.banned)
+
+    -- Switching to an empty tag bans them all again.
+    screen[1].tags[3]:view_only()
+
+    return true
+end)
+
+table.insert(steps, function()
+    local stats = awesome._banning_stats
+    local count = #screen[1].tags[2]:clients()
+
+    assert(stats.checked == count, stats.checked)
+    assert(stats.banned == count, stats.banned)
+    assert(stats.unbanned == 0, stats.unbanned)
+
+    return true
+end)
+
+-- c:tags() follows the order of the tags, whatever the tagging order was.
+table.insert(steps, function()
+    local tags = screen[1].tags
+    local c = client.get()[1]
+
+    c:tags { tags[3], tags[1], tags[2] }
+
+    local ctags = c:tags()
+    assert(#ctags == 3)
+    assert(ctags[1] == tags[1] and ctags[2] == tags[2] and ctags[3] == tags[3])
+    assert(c.first_tag == tags[1])
+
+    c:tags { tags[2] }
+    assert(#c:tags() == 1 and c:tags()[1] == tags[2])
+    assert(c.first_tag == tags[2])
+    assert(not gtable.hasitem(tags[1]:clients(), c))
+
+    return true
+end)
+
 require("_runner").run_steps(steps)
 
 -- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
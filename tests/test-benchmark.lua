@@ -3,6 +3,7 @@
 
 local runner = require("_runner")
 local awful = require("awful")
+local wibox = require("wibox")
 local GLib = require("lgi").GLib
 local create_wibox = require("_wibox_helper").create_wibox
 
@@ -71,11 +72,95 @@ local function e2e_tag_switch()
     do_pending_repaint()
 end
 
+local bench_drawin = create_wibox().drawin
+
+local function get_drawin_properties()
+    for _ = 1, 1000 do
+        local _ = bench_drawin.ontop, bench_drawin.x, bench_drawin.geometry
+    end
+end
+
+local function set_drawin_properties()
+    for _ = 1, 1000 do
+        bench_drawin.ontop = false
+        bench_drawin.visible = false
+    end
+end
+
+-- Redraw a wide wibar with lots of widgets, drawn by the X server or with
+-- MIT-SHM. The wibar only exists while it is being measured.
+local function benchmark_busy_wibar(shm, msg)
+    local layout = wibox.layout.fixed.horizontal()
+    for i = 1, 100 do
+        local text = wibox.widget.textbox("widget " .. i)
+        layout:add(wibox.container.background(text, i % 2 == 0 and "#336699" or "#993366"))
+    end
+    local wb = wibox({ width = 3840, height = 24, screen = 1, visible = true })
+    wb.drawin.drawable.shm = shm
+    wb:set_widget(layout)
+    do_pending_repaint()
+
+    -- Without MIT-SHM, this would measure server side drawing again
+    if wb.drawin.drawable.shm == shm then
+        benchmark(function()
+            layout:emit_signal("widget::redraw_needed")
+            do_pending_repaint()
+            -- Include the time the X server needs for rendering
+            awesome.sync()
+        end, msg)
+    else
+        print(string.format("%20s: skipped, MIT-SHM is not available", msg))
+    end
+
+    wb.visible = false
+    wb:set_widget(nil)
+    do_pending_repaint()
+end
+
+-- Lay out a wibar-like hierarchy again after one textbox changed its text, but
+-- not its size. Either only the textbox is laid out again, or, like before
+-- incremental relayouts, everything up to the bar.
+local function benchmark_relayout(full, msg)
+    local context = { dpi = 96 }
+    local left, right = wibox.layout.fixed.horizontal(), wibox.layout.fixed.horizontal()
+    local bar = wibox.layout.align.horizontal(left, nil, right)
+    local text, text_margin
+    for i = 1, 40 do
+        local l = wibox.widget.textbox("left " .. i)
+        local m = wibox.container.margin(l, 2, 2)
+        left:add(m)
+        right:add(wibox.container.margin(wibox.widget.textbox("right " .. i), 2, 2))
+        if i == 11 then
+            text, text_margin = l, m
+        end
+    end
+
+    local function nop() end
+    local instance = wibox.hierarchy.new(context, bar, 5000, 20, nop, nop)
+    local i = 0
+    benchmark(function()
+        i = i + 1
+        text:set_text(i % 2 == 0 and "left 98" or "left 99")
+        if full then
+            for _, w in ipairs { text_margin, left, bar } do
+                w:emit_signal("widget::layout_changed")
+            end
+        end
+        instance:update(context, bar, 5000, 20)
+    end, msg)
+end
+
 benchmark(create_and_draw_wibox, "create&draw wibox")
 benchmark(update_textclock, "update textclock")
 benchmark(relayout_textclock, "relayout textclock")
 benchmark(redraw_textclock, "redraw textclock")
 benchmark(e2e_tag_switch, "tag switch")
+benchmark(get_drawin_properties, "1000x3 property get")
+benchmark(set_drawin_properties, "1000x2 property set")
+benchmark_busy_wibar(false, "redraw busy wibar")
+benchmark_busy_wibar(true, "redraw busy wibar shm")
+benchmark_relayout(true, "relayout up to bar")
+benchmark_relayout(false, "relayout one widget")
 
 runner.run_steps({ function() return true end })
 
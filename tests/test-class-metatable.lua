@@ -0,0 +1,23 @@
+-- Fields that are added to the metatable of a class are found, even by
+-- objects that already looked them up before.
+
+local runner = require("_runner")
+
+runner.run_steps({
+    function()
+        local d = drawin {}
+        local mt = getmetatable(d)
+
+        assert(d.metatable_test_field == nil)
+        mt.metatable_test_field = 42
+        assert(d.metatable_test_field == 42)
+
+        -- And removing it again works as well
+        mt.metatable_test_field = nil
+        assert(d.metatable_test_field == nil)
+
+        return true
+    end,
+})
+
+-- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
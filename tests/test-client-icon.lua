@@ -0,0 +1,79 @@
+-- Test that _NET_WM_ICON is split into sizes and decoded when needed
+
+local runner = require("_runner")
+local test_client = require("_client")
+local gears_surface = require("gears.surface")
+
+local function get_client()
+    for _, c in ipairs(client.get()) do
+        if c.class == "icon_test" then
+            return c
+        end
+    end
+end
+
+local function size_of(surf)
+    local w, h = gears_surface.get_size(gears_surface(surf))
+    return w, h
+end
+
+runner.run_steps({
+    function(count)
+        if count == 1 then
+            test_client("icon_test", "icon_test", nil, nil, nil, { icon_sizes = { 16, 48, 128 } })
+        end
+        local c = get_client()
+        return c and #c.icon_sizes > 0 or nil
+    end,
+
+    function()
+        local c = get_client()
+        local sizes = c.icon_sizes
+        assert(#sizes == 3, #sizes)
+        local seen = {}
+        for i, wh in ipairs(sizes) do
+            local size = wh[1]
+            assert(wh[2] == size)
+            seen[size] = true
+            local w, h = size_of(c:get_icon(i))
+            assert(w == size and h == size)
+            -- Decoding happens once, the second call gets the same result
+            w, h = size_of(c:get_icon(i))
+            assert(w == size and h == size)
+        end
+        assert(seen[16] and seen[48] and seen[128])
+
+        -- The closest larger icon is picked
+        awesome.set_preferred_icon_size(32)
+        local w = size_of(c.icon)
+        assert(w == 48, w)
+        awesome.set_preferred_icon_size(200)
+        w = size_of(c.icon)
+        assert(w == 128, w)
+
+        return true
+    end,
+
+    -- A second client with the same icons shares the decoded surfaces
+    function(count)
+        if count == 1 then
+            test_client("icon_test2", "icon_test2", nil, nil, nil, { icon_sizes = { 16, 48, 128 } })
+        end
+        for _, c in ipairs(client.get()) do
+            if c.class == "icon_test2" and #c.icon_sizes > 0 then
+                local before = client.icon_cache()
+                assert(before.icons >= 1 and before.bytes > 0)
+                size_of(c.icon)
+                local after = client.icon_cache()
+                assert(after.hits == before.hits + 1, after.hits)
+                assert(after.icons == before.icons)
+                assert(after.hit_rate > 0)
+                c:kill()
+                get_client():kill()
+                return true
+            end
+        end
+    end,
+})
+
+-- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
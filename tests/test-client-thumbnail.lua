@@ -0,0 +1,140 @@
+-- Test that client thumbnails are cached until the client's content changes
+
+local runner = require("_runner")
+local test_client = require("_client")
+local gears_surface = require("gears.surface")
+
+local function get_client()
+    for _, c in ipairs(client.get()) do
+        if c.class == "thumbnail_test" then
+            return c
+        end
+    end
+end
+
+local function size_of(surf)
+    local w, h = gears_surface.get_size(gears_surface(surf))
+    return w, h
+end
+
+local stats
+
+runner.run_steps({
+    function(count)
+        if count == 1 then
+            test_client("thumbnail_test", "thumbnail_test")
+        end
+        local c = get_client()
+        if not c then return end
+
+        -- Wait until there is something to look at
+        if count < 3 then return end
+
+        c:geometry { width = 400, height = 200 }
+        return true
+    end,
+
+    function(count)
+        local c = get_client()
+        if c.width ~= 400 and count < 10 then return end
+
+        stats = client.thumbnail_cache()
+        local surf = c:thumbnail(100, 100)
+        assert(surf, "no Composite or DAMAGE extension?")
+
+        -- The aspect ratio is kept
+        local w, h = size_of(surf)
+        assert(w <= 100 and h <= 100, w .. "x" .. h)
+        assert(w == 100 or h == 100, w .. "x" .. h)
+
+        local new_stats = client.thumbnail_cache()
+        assert(new_stats.misses == stats.misses + 1)
+        assert(new_stats.thumbnails == stats.thumbnails + 1)
+        assert(new_stats.bytes > stats.bytes)
+
+        -- Never larger than the client
+        w, h = size_of(c:thumbnail(4000, 4000))
+        assert(w <= c.width and h <= c.height, w .. "x" .. h)
+
+        return true
+    end,
+
+    -- Give damage from the window being shown a chance to arrive
+    function(count)
+        if count < 5 then return end
+
+        local c = get_client()
+        c:thumbnail(100, 100)
+        stats = client.thumbnail_cache()
+
+        -- Nothing changed, this is a lookup
+        assert(size_of(c:thumbnail(100, 100)))
+        assert(client.thumbnail_cache().hits == stats.hits + 1)
+
+        -- Resizing changes the content
+        c:geometry { width = 300, height = 300 }
+        return true
+    end,
+
+    function(count)
+        local c = get_client()
+        stats = client.thumbnail_cache()
+        c:thumbnail(100, 100)
+        local new_stats = client.thumbnail_cache()
+        if new_stats.misses == stats.misses then
+            -- DamageNotify did not arrive yet
+            return count > 20 and error("thumbnail not invalidated") or nil
+        end
+
+        -- And the new content is cached again
+        local w, h = size_of(c:thumbnail(100, 100))
+        assert(w <= 100 and h <= 100, w .. "x" .. h)
+        assert(client.thumbnail_cache().hits == new_stats.hits + 1)
+
+        return true
+    end,
+
+    -- The budget is enforced, but the latest thumbnail stays
+    function()
+        local c = get_client()
+        stats = client.thumbnail_cache()
+        client.set_thumbnail_budget(1)
+        c:thumbnail(50, 50)
+
+        local new_stats = client.thumbnail_cache()
+        assert(new_stats.thumbnails == 1, new_stats.thumbnails)
+        assert(new_stats.evictions > stats.evictions)
+        assert(new_stats.budget == 1)
+
+        client.set_thumbnail_budget(16 * 1024 * 1024)
+        return true
+    end,
+
+    -- A hidden client without a thumbnail costs no round trip
+    function()
+        local c = get_client()
+        c.minimized = true
+
+        local waits = awesome.stats().x11.waits
+        assert(c:thumbnail(30, 30) == nil)
+        assert(awesome.stats().x11.waits == waits)
+
+        return true
+    end,
+
+    -- Unmanaging forgets the client's thumbnails
+    function(count)
+        local c = get_client()
+        if count == 1 then
+            c:kill()
+        end
+        if c then return end
+
+        assert(client.thumbnail_cache().thumbnails == 0)
+        assert(client.thumbnail_cache().bytes == 0)
+
+        return true
+    end,
+})
+
+-- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
@@ -0,0 +1,48 @@
+-- Test that resized drawables reuse their pixmaps
+
+local runner = require("_runner")
+local wibox = require("wibox")
+
+local function pool()
+    return drawable.pixmap_pool()
+end
+
+local w1, w2, before
+
+runner.run_steps({
+    function()
+        w1 = wibox { x = 10, y = 10, width = 100, height = 20, visible = true }
+        before = pool()
+
+        -- A slightly different size fits into the same pixmap
+        w1.width = 110
+        assert(pool().kept == before.kept + 1)
+        assert(pool().misses == before.misses)
+
+        -- Growing a lot needs a new pixmap, the old one goes to the pool
+        w1.width = 300
+        assert(pool().misses == before.misses + 1)
+        assert(pool().retained_pixmaps == before.retained_pixmaps + 1)
+        assert(pool().retained_bytes > before.retained_bytes)
+
+        -- Another drawable of the original size gets the pooled pixmap
+        w2 = wibox { x = 10, y = 40, width = 100, height = 20, visible = true }
+        assert(pool().hits >= before.hits + 1)
+        assert(pool().hit_rate > 0 and pool().hit_rate <= 1)
+
+        return true
+    end,
+
+    function()
+        drawable.trim_pixmap_pool()
+        assert(pool().retained_pixmaps == 0)
+        assert(pool().retained_bytes == 0)
+
+        -- Both wiboxes still work
+        w1.bg = "#ff0000"
+        w2.bg = "#00ff00"
+        return true
+    end,
+})
+
+-- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
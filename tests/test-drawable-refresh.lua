@@ -0,0 +1,62 @@
+-- Test the different ways of refreshing parts of a drawable
+
+local runner = require("_runner")
+local wibox = require("wibox")
+
+local w = wibox {
+    x = 10,
+    y = 10,
+    width = 100,
+    height = 20,
+    visible = true,
+    bg = "#ff0000",
+}
+local d = w.drawin.drawable
+
+runner.run_steps({
+    function()
+        -- Everything
+        d:refresh()
+        -- A single rectangle
+        d:refresh(10, 5, 20, 10)
+        -- A list of rectangles, partially outside of the drawable or empty
+        d:refresh({
+            { x = 0, y = 0, width = 10, height = 10 },
+            { x = 90, y = 10, width = 50, height = 50 },
+            { x = 5, y = 5, width = 0, height = 5 },
+        })
+        d:refresh({})
+
+        assert(not pcall(d.refresh, d, 1, 2))
+        assert(not pcall(d.refresh, d, { 42 }))
+        return true
+    end,
+
+    -- Partial repaints of the wibox go through the same path
+    function(count)
+        if count == 1 then
+            w.bg = "#00ff00"
+        end
+        return count == 3 or nil
+    end,
+
+    -- The same with local rendering into MIT-SHM, if available
+    function(count)
+        if count == 1 then
+            assert(not d.shm)
+            d.shm = true
+            assert(type(d.shm) == "boolean")
+            w.bg = "#0000ff"
+        end
+        if count == 2 then
+            d:refresh(10, 5, 20, 10)
+        end
+        if count == 3 then
+            d.shm = false
+            assert(not d.shm)
+        end
+        return count == 5 or nil
+    end,
+})
+
+-- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
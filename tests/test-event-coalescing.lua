@@ -0,0 +1,45 @@
+-- Test that redundant X events are dropped before they are handled
+
+local runner = require("_runner")
+
+local prop = "_AWESOME_TEST_COALESCING"
+local signals, dropped_before = 0, nil
+
+awesome.register_xproperty(prop, "number")
+awesome.connect_signal("xproperty::" .. prop, function()
+    signals = signals + 1
+end)
+
+local steps = {
+    function()
+        dropped_before = awesome._dropped_events.property_notify
+
+        -- Only the last value matters, the handlers read it from the server
+        for i = 1, 5 do
+            awesome.set_xproperty(prop, i)
+        end
+
+        -- All five PropertyNotify events arrive before the reply, so they are
+        -- read and coalesced together
+        awesome.sync()
+
+        return true
+    end,
+
+    function()
+        if signals == 0 then
+            return
+        end
+
+        local dropped = awesome._dropped_events.property_notify - dropped_before
+        assert(dropped == 4, dropped)
+        assert(signals == 1, signals)
+        assert(awesome.get_xproperty(prop) == 5)
+
+        return true
+    end,
+}
+
+runner.run_steps(steps)
+
+-- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
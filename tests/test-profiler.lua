@@ -0,0 +1,38 @@
+-- Test the Lua sampling profiler
+
+local runner = require("_runner")
+
+local function busy_profiler_test_function()
+    local x = 0
+    local deadline = os.clock() + 0.2
+    while os.clock() < deadline do
+        x = x + math.sin(x)
+    end
+    return x
+end
+
+local steps = {
+    function()
+        assert(not pcall(awesome.profiler.stop))
+
+        awesome.profiler.start { hz = 1000 }
+        assert(not pcall(awesome.profiler.start))
+
+        busy_profiler_test_function()
+
+        local folded = awesome.profiler.stop()
+        local samples = 0
+        for stack, count in folded:gmatch("([^\n]*) (%d+)\n") do
+            assert(stack ~= "")
+            samples = samples + tonumber(count)
+        end
+        assert(samples > 0, folded)
+        assert(folded:find("busy_profiler_test_function", 1, true), folded)
+
+        return true
+    end,
+}
+
+runner.run_steps(steps)
+
+-- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
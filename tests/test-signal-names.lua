@@ -0,0 +1,62 @@
+-- Signal names passed from Lua are resolved the same way no matter which
+-- string object carries them. Long strings are not interned by Lua, so a
+-- name built at runtime can be a different string than the one used to
+-- connect the handler.
+
+local runner = require("_runner")
+
+local long_name = "property::" .. string.rep("long_signal_name_", 4)
+
+local function make_name(prefix)
+    return prefix .. string.rep("long_signal_name_", 4)
+end
+
+runner.run_steps({
+    function()
+        -- Global signals
+        local count = 0
+        local function handler() count = count + 1 end
+
+        awesome.connect_signal(long_name, handler)
+        awesome.emit_signal(make_name("property::"))
+        assert(count == 1, count)
+        awesome.disconnect_signal(make_name("property::"), handler)
+        awesome.emit_signal(long_name)
+        assert(count == 1, count)
+
+        -- Numbers are accepted as names, like before
+        awesome.connect_signal(42, handler)
+        awesome.emit_signal("42")
+        assert(count == 2, count)
+        awesome.disconnect_signal("42", handler)
+        awesome.emit_signal(42)
+        assert(count == 2, count)
+
+        -- Object signals
+        local d = drawin {}
+        local args
+        local function obj_handler(...) args = {...} end
+        d:connect_signal(long_name, obj_handler)
+        d:emit_signal(make_name("property::"), "a", "b")
+        assert(args and args[1] == d and args[2] == "a" and args[3] == "b")
+        args = nil
+        d:disconnect_signal(make_name("property::"), obj_handler)
+        d:emit_signal(long_name)
+        assert(args == nil)
+
+        -- Class signals
+        local class_count = 0
+        local function class_handler() class_count = class_count + 1 end
+        drawin.connect_signal(long_name, class_handler)
+        drawin.emit_signal(make_name("property::"))
+        d:emit_signal(make_name("property::"))
+        assert(class_count == 2, class_count)
+        drawin.disconnect_signal(make_name("property::"), class_handler)
+        drawin.emit_signal(long_name)
+        assert(class_count == 2, class_count)
+
+        return true
+    end,
+})
+
+-- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
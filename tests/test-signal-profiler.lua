@@ -0,0 +1,55 @@
+-- Test the signal dispatch statistics of awesome.profiler
+
+local runner = require("_runner")
+
+local function find(stats, class, name)
+    for _, entry in ipairs(stats) do
+        if entry.class == class and entry.name == name then
+            return entry
+        end
+    end
+end
+
+local steps = {
+    function()
+        local s = screen.primary
+        local calls = 0
+        local function handler() calls = calls + 1 end
+        s:connect_signal("profiler::test", handler)
+        s:connect_signal("profiler::test", handler)
+        awesome.connect_signal("profiler::test", handler)
+
+        -- Nothing is recorded while profiling is disabled
+        s:emit_signal("profiler::test")
+        assert(not find(awesome.profiler.signal_stats(), "screen", "profiler::test"))
+
+        awesome.profiler.signals(true)
+        for _ = 1, 3 do
+            s:emit_signal("profiler::test")
+        end
+        awesome.emit_signal("profiler::test")
+        awesome.profiler.signals(false)
+
+        local entry = find(awesome.profiler.signal_stats(), "screen", "profiler::test")
+        assert(entry.count == 3, entry.count)
+        assert(entry.handlers == 6, entry.handlers)
+        assert(entry.time >= entry.max_time and entry.max_time >= 0)
+
+        entry = find(awesome.profiler.signal_stats(), nil, "profiler::test")
+        assert(entry.count == 1 and entry.handlers == 1)
+        assert(calls == 9, calls)
+
+        awesome.profiler.reset_signals()
+        assert(#awesome.profiler.signal_stats() == 0)
+
+        s:disconnect_signal("profiler::test", handler)
+        s:disconnect_signal("profiler::test", handler)
+        awesome.disconnect_signal("profiler::test", handler)
+
+        return true
+    end,
+}
+
+runner.run_steps(steps)
+
+-- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
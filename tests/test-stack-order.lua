@@ -0,0 +1,284 @@
+-- The stacking order in X and in _NET_CLIENT_LIST_STACKING follows the
+-- client stack and the layers after raising, lowering and changing layers,
+-- also when foreign override-redirect windows are around.
+
+local runner = require("_runner")
+local test_client = require("_client")
+local wibox = require("wibox")
+
+local clients = {}
+local wb
+
+local function read_command(cmd)
+    local file = io.popen(cmd)
+    local result = file:read("*all")
+    file:close()
+    return result
+end
+
+-- _NET_CLIENT_LIST_STACKING, bottom first
+local function get_stacking_property()
+    local result = {}
+    local value = read_command("xprop -notype -root _NET_CLIENT_LIST_STACKING")
+    for id in string.gmatch(value, "0x%x+") do
+        table.insert(result, tonumber(id))
+    end
+    return result
+end
+
+-- The children of the root window in X, bottom first, and the names of the
+-- windows that have one
+local function get_x_order()
+    local ids, names = {}, {}
+    local value = read_command("xwininfo -root -children")
+    -- xwininfo lists the children from top to bottom
+    for line in string.gmatch(value, "[^\n]+") do
+        local id, name = string.match(line, '^%s+(0x%x+) "(.-)":')
+        id = id or string.match(line, "^%s+(0x%x+) ")
+        if id then
+            table.insert(ids, 1, tonumber(id))
+            if name then
+                names[name] = tonumber(id)
+            end
+        end
+    end
+    return ids, names
+end
+
+-- The window of a client that is a child of the root window
+local frames = {}
+local function get_frame(c)
+    if not frames[c] then
+        local value = read_command(string.format("xwininfo -id 0x%x", c.window))
+        frames[c] = tonumber(string.match(value, "Parent window id: (0x%x+)"))
+    end
+    return frames[c]
+end
+
+local function layer(c)
+    if c.ontop then
+        return 4
+    elseif c.above then
+        return 3
+    elseif c.below then
+        return 1
+    end
+    return 2
+end
+
+-- Our clients as they are in the client stack, bottom first
+local function get_client_stack()
+    local result = {}
+    for _, c in ipairs(client.get(nil, true)) do
+        if clients[c.class] == c then
+            table.insert(result, 1, c)
+        end
+    end
+    return result
+end
+
+-- Keep only the items of list that are in wanted, in the same order
+local function filter(list, wanted)
+    local set, result = {}, {}
+    for _, v in ipairs(wanted) do
+        set[v] = true
+    end
+    for _, v in ipairs(list) do
+        if set[v] then
+            table.insert(result, v)
+        end
+    end
+    return result
+end
+
+local function same(a, b)
+    if #a ~= #b then
+        return false
+    end
+    for i = 1, #a do
+        if a[i] ~= b[i] then
+            return false
+        end
+    end
+    return true
+end
+
+local function dump(list)
+    local result = {}
+    for _, v in ipairs(list) do
+        table.insert(result, string.format("0x%x", v))
+    end
+    return "{" .. table.concat(result, ", ") .. "}"
+end
+
+-- Check both orders against the client stack and the layers. The orders are
+-- read from the X server, so give it some iterations to catch up.
+local function check_order(count)
+    local stack = get_client_stack()
+
+    -- The property lists the client stack without looking at layers
+    local expected_prop = {}
+    for _, c in ipairs(stack) do
+        table.insert(expected_prop, c.window)
+    end
+
+    -- Frames are stacked by layer and drawins that are on top come last
+    local expected_x = {}
+    for l = 1, 4 do
+        for _, c in ipairs(stack) do
+            if layer(c) == l then
+                table.insert(expected_x, get_frame(c))
+            end
+        end
+    end
+    table.insert(expected_x, wb.drawin.window)
+
+    local prop = filter(get_stacking_property(), expected_prop)
+    local x_order = filter((get_x_order()), expected_x)
+
+    if same(prop, expected_prop) and same(x_order, expected_x) then
+        return true
+    end
+
+    assert(count < 10, string.format(
+        "_NET_CLIENT_LIST_STACKING %s, expected %s; X order %s, expected %s",
+        dump(prop), dump(expected_prop), dump(x_order), dump(expected_x)))
+end
+
+-- Wait until the named foreign window is mapped, without being managed
+local function wait_for_foreign_window(name)
+    return function(count)
+        local _, names = get_x_order()
+        if not names[name] then
+            assert(count < 20, "foreign window " .. name .. " did not appear")
+            return
+        end
+        -- The window is not ours, so it must not show up as a client
+        for _, c in ipairs(client.get()) do
+            assert(c.name ~= name)
+        end
+        return true
+    end
+end
+
+local steps = {
+    -- Three clients and a wibox that is on top of them
+    function(count)
+        if count == 1 then
+            for _, class in ipairs { "stack_a", "stack_b", "stack_c" } do
+                test_client(class, class)
+            end
+            wb = wibox { ontop = true, visible = true, x = 0, y = 0,
+                         width = 20, height = 20 }
+        end
+
+        for _, c in ipairs(client.get()) do
+            clients[c.class] = c
+        end
+        if clients.stack_a and clients.stack_b and clients.stack_c then
+            return true
+        end
+    end,
+
+    -- Give the clients a known order, bottom first
+    function()
+        clients.stack_a:raise()
+        clients.stack_b:raise()
+        clients.stack_c:raise()
+        return true
+    end,
+    check_order,
+
+    function()
+        assert(same(get_client_stack(),
+                    { clients.stack_a, clients.stack_b, clients.stack_c }))
+        clients.stack_a:raise()
+        return true
+    end,
+    check_order,
+
+    function()
+        assert(get_client_stack()[3] == clients.stack_a)
+        clients.stack_a:lower()
+        return true
+    end,
+    check_order,
+
+    function()
+        assert(get_client_stack()[1] == clients.stack_a)
+        clients.stack_a.ontop = true
+        return true
+    end,
+    check_order,
+
+    -- Raising a client does not put it above a client that is on top
+    function()
+        clients.stack_c:raise()
+        return true
+    end,
+    check_order,
+
+    function()
+        clients.stack_a.ontop = false
+        clients.stack_c.below = true
+        return true
+    end,
+    check_order,
+
+    function()
+        clients.stack_b.above = true
+        clients.stack_c:raise()
+        return true
+    end,
+    check_order,
+
+    -- A foreign override-redirect window is mapped on top of everything
+    function()
+        test_client("stack_foreign", "stack_foreign", nil, nil, nil,
+                    { override_redirect = true })
+        return true
+    end,
+    wait_for_foreign_window("stack_foreign"),
+    check_order,
+
+    -- Our windows keep their order around it
+    function()
+        clients.stack_b.above = false
+        clients.stack_c.below = false
+        clients.stack_a:raise()
+        return true
+    end,
+    check_order,
+
+    function()
+        clients.stack_c:lower()
+        clients.stack_b.ontop = true
+        return true
+    end,
+    check_order,
+
+    -- A client that goes away leaves the others where they are
+    function(count)
+        if count == 1 then
+            clients.stack_a:kill()
+        end
+        if clients.stack_a.valid then
+            return
+        end
+        clients.stack_a = nil
+        return true
+    end,
+    check_order,
+
+    function()
+        wb.visible = false
+        for _, c in pairs(clients) do
+            c:kill()
+        end
+        return true
+    end,
+}
+
+runner.run_steps(steps)
+
+-- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
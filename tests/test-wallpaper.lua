@@ -4,6 +4,7 @@ local runner = require("_runner")
 local wp = require("gears.wallpaper")
 local color = require("gears.color")
 local cairo = require( "lgi" ).cairo
+local GdkPixbuf = require("lgi").GdkPixbuf
 local surface = require("gears.surface")
 
 local steps = {}
@@ -134,6 +135,152 @@ return true
 end)
 
 
+-- Updates are uploaded from the main loop once they are rendered
+local changed = 0
+awesome.connect_signal("wallpaper_changed", function() changed = changed + 1 end)
+
+local changed_before
+table.insert(steps, function()
+    changed_before = changed
+
+    -- Only update a part of the root window
+    assert(root.wallpaper(color("#ff0000")._native, { x = 0, y = 0, width = 10, height = 10 }))
+
+    -- An empty area is refused
+    assert(not root.wallpaper(color("#ff0000")._native, { x = 0, y = 0, width = 0, height = 10 }))
+
+    return true
+end)
+
+table.insert(steps, function()
+    if changed == changed_before then return end
+
+    -- The root pixmap is reused and can be read back
+    local w, h = surface.get_size(surface(root.wallpaper()))
+    local rw, rh = root.size()
+    assert(w == rw and h == rh)
+
+    -- X11 surfaces are rendered on the main thread, but still go through the
+    -- same queue
+    local current = surface(root.wallpaper())
+    changed_before = changed
+    wp.set(current)
+
+    return true
+end)
+
+-- Only files are cached, surfaces may be drawn to after they were used
+local img_path = os.tmpname()
+img:write_to_png(img_path)
+
+local info
+table.insert(steps, function()
+    if changed == changed_before then return end
+
+    info = wp.cache_info()
+    wp.maximized(img, screen[1], true)
+    assert(wp.cache_info().misses == info.misses)
+
+    wp.maximized(img_path, screen[1], true)
+
+    -- Uploads only happen from the main loop. Until then, the worker may still
+    -- be painting the image, so it is not handed out.
+    require("gears.timer").run_delayed_calls_now()
+    assert(root._wallpaper_queued() > 0)
+    wp.maximized(img_path, screen[1], true)
+    assert(wp.cache_info().hits == info.hits)
+
+    return true
+end)
+
+table.insert(steps, function()
+    if root._wallpaper_queued() > 0 then return end
+
+    -- The first ones are rendered
+    local new_info = wp.cache_info()
+    assert(new_info.misses == info.misses + 2)
+    assert(new_info.entries >= 1)
+    assert(new_info.bytes > 0)
+
+    -- Setting it again, e.g. after a RandR change, is just a lookup
+    changed_before = changed
+    wp.maximized(img_path, screen[1], true)
+    assert(wp.cache_info().hits == info.hits + 1)
+
+    -- A file that was rewritten is rendered again
+    local other = cairo.ImageSurface.create(cairo.Format.ARGB32, 50, 50)
+    other:write_to_png(img_path)
+    wp.maximized(img_path, screen[1], true)
+    assert(wp.cache_info().hits == info.hits + 1)
+    assert(wp.cache_info().misses == info.misses + 3)
+
+    return true
+end)
+
+table.insert(steps, function()
+    if changed == changed_before then return end
+
+    -- The cache stays below its limit, but keeps the latest entry
+    wp.cache_limit = 1
+    wp.maximized(img_path, screen[1], false)
+    wp.maximized(img_path, screen[1], false, { x = 5, y = 5 })
+
+    return true
+end)
+
+table.insert(steps, function()
+    assert(wp.cache_info().entries == 1)
+    wp.cache_limit = 128 * 1024 * 1024
+    os.remove(img_path)
+
+    changed_before = changed
+    wp.set("#ff0000")
+
+    return true
+end)
+
+-- Get the pixel at the top left corner of the first screen
+local function first_pixel()
+    local geo = screen[1].geometry
+    local pixel = cairo.ImageSurface(cairo.Format.RGB24, 1, 1)
+    local cr = cairo.Context(pixel)
+    cr:set_source_surface(surface(root.wallpaper()), -geo.x, -geo.y)
+    cr:paint()
+
+    -- Read the pixel back through a PNG
+    local path = os.tmpname()
+    pixel:write_to_png(path)
+    local pixbuf = GdkPixbuf.Pixbuf.new_from_file(path)
+    os.remove(path)
+    return pixbuf:get_pixels_with_length():byte(1, 3)
+end
+
+table.insert(steps, function()
+    if changed == changed_before then return end
+
+    -- Getting the wallpaper does not wait, earlier updates may still be
+    -- uploaded first
+    local r, g, b = first_pixel()
+    if r ~= 0xff or g ~= 0 or b ~= 0 then return end
+
+    -- Drawing through prepare_context() goes on top of the current wallpaper
+    changed_before = changed
+    local _, cr = wp.prepare_context(screen[1])
+    cr:set_source_rgba(0, 0, 1, 0.5)
+    cr:paint()
+
+    return true
+end)
+
+table.insert(steps, function()
+    if changed == changed_before then return end
+
+    local r, _, b = first_pixel()
+    assert(math.abs(r - 0x80) <= 1 and math.abs(b - 0x80) <= 1, r .. " " .. b)
+
+    return true
+end)
+
 runner.run_steps(steps)
 
 -- vim: filetype=lua:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
@@ -0,0 +1,390 @@
+/*
+ * thumbnail.c - client thumbnail cache
+ *
+ * Copyright © 2026 Awesome Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/* Thumbnails are scaled-down copies of a client's content. They are read from
+ * the window's Composite pixmap, so covered parts come out right. A window is
+ * redirected automatically the first time a thumbnail of it is requested and a
+ * Damage object then tells us when its thumbnails are outdated. Until that
+ * happens, the cached image is handed out again without talking to the X
+ * server. Once all thumbnails of a client were evicted, its window is
+ * unredirected again.
+ *
+ * Clients on other tags are unmapped, so their content can not be read. Their
+ * outdated thumbnails are refreshed just before they are hidden, but a client
+ * that never had a thumbnail while it was visible has none until it is shown
+ * again.
+ */
+
+#include "thumbnail.h"
+#include "globalconf.h"
+#include "draw.h"
+#include "stats.h"
+
+#include <cairo-xcb.h>
+#include <math.h>
+#include <xcb/composite.h>
+
+typedef struct
+{
+    client_t *client;
+    /** The requested size, the image is at most this large */
+    uint16_t width, height;
+    cairo_surface_t *surface;
+    size_t bytes;
+    /** The window changed since the image was made */
+    bool stale;
+    /** For finding the least recently used thumbnail */
+    uint64_t last_use;
+} thumbnail_t;
+
+static void
+thumbnail_wipe(thumbnail_t *thumbnail)
+{
+    cairo_surface_destroy(thumbnail->surface);
+}
+
+DO_ARRAY(thumbnail_t, thumbnail, thumbnail_wipe)
+
+static struct
+{
+    thumbnail_array_t thumbnails;
+    /** Total size of all images */
+    size_t bytes;
+    /** How large bytes may get */
+    size_t budget;
+    uint64_t clock;
+    uint64_t hits, misses, evictions;
+} thumbnail_cache = { .budget = 16 * 1024 * 1024 };
+
+static thumbnail_t *
+thumbnail_find(client_t *c, uint16_t width, uint16_t height)
+{
+    foreach(thumbnail, thumbnail_cache.thumbnails)
+        if (thumbnail->client == c && thumbnail->width == width && thumbnail->height == height)
+            return thumbnail;
+    return NULL;
+}
+
+static bool
+thumbnail_client_has_any(client_t *c)
+{
+    foreach(thumbnail, thumbnail_cache.thumbnails)
+        if (thumbnail->client == c)
+            return true;
+    return false;
+}
+
+static void
+thumbnail_remove(int index)
+{
+    thumbnail_t thumbnail = thumbnail_array_take(&thumbnail_cache.thumbnails, index);
+    thumbnail_cache.bytes -= thumbnail.bytes;
+    thumbnail_wipe(&thumbnail);
+}
+
+/** Stop tracking changes of a client's window. It is unredirected again, so
+ * e.g. fullscreen clients can be shown without going through a copy.
+ * \param c The client.
+ * \param window_exists false if the window was already destroyed.
+ */
+static void
+thumbnail_unwatch(client_t *c, bool window_exists)
+{
+    if (c->damage == XCB_NONE)
+        return;
+
+    /* The damage object went away with the window otherwise */
+    if (window_exists)
+    {
+        xcb_damage_destroy(globalconf.connection, c->damage);
+        xcb_composite_unredirect_window(globalconf.connection, c->window,
+                                        XCB_COMPOSITE_REDIRECT_AUTOMATIC);
+    }
+    c->damage = XCB_NONE;
+}
+
+/** Evict the least recently used thumbnails until the cache fits into its
+ * budget. The most recently used one always stays.
+ */
+static void
+thumbnail_evict(void)
+{
+    while (thumbnail_cache.bytes > thumbnail_cache.budget
+           && thumbnail_cache.thumbnails.len > 1)
+    {
+        int oldest = 0;
+        for (int i = 1; i < thumbnail_cache.thumbnails.len; i++)
+            if (thumbnail_cache.thumbnails.tab[i].last_use
+                < thumbnail_cache.thumbnails.tab[oldest].last_use)
+                oldest = i;
+        client_t *c = thumbnail_cache.thumbnails.tab[oldest].client;
+        thumbnail_remove(oldest);
+        thumbnail_cache.evictions++;
+        if (!thumbnail_client_has_any(c))
+            thumbnail_unwatch(c, true);
+    }
+}
+
+/** Start tracking changes of a client's window.
+ * \param c The client.
+ */
+static void
+thumbnail_watch(client_t *c)
+{
+    if (c->damage != XCB_NONE)
+    {
+        /* Get a new DamageNotify on the next change */
+        xcb_damage_subtract(globalconf.connection, c->damage, XCB_NONE, XCB_NONE);
+        return;
+    }
+
+    /* Automatic redirection keeps the window on screen as before, but gives it
+     * a pixmap of its own that we can read. */
+    xcb_composite_redirect_window(globalconf.connection, c->window,
+                                  XCB_COMPOSITE_REDIRECT_AUTOMATIC);
+    c->damage = xcb_generate_id(globalconf.connection);
+    xcb_damage_create(globalconf.connection, c->damage, c->window,
+                      XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+}
+
+/** Scale a client's current content.
+ * \param c The client.
+ * \param width The maximum width.
+ * \param height The maximum height.
+ * \return A new image surface or NULL if the content is not available.
+ */
+static cairo_surface_t *
+thumbnail_render(client_t *c, uint16_t width, uint16_t height)
+{
+    xcb_void_cookie_t cookie;
+    xcb_generic_error_t *error;
+    xcb_pixmap_t pixmap;
+    cairo_surface_t *source, *surface;
+    cairo_t *cr;
+    int content_width  = c->geometry.width;
+    int content_height = c->geometry.height;
+
+    if (!globalconf.have_composite || !globalconf.have_damage || c->window == XCB_NONE)
+        return NULL;
+
+    /* The frame or the window is unmapped, so the pixmap can not be named.
+     * Don't redirect the window and wait for an error just to find out. */
+    if (c->isbanned || c->minimized)
+        return NULL;
+
+    /* Just the client size without decorations */
+    content_width  -= c->titlebar[CLIENT_TITLEBAR_LEFT].size + c->titlebar[CLIENT_TITLEBAR_RIGHT].size;
+    content_height -= c->titlebar[CLIENT_TITLEBAR_TOP].size + c->titlebar[CLIENT_TITLEBAR_BOTTOM].size;
+    if (content_width <= 0 || content_height <= 0)
+        return NULL;
+
+    thumbnail_watch(c);
+
+    /* This still fails if the window is not viewable for other reasons */
+    pixmap = xcb_generate_id(globalconf.connection);
+    cookie = xcb_composite_name_window_pixmap_checked(globalconf.connection, c->window, pixmap);
+    error = A_XCB_WAIT(xcb_request_check(globalconf.connection, cookie));
+    if (error)
+    {
+        p_delete(&error);
+        return NULL;
+    }
+
+    /* Fit into the requested size, but never scale up */
+    double scale = MIN(1.0, MIN((double) width / content_width, (double) height / content_height));
+    int thumb_width  = MAX(1, lround(content_width * scale));
+    int thumb_height = MAX(1, lround(content_height * scale));
+    bool alpha = draw_visual_depth(globalconf.screen, c->visualtype->visual_id) == 32;
+
+    source = cairo_xcb_surface_create(globalconf.connection, pixmap, c->visualtype,
+                                      content_width, content_height);
+    surface = cairo_image_surface_create(alpha ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24,
+                                         thumb_width, thumb_height);
+    cr = cairo_create(surface);
+    cairo_scale(cr, (double) thumb_width / content_width, (double) thumb_height / content_height);
+    cairo_set_source_surface(cr, source, 0, 0);
+    cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_GOOD);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    cairo_surface_flush(surface);
+
+    cairo_surface_finish(source);
+    cairo_surface_destroy(source);
+    xcb_free_pixmap(globalconf.connection, pixmap);
+
+    return surface;
+}
+
+/** Replace the image of a thumbnail.
+ * \param thumbnail The thumbnail.
+ * \param surface The new image, the thumbnail takes over the reference.
+ */
+static void
+thumbnail_set_surface(thumbnail_t *thumbnail, cairo_surface_t *surface)
+{
+    thumbnail_cache.bytes -= thumbnail->bytes;
+    cairo_surface_destroy(thumbnail->surface);
+
+    thumbnail->surface = surface;
+    thumbnail->bytes = (size_t) cairo_image_surface_get_stride(surface)
+                       * cairo_image_surface_get_height(surface);
+    thumbnail->stale = false;
+    thumbnail_cache.bytes += thumbnail->bytes;
+}
+
+/** Get a thumbnail of a client.
+ * \param c The client.
+ * \param width The maximum width.
+ * \param height The maximum height.
+ * \return An image surface that is owned by the cache, or NULL.
+ */
+cairo_surface_t *
+thumbnail_get(client_t *c, uint16_t width, uint16_t height)
+{
+    thumbnail_t *thumbnail = thumbnail_find(c, width, height);
+    cairo_surface_t *surface;
+
+    if (thumbnail && !thumbnail->stale)
+    {
+        thumbnail_cache.hits++;
+        thumbnail->last_use = ++thumbnail_cache.clock;
+        return thumbnail->surface;
+    }
+
+    thumbnail_cache.misses++;
+    surface = thumbnail_render(c, width, height);
+    if (!surface)
+    {
+        /* Better an outdated image than none, e.g. while the window is
+         * unmapped. */
+        if (!thumbnail)
+        {
+            /* Don't keep the window redirected for nothing */
+            if (!thumbnail_client_has_any(c))
+                thumbnail_unwatch(c, true);
+            return NULL;
+        }
+        thumbnail->last_use = ++thumbnail_cache.clock;
+        return thumbnail->surface;
+    }
+
+    if (!thumbnail)
+    {
+        thumbnail_array_append(&thumbnail_cache.thumbnails, (thumbnail_t) {
+            .client = c,
+            .width = width,
+            .height = height
+        });
+        thumbnail = &thumbnail_cache.thumbnails.tab[thumbnail_cache.thumbnails.len - 1];
+    }
+
+    thumbnail_set_surface(thumbnail, surface);
+    thumbnail->last_use = ++thumbnail_cache.clock;
+
+    thumbnail_evict();
+    return surface;
+}
+
+/** Refresh the outdated thumbnails of a client before it is banned. Its window
+ * is unmapped then and its content can not be read until it is shown again.
+ * \param c The client.
+ */
+void
+thumbnail_client_banned(client_t *c)
+{
+    if (c->damage == XCB_NONE)
+        return;
+
+    foreach(thumbnail, thumbnail_cache.thumbnails)
+        if (thumbnail->client == c && thumbnail->stale)
+        {
+            cairo_surface_t *surface = thumbnail_render(c, thumbnail->width, thumbnail->height);
+            if (surface)
+                thumbnail_set_surface(thumbnail, surface);
+        }
+
+    thumbnail_evict();
+}
+
+/** Mark a client's thumbnails as outdated after a DamageNotify.
+ * \param c The client.
+ */
+void
+thumbnail_client_damaged(client_t *c)
+{
+    foreach(thumbnail, thumbnail_cache.thumbnails)
+        if (thumbnail->client == c)
+            thumbnail->stale = true;
+}
+
+/** Forget everything about a client that is being unmanaged.
+ * \param c The client.
+ * \param window_exists false if the window was already destroyed.
+ */
+void
+thumbnail_client_unmanage(client_t *c, bool window_exists)
+{
+    for (int i = thumbnail_cache.thumbnails.len - 1; i >= 0; i--)
+        if (thumbnail_cache.thumbnails.tab[i].client == c)
+            thumbnail_remove(i);
+
+    thumbnail_unwatch(c, window_exists);
+}
+
+/** Set how much memory the cached thumbnails may use.
+ * \param budget The size in bytes.
+ */
+void
+thumbnail_set_budget(size_t budget)
+{
+    thumbnail_cache.budget = budget;
+    thumbnail_evict();
+}
+
+/** Push statistics about the thumbnail cache.
+ * \param L The Lua VM state.
+ * \return The number of elements pushed on stack.
+ */
+int
+thumbnail_push_stats(lua_State *L)
+{
+    uint64_t total = thumbnail_cache.hits + thumbnail_cache.misses;
+
+    lua_createtable(L, 0, 7);
+    lua_pushinteger(L, thumbnail_cache.thumbnails.len);
+    lua_setfield(L, -2, "thumbnails");
+    lua_pushnumber(L, thumbnail_cache.bytes);
+    lua_setfield(L, -2, "bytes");
+    lua_pushnumber(L, thumbnail_cache.budget);
+    lua_setfield(L, -2, "budget");
+    lua_pushnumber(L, thumbnail_cache.hits);
+    lua_setfield(L, -2, "hits");
+    lua_pushnumber(L, thumbnail_cache.misses);
+    lua_setfield(L, -2, "misses");
+    lua_pushnumber(L, thumbnail_cache.evictions);
+    lua_setfield(L, -2, "evictions");
+    lua_pushnumber(L, total ? (double) thumbnail_cache.hits / total : 0);
+    lua_setfield(L, -2, "hit_rate");
+    return 1;
+}
+
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
@@ -0,0 +1,38 @@
+/*
+ * thumbnail.h - client thumbnail cache header
+ *
+ * Copyright © 2026 Awesome Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef AWESOME_THUMBNAIL_H
+#define AWESOME_THUMBNAIL_H
+
+#include "objects/client.h"
+
+#include <cairo.h>
+#include <lua.h>
+
+cairo_surface_t *thumbnail_get(client_t *, uint16_t, uint16_t);
+void thumbnail_client_damaged(client_t *);
+void thumbnail_client_banned(client_t *);
+void thumbnail_client_unmanage(client_t *, bool);
+void thumbnail_set_budget(size_t);
+int thumbnail_push_stats(lua_State *);
+
+#endif
+// vim: filetype=c:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:textwidth=80
@@ -28,6 +28,7 @@
 #include "xwindow.h"
 #include "objects/client.h"
 #include "common/atoms.h"
+#include "stats.h"
 
 #include <xcb/xkb.h>
 #include <xkbcommon/xkbcommon.h>
@@ -72,8 +73,8 @@ luaA_xkb_get_layout_group(lua_State *L)
     state_c = xcb_xkb_get_state_unchecked (globalconf.connection,
                                            XCB_XKB_ID_USE_CORE_KBD);
     xcb_xkb_get_state_reply_t* state_r;
-    state_r = xcb_xkb_get_state_reply (globalconf.connection,
-                                       state_c, NULL);
+    state_r = A_XCB_WAIT(xcb_xkb_get_state_reply (globalconf.connection,
+                                       state_c, NULL));
     if (!state_r)
     {
         free(state_r);
@@ -105,7 +106,7 @@ luaA_xkb_get_group_names(lua_State *L)
                                           XCB_XKB_ID_USE_CORE_KBD,
                                           XCB_XKB_NAME_DETAIL_SYMBOLS);
     xcb_xkb_get_names_reply_t* name_r;
-    name_r = xcb_xkb_get_names_reply (globalconf.connection, name_c, NULL);
+    name_r = A_XCB_WAIT(xcb_xkb_get_names_reply (globalconf.connection, name_c, NULL));
 
     if (!name_r)
     {
@@ -124,7 +125,7 @@ luaA_xkb_get_group_names(lua_State *L)
     xcb_get_atom_name_cookie_t atom_name_c;
     atom_name_c = xcb_get_atom_name_unchecked(globalconf.connection, name_list.symbolsName);
     xcb_get_atom_name_reply_t *atom_name_r;
-    atom_name_r = xcb_get_atom_name_reply(globalconf.connection, atom_name_c, NULL);
+    atom_name_r = A_XCB_WAIT(xcb_get_atom_name_reply(globalconf.connection, atom_name_c, NULL));
     if (!atom_name_r) {
         luaA_warn(L, "Failed to get atom symbols name");
         free(name_r);
@@ -143,9 +144,9 @@ luaA_xkb_get_group_names(lua_State *L)
 static bool
 fill_rmlvo_from_root(struct xkb_rule_names *xkb_names)
 {
-    xcb_get_property_reply_t *prop_reply = xcb_get_property_reply(globalconf.connection,
+    xcb_get_property_reply_t *prop_reply = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection,
             xcb_get_property_unchecked(globalconf.connection, false, globalconf.screen->root, _XKB_RULES_NAMES, XCB_GET_PROPERTY_TYPE_ANY, 0, UINT_MAX),
-            NULL);
+            NULL));
     if (!prop_reply)
         return false;
 
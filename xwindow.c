@@ -22,6 +22,7 @@
 #include "xwindow.h"
 #include "common/atoms.h"
 #include "objects/button.h"
+#include "stats.h"
 
 #include <xcb/xcb.h>
 #include <xcb/shape.h>
@@ -64,7 +65,7 @@ xwindow_get_state_reply(xcb_get_property_cookie_t cookie)
     uint32_t result = XCB_ICCCM_WM_STATE_NORMAL;
     xcb_get_property_reply_t *prop_r;
 
-    if((prop_r = xcb_get_property_reply(globalconf.connection, cookie, NULL)))
+    if((prop_r = A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, cookie, NULL))))
     {
         if(xcb_get_property_value_length(prop_r))
             result = *(uint32_t *) xcb_get_property_value(prop_r);
@@ -182,7 +183,7 @@ double
 xwindow_get_opacity_from_cookie(xcb_get_property_cookie_t cookie)
 {
     xcb_get_property_reply_t *prop_r =
-        xcb_get_property_reply(globalconf.connection, cookie, NULL);
+        A_XCB_WAIT(xcb_get_property_reply(globalconf.connection, cookie, NULL));
 
     if(prop_r && prop_r->value_len && prop_r->format == 32)
     {
@@ -274,8 +275,8 @@ xwindow_get_shape(xcb_window_t win, enum xcb_shape_sk_t kind)
     if (kind == XCB_SHAPE_SK_INPUT)
     {
         /* We cannot query the size/existence of an input shape... */
-        xcb_get_geometry_reply_t *geom = xcb_get_geometry_reply(globalconf.connection,
-                xcb_get_geometry(globalconf.connection, win), NULL);
+        xcb_get_geometry_reply_t *geom = A_XCB_WAIT(xcb_get_geometry_reply(globalconf.connection,
+                xcb_get_geometry(globalconf.connection, win), NULL));
         if (!geom)
         {
             xcb_discard_reply(globalconf.connection, rcookie.sequence);
@@ -290,7 +291,7 @@ xwindow_get_shape(xcb_window_t win, enum xcb_shape_sk_t kind)
     else
     {
         xcb_shape_query_extents_cookie_t ecookie = xcb_shape_query_extents(globalconf.connection, win);
-        xcb_shape_query_extents_reply_t *extents = xcb_shape_query_extents_reply(globalconf.connection, ecookie, NULL);
+        xcb_shape_query_extents_reply_t *extents = A_XCB_WAIT(xcb_shape_query_extents_reply(globalconf.connection, ecookie, NULL));
         bool shaped;
 
         if (!extents)
@@ -324,7 +325,7 @@ xwindow_get_shape(xcb_window_t win, enum xcb_shape_sk_t kind)
         }
     }
 
-    xcb_shape_get_rectangles_reply_t *rects_reply = xcb_shape_get_rectangles_reply(globalconf.connection, rcookie, NULL);
+    xcb_shape_get_rectangles_reply_t *rects_reply = A_XCB_WAIT(xcb_shape_get_rectangles_reply(globalconf.connection, rcookie, NULL));
     if (!rects_reply)
     {
         /* Create a cairo surface in an error state */